@@ -1,599 +1,5882 @@
-﻿#define _CRT_SECURE_NO_WARNINGS
-
-#include <stdio.h>
-#include <string.h>
-#include <stdlib.h>
-#include <time.h>
-#include <ctype.h>
-#include <math.h>
-
-/* ---------- Constants / Macros ---------- */
-#define MAX_PRODUCTS 128
-#define NAME_LEN     64
-#define LOG_PATH     "sim_all.csv"
-#define STATE_PATH   "sim_state.bin"  
-
-#define PERISHABLE  (0x01)
-#define ON_SALE     (0x02)
-#define TAX_EXEMPT  (0x04)
-
-#define MIN(a,b) ((a)<(b)?(a):(b))
-#define MAX(a,b) ((a)>(b)?(a):(b))
-
-/* ---------- Types ---------- */
-typedef struct {
-    int    id;
-    char   name[NAME_LEN];
-    double baseCost;
-    double price;
-    int    stock;
-    unsigned int flags;
-
-    long long requested, served, stockouts, wasteUnits;
-    double revenue, cogs, ordersCost;
-} Product;
-
-typedef struct {
-    int daysDefault;
-    int reorder_point;      // s
-    int order_quantity;     // Q
-    int leadMin, leadMax;   // inclusive
-    double orderCostFixed;  // per PO
-    double taxRate;
-} Config;
-
-typedef struct PO {
-    int poId;
-    int productIndex;
-    int qty;
-    int dueDay;
-    int leadTime;
-    struct PO* next;
-} PO;
-
-typedef struct {
-    double revenue, cogs, ordersCost, profit;
-    long long requested, served, stockouts;
-} DayTotals;
-
-typedef struct { int index; double profit; } ProfitRow;
-
-/* ---------- Globals ---------- */
-static Config  G_cfg;
-static Product G_products[MAX_PRODUCTS];
-static int     G_n = 0;
-static PO* G_openPOs = NULL;
-static int     G_day = 0;
-static int     G_nextPO = 1;
-
-static FILE* G_fAll = NULL;
-
-/* ---------- Prototypes ---------- */
-static void clear_line(void);
-static int  rand_int(int a, int b);
-static int  sample_poisson(double lambda);
-
-static PO* po_create(int productIndex, int qty, int dueDay, int lead);
-static void po_push_sorted(PO** head, PO* node);
-static PO* po_pop_due_today(PO** head, int today);
-static void po_free_list(PO* head);
-static int  po_on_order_qty(PO* head, int productIndex);
-
-static void load_defaults(void);
-static void load_config_txt(const char* path);
-static void demo_inventory(void);
-static void load_inventory_csv(const char* path);
-
-static void open_single_log_append(void);
-static void reset_single_log_and_state(void);
-static void close_single_log(void);
-
-static double demand_lambda_for(const Product* p);
-static int    waste_units_for_day(const Product* p);
-static void   log_sale_row(int day, const Product* p, int req, int srv, int shortage, int waste);
-static void   log_order_row(int dayPlaced, int poId, const Product* p, int qty, int dueDay, int leadTime, double orderCost);
-static void   log_daily(int day, const DayTotals* D);
-
-static void simulate_day(void);
-static int  cmp_profit_desc(const void* a, const void* b);
-static void report_top_products_by_profit(void);
-static void report_service_and_stockouts(void);
-static void report_summary_cumulative(void);
-static void show_open_pos(void);
-static void print_menu(void);
-
-/* Welcome screen */
-static void clear_screen(void);
-static void wait_enter(void);
-static void show_welcome(void);
-
-/* NEW: persistence */
-static int  save_state(const char* path);
-static int  load_state(const char* path);
-
-/* ---------- Utils ---------- */
-static void clear_line(void) { int c; while ((c = getchar()) != '\n' && c != EOF) {} }
-static int rand_int(int a, int b) { if (b < a) { int t = a; a = b; b = t; } return a + (rand() % (b - a + 1)); }
-static int sample_poisson(double lambda) {
-    if (lambda <= 0.0) return 0;
-    double L = exp(-lambda), p = 1.0; int k = 0;
-    do { k++; p *= ((double)rand() / RAND_MAX); } while (p > L);
-    return k - 1;
-}
-
-/* ---------- Linked list (POs) ---------- */
-static PO* po_create(int productIndex, int qty, int dueDay, int lead) {
-    PO* n = (PO*)malloc(sizeof(PO)); if (!n) return NULL;
-    n->poId = G_nextPO++; n->productIndex = productIndex; n->qty = qty; n->dueDay = dueDay; n->leadTime = lead; n->next = NULL;
-    return n;
-}
-static void po_push_sorted(PO** head, PO* node) {
-    if (!node) return;
-    if (!*head || node->dueDay < (*head)->dueDay) { node->next = *head; *head = node; return; }
-    PO* cur = *head; while (cur->next && cur->next->dueDay <= node->dueDay) cur = cur->next;
-    node->next = cur->next; cur->next = node;
-}
-static PO* po_pop_due_today(PO** head, int today) {
-    PO* outHead = NULL, * outTail = NULL;
-    while (*head && (*head)->dueDay == today) {
-        PO* n = *head; *head = (*head)->next; n->next = NULL;
-        if (!outHead) outHead = outTail = n; else { outTail->next = n; outTail = n; }
-    }
-    return outHead;
-}
-static void po_free_list(PO* head) { while (head) { PO* n = head->next; free(head); head = n; } }
-static int  po_on_order_qty(PO* head, int productIndex) { int s = 0; for (PO* n = head; n; n = n->next) if (n->productIndex == productIndex) s += n->qty; return s; }
-
-/* ---------- Loading ---------- */
-static void load_defaults(void) {
-    G_cfg.daysDefault = 30; G_cfg.reorder_point = 15; G_cfg.order_quantity = 40;
-    G_cfg.leadMin = 2; G_cfg.leadMax = 4; G_cfg.orderCostFixed = 15.0; G_cfg.taxRate = 0.17;
-}
-static void load_config_txt(const char* path) {
-    FILE* f = NULL; if (fopen_s(&f, path, "r") != 0 || !f) { return; } /* silent if not found */
-    char line[512], key[64], val[256];
-    while (fgets(line, sizeof(line), f)) {
-        if (line[0] == '#' || (line[0] == '/' && line[1] == '/')) continue;
-        if (sscanf_s(line, " %63[^=]=%255[^\n]", key, (unsigned)sizeof(key), val, (unsigned)sizeof(val)) == 2) {
-            for (int i = (int)strlen(key) - 1; i >= 0 && isspace((unsigned char)key[i]); --i) key[i] = '\0';
-            for (int i = 0; val[i]; ++i) if (val[i] == '\r' || val[i] == '\n') val[i] = '\0';
-            for (int i = 0; key[i]; ++i) key[i] = (char)tolower((unsigned char)key[i]);
-            if (!strcmp(key, "days"))               G_cfg.daysDefault = atoi(val);
-            else if (!strcmp(key, "s") || !strcmp(key, "reorder_point")) G_cfg.reorder_point = atoi(val);
-            else if (!strcmp(key, "q") || !strcmp(key, "order_quantity")) G_cfg.order_quantity = atoi(val);
-            else if (!strcmp(key, "leadtimemin"))   G_cfg.leadMin = atoi(val);
-            else if (!strcmp(key, "leadtimemax"))   G_cfg.leadMax = atoi(val);
-            else if (!strcmp(key, "ordercostfixed")) G_cfg.orderCostFixed = atof(val);
-            else if (!strcmp(key, "taxrate"))        G_cfg.taxRate = atof(val);
-        }
-    }
-    fclose(f);
-}
-static void demo_inventory(void) {
-    G_n = 0; Product p;
-    p.id = 101; strcpy_s(p.name, sizeof(p.name), "Milk 1L");      p.baseCost = 6.0;  p.price = 8.0;  p.stock = 50; p.flags = PERISHABLE;
-    p.requested = p.served = p.stockouts = p.wasteUnits = 0; p.revenue = p.cogs = p.ordersCost = 0; G_products[G_n++] = p;
-    p.id = 102; strcpy_s(p.name, sizeof(p.name), "Bread");        p.baseCost = 5.0;  p.price = 7.5;  p.stock = 40; p.flags = 0;
-    p.requested = p.served = p.stockouts = p.wasteUnits = 0; p.revenue = p.cogs = p.ordersCost = 0; G_products[G_n++] = p;
-    p.id = 204; strcpy_s(p.name, sizeof(p.name), "Strawberries"); p.baseCost = 20.0; p.price = 28.0; p.stock = 20; p.flags = PERISHABLE;
-    p.requested = p.served = p.stockouts = p.wasteUnits = 0; p.revenue = p.cogs = p.ordersCost = 0; G_products[G_n++] = p;
-    p.id = 305; strcpy_s(p.name, sizeof(p.name), "Olive Oil");    p.baseCost = 23.0; p.price = 35.0; p.stock = 15; p.flags = 0;
-    p.requested = p.served = p.stockouts = p.wasteUnits = 0; p.revenue = p.cogs = p.ordersCost = 0; G_products[G_n++] = p;
-}
-static unsigned int parse_flags_token(const char* tok) {
-    char buf[128]; strncpy_s(buf, sizeof(buf), tok, _TRUNCATE);
-    for (int i = 0; buf[i]; ++i) if (buf[i] == ' ' || buf[i] == '\t' || buf[i] == '\r' || buf[i] == '\n') buf[i] = '\0';
-    char* end = NULL; long v = strtol(buf, &end, 10); if (end && *end == '\0' && buf[0]) return (unsigned)v;
-    unsigned int flags = 0; const char* p = buf;
-    while (*p) {
-        char t[64] = { 0 }; int ti = 0; while (*p && *p != '|' && ti < 63) { t[ti++] = *p++; } if (*p == '|') p++;
-        for (int i = 0; t[i]; ++i) t[i] = (char)toupper((unsigned char)t[i]);
-        if (!strcmp(t, "PERISHABLE")) flags |= PERISHABLE; else if (!strcmp(t, "ON_SALE")) flags |= ON_SALE; else if (!strcmp(t, "TAX_EXEMPT")) flags |= TAX_EXEMPT;
-    }
-    return flags;
-}
-static void load_inventory_csv(const char* path) {
-    FILE* f = NULL; if (fopen_s(&f, path, "r") != 0 || !f) { demo_inventory(); return; } /* silent fallback */
-    char line[1024]; if (!fgets(line, sizeof(line), f)) { fclose(f); demo_inventory(); return; }
-    G_n = 0;
-    while (fgets(line, sizeof(line), f)) {
-        if (G_n >= MAX_PRODUCTS) break;
-        char name[NAME_LEN]; int id, stock; double bc, pr; char flagsTok[128] = "0";
-        int n = sscanf_s(line, " %d , %63[^,] , %lf , %lf , %d , %127[^\n]",
-            &id, name, (unsigned)sizeof(name), &bc, &pr, &stock, flagsTok, (unsigned)sizeof(flagsTok));
-        if (n >= 5) {
-            Product p; memset(&p, 0, sizeof(p));
-            p.id = id; strncpy_s(p.name, sizeof(p.name), name, _TRUNCATE);
-            p.baseCost = bc; p.price = pr; p.stock = stock;
-            p.flags = (n == 6 ? parse_flags_token(flagsTok) : 0);
-            G_products[G_n++] = p;
-        }
-    }
-    fclose(f);
-}
-
-/* ---------- Single CSV log (append / reset) ---------- */
-static void open_single_log_append(void) {
-    if (G_fAll) return;
-    fopen_s(&G_fAll, LOG_PATH, "a+");
-    if (!G_fAll) { fprintf(stderr, "ERR: cannot open %s\n", LOG_PATH); return; }
-    fseek(G_fAll, 0, SEEK_END); long sz = ftell(G_fAll);
-    if (sz <= 0) {
-        fprintf(G_fAll,
-            "type,day,poId,dayPlaced,productId,productName,orderQty,dueDay,leadTime,orderCost,"
-            "requested,served,unitPrice,revenue,shortage,waste,"
-            "revenue_d,cogs_d,orders_d,profit_d,fill_rate,stockouts\n");
-        fflush(G_fAll);
-    }
-}
-static void reset_single_log_and_state(void) {
-    if (G_fAll) { fclose(G_fAll); G_fAll = NULL; }
-    fopen_s(&G_fAll, LOG_PATH, "w");
-    if (G_fAll) {
-        fprintf(G_fAll,
-            "type,day,poId,dayPlaced,productId,productName,orderQty,dueDay,leadTime,orderCost,"
-            "requested,served,unitPrice,revenue,shortage,waste,"
-            "revenue_d,cogs_d,orders_d,profit_d,fill_rate,stockouts\n");
-        fflush(G_fAll);
-    }
-    po_free_list(G_openPOs); G_openPOs = NULL;
-    for (int i = 0; i < G_n; i++) {
-        G_products[i].requested = G_products[i].served = G_products[i].stockouts = G_products[i].wasteUnits = 0;
-        G_products[i].revenue = G_products[i].cogs = G_products[i].ordersCost = 0.0;
-    }
-    G_day = 0; G_nextPO = 1;
-
-    /* NEW: also clear saved state so next run starts fresh */
-    remove(STATE_PATH);
-}
-static void close_single_log(void) { if (G_fAll) { fclose(G_fAll); G_fAll = NULL; } }
-
-/* ---------- Demand / Waste ---------- */
-static double demand_lambda_for(const Product* p) {
-    double base = (p->flags & PERISHABLE) ? 6.0 : 3.5;
-    double priceFactor = (p->price > 0 ? (12.0 / (p->price + 4.0)) : 2.0);
-    double promo = (p->flags & ON_SALE) ? 1.25 : 1.0;
-    double lam = base * priceFactor * promo; if (lam < 0.2) lam = 0.2; if (lam > 18.0) lam = 18.0; return lam;
-}
-static int waste_units_for_day(const Product* p) {
-    if (!(p->flags & PERISHABLE)) return 0; int s = p->stock; if (s <= 0) return 0;
-    double rate = (rand_int(1, 3)) / 100.0; int w = (int)floor(rate * s + 0.5); return (w > 0 ? w : 0);
-}
-
-/* ---------- Log writers ---------- */
-static void log_sale_row(int day, const Product* p, int req, int srv, int shortage, int waste) {
-    if (!G_fAll) return; double rev = srv * p->price;
-    fprintf(G_fAll, "sale,%d,,,,%d,%s,,,,%d,%d,%.2f,%.2f,%d,%d,,,,,,\n",
-        day, p->id, p->name, req, srv, p->price, rev, shortage, waste);
-    fflush(G_fAll);
-}
-static void log_order_row(int dayPlaced, int poId, const Product* p, int qty, int dueDay, int leadTime, double orderCost) {
-    if (!G_fAll) return;
-    fprintf(G_fAll, "order,,%d,%d,%d,%s,%d,%d,%d,%.2f,,,,,,,,,,,\n",
-        poId, dayPlaced, p->id, p->name, qty, dueDay, leadTime, orderCost);
-    fflush(G_fAll);
-}
-static void log_daily(int day, const DayTotals* D) {
-    if (!G_fAll) return; double fill = (D->requested > 0 ? ((double)D->served / (double)D->requested) : 1.0);
-    fprintf(G_fAll, "daily,%d,,,,,,,,,,,,,,,%.2f,%.2f,%.2f,%.2f,%.4f,%lld\n",
-        day, D->revenue, D->cogs, D->ordersCost, D->profit, fill, D->stockouts);
-    fflush(G_fAll);
-}
-
-/* ---------- PERSISTENCE (save/load state) ---------- */
-typedef struct { int poId, productIndex, qty, dueDay, leadTime; } SavePO;
-
-static int save_state(const char* path) {
-    FILE* f = NULL; if (fopen_s(&f, path, "wb") != 0 || !f) return 0;
-    unsigned int magic = 0x53494D31; /* 'SIM1' */
-    fwrite(&magic, sizeof(magic), 1, f);
-
-    fwrite(&G_cfg, sizeof(G_cfg), 1, f);
-    fwrite(&G_day, sizeof(G_day), 1, f);
-    fwrite(&G_nextPO, sizeof(G_nextPO), 1, f);
-    fwrite(&G_n, sizeof(G_n), 1, f);
-
-    if (G_n > 0) fwrite(G_products, sizeof(Product), G_n, f);
-
-    int count = 0; for (PO* n = G_openPOs; n; n = n->next) count++;
-    fwrite(&count, sizeof(count), 1, f);
-    for (PO* n = G_openPOs; n; n = n->next) {
-        SavePO s = { n->poId, n->productIndex, n->qty, n->dueDay, n->leadTime };
-        fwrite(&s, sizeof(s), 1, f);
-    }
-    fclose(f);
-    return 1;
-}
-
-static int load_state(const char* path) {
-    FILE* f = NULL; if (fopen_s(&f, path, "rb") != 0 || !f) return 0;
-    unsigned int magic = 0; if (fread(&magic, sizeof(magic), 1, f) != 1 || magic != 0x53494D31) { fclose(f); return 0; }
-
-    if (fread(&G_cfg, sizeof(G_cfg), 1, f) != 1) { fclose(f); return 0; }
-    if (fread(&G_day, sizeof(G_day), 1, f) != 1) { fclose(f); return 0; }
-    if (fread(&G_nextPO, sizeof(G_nextPO), 1, f) != 1) { fclose(f); return 0; }
-    if (fread(&G_n, sizeof(G_n), 1, f) != 1) { fclose(f); return 0; }
-    if (G_n<0 || G_n>MAX_PRODUCTS) { fclose(f); return 0; }
-
-    if (G_n > 0 && fread(G_products, sizeof(Product), G_n, f) != (size_t)G_n) { fclose(f); return 0; }
-
-    po_free_list(G_openPOs); G_openPOs = NULL;
-    int count = 0; if (fread(&count, sizeof(count), 1, f) != 1) { fclose(f); return 0; }
-    for (int i = 0; i < count; i++) {
-        SavePO s; if (fread(&s, sizeof(s), 1, f) != 1) { fclose(f); return 0; }
-        PO* node = po_create(s.productIndex, s.qty, s.dueDay, s.leadTime);
-        if (node) { node->poId = s.poId; po_push_sorted(&G_openPOs, node); }
-        if (G_nextPO <= s.poId) G_nextPO = s.poId + 1;
-    }
-    fclose(f);
-    return 1;
-}
-
-/* ---------- One day ---------- */
-static void simulate_day(void) {
-    G_day += 1;
-    DayTotals D; memset(&D, 0, sizeof(D));
-
-    /* Arrivals */
-    PO* arrivals = po_pop_due_today(&G_openPOs, G_day);
-    if (arrivals) {
-        printf("Arrivals: "); int first = 1;
-        for (PO* n = arrivals; n; n = n->next) {
-            Product* p = &G_products[n->productIndex]; p->stock += n->qty;
-            if (!first) printf(", "); printf("%s +%d (PO#%d)", p->name, n->qty, n->poId); first = 0;
-        }
-        puts(""); po_free_list(arrivals);
-    }
-
-    /* Demand & sales */
-    int* reqArr = (int*)calloc(G_n, sizeof(int)), * srvArr = (int*)calloc(G_n, sizeof(int));
-    int* shortArr = (int*)calloc(G_n, sizeof(int)), * wstArr = (int*)calloc(G_n, sizeof(int));
-    if (!reqArr || !srvArr || !shortArr || !wstArr) { puts("OOM"); free(reqArr); free(srvArr); free(shortArr); free(wstArr); return; }
-
-    printf("Demand: ");
-    for (int i = 0; i < G_n; i++) {
-        Product* p = &G_products[i];
-        int req = sample_poisson(demand_lambda_for(p));
-        int srv = MIN(req, p->stock);
-        int shortage = req - srv;
-        p->stock -= srv;
-
-        reqArr[i] = req; srvArr[i] = srv; shortArr[i] = shortage;
-
-        p->requested += req; p->served += srv; p->stockouts += (shortage > 0 ? shortage : 0);
-        D.requested += req; D.served += srv; D.stockouts += (shortage > 0 ? shortage : 0);
-        double rev = srv * p->price, cg = srv * p->baseCost;
-        p->revenue += rev; p->cogs += cg; D.revenue += rev; D.cogs += cg;
-
-        if (i) printf(", "); printf("%s=%d", p->name, req);
-    }
-    puts("");
-
-    printf("Sales:  ");
-    for (int i = 0; i < G_n && i < 4; i++) { if (i) printf(", "); printf("%s=%d", G_products[i].name, srvArr[i]); }
-    if (G_n > 4) printf(", ..."); printf(" (0 backorders)\n");
-
-    /* Waste + log per product */
-    int anyWaste = 0, anySto = 0;
-    for (int i = 0; i < G_n; i++) {
-        Product* p = &G_products[i];
-        int waste = waste_units_for_day(p); if (waste > p->stock) waste = p->stock;
-        if (waste > 0) { p->stock -= waste; p->wasteUnits += waste; anyWaste = 1; }
-        wstArr[i] = waste; if (shortArr[i] > 0) anySto = 1;
-        log_sale_row(G_day, p, reqArr[i], srvArr[i], shortArr[i], wstArr[i]);
-    }
-
-    if (anySto) {
-        printf("Stockout Alerts: "); int first = 1;
-        for (int i = 0; i < G_n; i++) if (shortArr[i] > 0) { if (!first) printf(", "); printf("%s short by %d units", G_products[i].name, shortArr[i]); first = 0; }
-        puts("");
-    }
-    else puts("Stockout Alerts: none");
-
-    if (anyWaste) {
-        printf("Waste (Perishables): "); int first = 1;
-        for (int i = 0; i < G_n; i++) if (wstArr[i] > 0) { if (!first) printf(", "); printf("%s -%d units", G_products[i].name, wstArr[i]); first = 0; }
-        puts("");
-    }
-
-    /* Reorders (s,Q) */
-    typedef struct { int idx, qty, due; } NewPO; NewPO* today = (NewPO*)malloc(sizeof(NewPO) * G_n); int nToday = 0;
-    for (int i = 0; i < G_n; i++) {
-        Product* p = &G_products[i];
-        int invPos = p->stock + po_on_order_qty(G_openPOs, i);
-        if (invPos <= G_cfg.reorder_point) {
-            int lt = rand_int(G_cfg.leadMin, G_cfg.leadMax), due = G_day + lt;
-            PO* node = po_create(i, G_cfg.order_quantity, due, lt);
-            if (node) {
-                po_push_sorted(&G_openPOs, node);
-                p->ordersCost += G_cfg.orderCostFixed; D.ordersCost += G_cfg.orderCostFixed;
-                log_order_row(G_day, node->poId, p, node->qty, node->dueDay, node->leadTime, G_cfg.orderCostFixed);
-                today[nToday].idx = i; today[nToday].qty = node->qty; today[nToday].due = due; nToday++;
-            }
-        }
-    }
-    if (nToday > 0) {
-        printf("Reorders: ");
-        for (int k = 0; k < nToday; k++) { if (k) printf(", "); printf("%s - Order quantity: %d, ETA: Day %d", G_products[today[k].idx].name, today[k].qty, today[k].due); }
-        puts("");
-    }
-    else puts("Reorders: none");
-    free(today);
-
-    D.profit = D.revenue - D.cogs - D.ordersCost;
-    printf("KPI: Revenue=%.0f ILS | COGS=%.0f ILS | Orders=%.0f ILS | Profit=%.0f ILS\n", D.revenue, D.cogs, D.ordersCost, D.profit);
-    log_daily(G_day, &D);
-
-    /* NEW: auto-save state at end of day */
-    save_state(STATE_PATH);
-
-    free(reqArr); free(srvArr); free(shortArr); free(wstArr);
-}
-
-/* ---------- Reports ---------- */
-static int cmp_profit_desc(const void* a, const void* b) {
-    const ProfitRow* x = (const ProfitRow*)a, * y = (const ProfitRow*)b;
-    if (y->profit > x->profit) return 1; if (y->profit < x->profit) return -1; return 0;
-}
-static void report_top_products_by_profit(void) {
-    int K = 5; printf("How many products to show (Top-K)? [default 5]: ");
-    int tmp; if (scanf_s("%d", &tmp) == 1 && tmp > 0) K = tmp;
-    ProfitRow* rows = (ProfitRow*)malloc(sizeof(ProfitRow) * G_n); if (!rows) { puts("OOM"); return; }
-    for (int i = 0; i < G_n; i++) { rows[i].index = i; rows[i].profit = G_products[i].revenue - G_products[i].cogs - G_products[i].ordersCost; }
-    qsort(rows, G_n, sizeof(ProfitRow), cmp_profit_desc); if (K > G_n) K = G_n;
-    puts("\n=== Top products by profit ===");
-    printf("%-3s %-6s %-18s %-6s %-8s %-8s %-8s %-8s\n", "#", "ID", "Name", "Sold", "Revenue", "COGS", "Orders", "Profit");
-    for (int j = 0; j < K; j++) {
-        int i = rows[j].index; double pr = rows[j].profit; long long sold = G_products[i].served;
-        printf("%-3d %-6d %-18s %-6lld %-8.0f %-8.0f %-8.0f %-8.0f\n", j + 1, G_products[i].id, G_products[i].name, sold,
-            G_products[i].revenue, G_products[i].cogs, G_products[i].ordersCost, pr);
-    }
-    free(rows);
-}
-static void report_service_and_stockouts(void) {
-    long long req = 0, srv = 0, sto = 0; for (int i = 0; i < G_n; i++) { req += G_products[i].requested; srv += G_products[i].served; sto += G_products[i].stockouts; }
-    double fill = (req > 0 ? ((double)srv / (double)req) : 1.0) * 100.0;
-    int topIdx[3] = { -1,-1,-1 }; long long topVals[3] = { 0,0,0 };
-    for (int i = 0; i < G_n; i++) {
-        long long v = G_products[i].stockouts;
-        for (int k = 0; k < 3; k++) { if (v > topVals[k]) { for (int m = 2; m > k; m--) { topVals[m] = topVals[m - 1]; topIdx[m] = topIdx[m - 1]; } topVals[k] = v; topIdx[k] = i; break; } }
-    }
-    puts("\n=== Service level & stockouts ===");
-    printf("Fill rate: %.2f%%\n", fill); printf("Stockouts (units): %lld\n", sto); printf("Top stockout products: ");
-    int printed = 0; for (int k = 0; k < 3; k++) { if (topIdx[k] >= 0 && topVals[k] > 0) { if (printed) printf(", "); printf("%s %lld", G_products[topIdx[k]].name, topVals[k]); printed = 1; } }
-    if (!printed) printf("none"); puts("");
-}
-static void report_summary_cumulative(void) {
-    double revenue = 0, cogs = 0, orders = 0; long long req = 0, srv = 0, sto = 0;
-    for (int i = 0; i < G_n; i++) { revenue += G_products[i].revenue; cogs += G_products[i].cogs; orders += G_products[i].ordersCost; req += G_products[i].requested; srv += G_products[i].served; sto += G_products[i].stockouts; }
-    double profit = revenue - cogs - orders; double fill = (req > 0 ? ((double)srv / (double)req) : 1.0) * 100.0;
-    printf("\n=== Summary (cumulative) - Days 1..%d ===\n", G_day);
-    printf("Revenue: %.0f ILS\nCOGS:    %.0f ILS\nOrders:  %.0f ILS\nPROFIT:  %.0f ILS\n\n", revenue, cogs, orders, profit);
-    printf("Fill rate: %.2f%%\nStockouts (units): %lld\n", fill, sto);
-    int topIdx[3] = { -1,-1,-1 }; long long topVals[3] = { 0,0,0 };
-    for (int i = 0; i < G_n; i++) {
-        long long v = G_products[i].stockouts;
-        for (int k = 0; k < 3; k++) { if (v > topVals[k]) { for (int m = 2; m > k; m--) { topVals[m] = topVals[m - 1]; topIdx[m] = topIdx[m - 1]; } topVals[k] = v; topIdx[k] = i; break; } }
-    }
-    printf("Top stockout products: "); int printed = 0;
-    for (int k = 0; k < 3; k++) { if (topIdx[k] >= 0 && topVals[k] > 0) { if (printed) printf(", "); printf("%s %lld", G_products[topIdx[k]].name, topVals[k]); printed = 1; } }
-    if (!printed) printf("none"); puts("");
-    printf("\nSaved to: %s\n", LOG_PATH);
-}
-static void show_open_pos(void) {
-    puts("\nOpen Purchase Orders (ETAs)\n---------------------------");
-    if (!G_openPOs) { puts("(none)"); return; }
-    for (PO* n = G_openPOs; n; n = n->next) {
-        Product* p = &G_products[n->productIndex]; int daysLeft = n->dueDay - G_day; if (daysLeft < 0) daysLeft = 0;
-        printf("PO#%d | %-16s | Order quantity: %d | ETA: Day %d | Days left: %d\n",
-            n->poId, p->name, n->qty, n->dueDay, daysLeft);
-    }
-}
-
-/* ---------- Welcome screen ---------- */
-static void clear_screen(void) {
-#ifdef _WIN32
-    system("cls");
-#else
-    system("clear");
-#endif
-}
-static void wait_enter(void) {
-    puts("\nPress ENTER to continue...");
-    int c;
-    while ((c = getchar()) != '\n' && c != EOF) {}
-}
-static void show_welcome(void) {
-    clear_screen();
-    puts("+----------------------------------------------------+");
-    puts("|                                                    |");
-    puts("|           W E L C O M E   T O   T H E              |");
-    puts("|                                                    |");
-    puts("|                M I N I M A R K E T                 |"); /* NOTE: regular ASCII only */
-    puts("|                                                    |");
-    puts("+----------------------------------------------------+");
-    wait_enter();
-    clear_screen();
-}
-
-/* ---------- Menu ---------- */
-static void print_menu(void) {
-    puts("\n================= INVENTORY SIM ((s,Q)) =================");
-    printf("Day: %d\n", G_day);
-    puts("---------------------------------------------------------");
-    puts("1) Run multiple days (you'll enter how many)");
-    puts("2) Step 1 day");
-    puts("3) Reports");
-    puts("   3.1) Top products by profit (choose how many)");
-    puts("   3.2) Service level & stockouts");
-    puts("   3.3) Summary (cumulative totals)");
-    puts("4) Show open purchase orders (ETAs)");
-    puts("5) rest");
-    puts("6) Exit");
-    puts("---------------------------------------------------------");
-    printf("Select: ");
-}
-
-/* ---------- Main ---------- */
-int main(void) {
-    srand((unsigned)time(NULL));
-
-    /* Show welcome first */
-    show_welcome();
-
-    /* Auto-load on start: config/inventory, open single log in append mode */
-    load_defaults();
-    load_config_txt("config.txt");       /* if missing -> keep defaults */
-    load_inventory_csv("inventory.csv"); /* if missing -> demo inventory */
-    open_single_log_append();
-
-    /* NEW: try to resume from saved state */
-    if (load_state(STATE_PATH)) {
-        printf("Loaded saved state from %s. Continuing at Day %d.\n", STATE_PATH, G_day);
-    }
-    else {
-        printf("Starting new simulation. Day=%d.\n", G_day);
-    }
-
-    int running = 1;
-    while (running) {
-        print_menu();
-        int choice = -1; if (scanf_s("%d", &choice) != 1) { clear_line(); continue; }
-
-        if (choice == 1) {
-            int N = 0; printf("How many days to run? ");
-            if (scanf_s("%d", &N) != 1 || N <= 0) { puts("Invalid days."); clear_line(); continue; }
-            for (int i = 0; i < N; i++) { printf("\nDay %d\n------\n", G_day + 1); simulate_day(); }
-        }
-        else if (choice == 2) {
-            printf("\nDay %d\n------\n", G_day + 1); simulate_day();
-        }
-        else if (choice == 3) {
-            printf("\nReports: choose 1/2/3: "); int r = 0;
-            if (scanf_s("%d", &r) != 1) { clear_line(); continue; }
-            if (r == 1) report_top_products_by_profit();
-            else if (r == 2) report_service_and_stockouts();
-            else if (r == 3) report_summary_cumulative();
-            else puts("Unknown report.");
-        }
-        else if (choice == 4) {
-            show_open_pos();
-        }
-        else if (choice == 5) {
-            puts("\nAre you sure? This will CLEAR sim_all.csv and reset the simulation. (y/n)");
-            char ch = 0; scanf_s(" %c", &ch, 1);
-            if (ch == 'y' || ch == 'Y') { reset_single_log_and_state(); puts("Reset complete. Day=0."); }
-            else puts("Reset cancelled.");
-        }
-        else if (choice == 6) {
-            /* NEW: save state on exit */
-            save_state(STATE_PATH);
-            running = 0;
-        }
-        else {
-            puts("Unknown option.");
-        }
-    }
-    close_single_log(); po_free_list(G_openPOs);
-    return 0;
-}
+﻿#define _CRT_SECURE_NO_WARNINGS
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L   /* mmap, fsync, clock_gettime, sysconf, fseeko */
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <io.h>
+#include <direct.h>
+#include <sys/stat.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <ctype.h>
+#include <math.h>
+#include <limits.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdarg.h>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+/* ---------- Constants / Macros ---------- */
+#define NAME_LEN     64
+#define CAT_ALIGN    64       /* catalog column alignment (cache line / AVX-512 vector) */
+#define LOG_PATH     "sim_all.csv"
+#define LOG_SALE_PATH  "sim_sale.bin"
+#define LOG_ORDER_PATH "sim_order.bin"
+#define LOG_DAILY_PATH "sim_daily.bin"
+#define LOG_NAMES_PATH "sim_names.bin"
+#define LOG_INDEX_PATH "sim_log.idx"     /* columnar index behind --query */
+#define STATE_PATH   "sim_state.bin"   /* checkpoint */
+#define JOURNAL_PATH "sim_state.jnl"   /* per-day deltas since the checkpoint */
+#define REPS_PATH    "sim_reps.csv"
+#define OPT_PATH     "sim_opt.csv"
+#define NETWORK_PATH "sim_network.csv"
+#define INTRADAY_PATH "sim_intraday.csv"
+#define WHATIF_PATH  "sim_whatif.csv"
+#define SRV_PORT     7070              /* --serve default: 127.0.0.1:7070 */
+#define CATALOG_IMAGE_EXT ".bin"      /* inventory.csv -> inventory.csv.bin (parsed catalog cache) */
+#define BENCH_PATH   "bench.json"
+#define BENCH_DIR    "mm_bench_tmp"    /* scratch directory for the log / state benchmarks */
+#define TEST_DIR     "mm_test_tmp"     /* scratch directory for the self-tests */
+#define POLICY_PATH  "sim_policy.csv"  /* per-SKU replenishment policies (also written by --optimize) */
+#define DEMAND_PATH  "sim_demand.csv"  /* per-SKU demand parameters */
+#define MAX_THREADS  256
+
+/* RNG stream purposes (one counter-based stream per product, per day, per purpose) */
+#define RNG_DEMAND  0u
+#define RNG_WASTE   1u
+#define RNG_LEAD    2u
+#define RNG_ARRIVAL 3u    /* intraday: customer arrivals and baskets (one stream per day) */
+#define RNG_DELIVERY 4u   /* intraday: delivery time of a PO (stream = poId) */
+#define POISSON_PTRS_MIN 10.0   /* lambda at which the sampler switches from inversion to PTRS */
+#define SEASON_YEAR_MAX 52      /* annual demand curve: up to weekly values */
+#define LOT_CAP 7               /* lots per SKU ring (LotRing fills one 64-byte line) */
+
+/* Log subsystem */
+#define LOG_FMT_CSV     0
+#define LOG_FMT_BINARY  1
+#define LOG_FMT_NONE    2
+#define LOG_S_CSV       0     /* stream ids: CSV uses one file, binary one file per record type */
+#define LOG_S_SALE      0
+#define LOG_S_ORDER     1
+#define LOG_S_DAILY     2
+#define LOG_S_NAMES     3
+#define LOG_STREAMS     4
+#define LOG_BUF_BYTES   (1 << 20)
+#define LOG_POOL        8     /* buffers shared by all streams; the simulation waits when all are queued */
+#define LOG_MAGIC       0x474F4C4Du /* 'MLOG' */
+#define LOG_CSV_HEADER  "type,day,poId,dayPlaced,productId,productName,orderQty,dueDay,leadTime,orderCost," \
+                        "requested,served,unitPrice,revenue,shortage,waste," \
+                        "revenue_d,cogs_d,orders_d,profit_d,fill_rate,stockouts\n"
+
+/* Replenishment policy types (Catalog.policy) */
+#define POL_CONFIG  0   /* (s,Q) from Config */
+#define POL_SQ      1   /* continuous review: IP <= s -> order Q */
+#define POL_SS      2   /* continuous review: IP <= s -> order up to S */
+#define POL_RS      3   /* periodic review: every R days order up to S */
+#define POL_BASE    4   /* base stock: order up to S every day */
+#define POL_MINMAX  5   /* IP <= min -> order up to max */
+#define POL_FORECAST 6  /* dynamic (s,S) from the SKU's demand forecast */
+#define POL_COUNT   7
+
+/* Demand forecasting (Config.fcModel): additive exponential smoothing, weekly season */
+#define FC_SES        0
+#define FC_HOLT       1
+#define FC_HW         2   /* Holt-Winters */
+#define FC_COUNT      3
+#define FC_PERIOD     7
+#define FC_MSE_SMOOTH 0.1 /* weight of today's squared error in the error variance */
+
+/* Persistence */
+#define CKPT_MAGIC        0x4B434D4Du /* 'MMCK' */
+#define CKPT_VERSION      1u
+#define CKPT_MAX_SECTIONS 64   /* files written with a smaller table (32) still load */
+#define CKPT_ALIGN        64
+#define IMG_MAGIC         0x49434D4Du /* 'MMCI' catalog image */
+#define JNL_MAGIC         0x4C4A4D4Du /* 'MMJL' */
+#define JNL_DAY_MAGIC     0x5941444Au /* 'JDAY' */
+#define ENDIAN_TAG        0x01020304u
+
+/* CSV loader */
+#define CSV_MAX_FIELDS 32
+#define CSV_CHUNK_MIN  ((size_t)1 << 20)  /* files are split into chunks of at least 1 MB */
+#define CSV_MAX_ERRORS 20                 /* reported per chunk (all are counted) */
+
+/* Intraday engine: event times are ms since midnight */
+#define TW_BITS     8
+#define TW_SLOTS    (1 << TW_BITS)
+#define TW_WORDS    (TW_SLOTS / 64)   /* bitmap words per level */
+#define TW_LEVELS   4                 /* 32 bits of ms: times up to 49 days */
+#define ID_MS_PER_MIN  60000u
+#define ID_MS_PER_HOUR 3600000u
+
+/* Log query index */
+#define QIDX_MAGIC      0x58514D4Du /* 'MMQX' */
+#define QIDX_VERSION    1u
+#define QSEG_MAGIC      0x47455351u /* 'QSEG' */
+#define QIDX_HEAD_BYTES 4096        /* log prefix fingerprinted to detect a reset log */
+#define QSEG_ROWS       (1 << 22)   /* sale rows per segment (cut at the next day boundary) */
+
+#define PERISHABLE  (0x01)
+#define ON_SALE     (0x02)
+#define TAX_EXEMPT  (0x04)
+
+/* Phase timers / counters: opt-in, compiled out unless MINIMARKET_STATS is defined */
+#ifdef MINIMARKET_STATS
+#define MM_STATS 1
+#endif
+enum { PH_ARRIVALS, PH_DEMAND, PH_SALES, PH_WASTE, PH_LOG, PH_FORECAST, PH_REORDER, PH_PRINT, PH_PERSIST, PH_COUNT };
+#define STATS_BUCKETS 40      /* latency histogram: bucket b counts samples in [2^(b-1), 2^b) ns */
+#define STATS_FMT_TABLE 0
+#define STATS_FMT_JSON  1
+#define STATS_FMT_PROM  2
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
+
+/* ---------- Platform threads ---------- */
+#ifdef _WIN32
+typedef HANDLE mm_thread;
+typedef CRITICAL_SECTION mm_mutex;
+typedef CONDITION_VARIABLE mm_cond;
+#define THREAD_FN(name, arg) static DWORD WINAPI name(LPVOID arg)
+#define THREAD_RETURN return 0
+#else
+typedef pthread_t mm_thread;
+typedef pthread_mutex_t mm_mutex;
+typedef pthread_cond_t mm_cond;
+#define THREAD_FN(name, arg) static void* name(void* arg)
+#define THREAD_RETURN return NULL
+#endif
+#ifdef _WIN32
+typedef SOCKET mm_socket;
+#define MM_BAD_SOCKET INVALID_SOCKET
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+#else
+typedef int mm_socket;
+#define MM_BAD_SOCKET (-1)
+#endif
+
+/* ---------- Types ---------- */
+/* Interned strings: NUL-terminated, back to back in buf; referenced by offset */
+typedef struct {
+    char* buf; int len, cap;
+    int*  slots; int nslots;   /* open addressing on FNV-1a hash: offset+1, 0 = empty */
+    int   count;
+    volatile long* refs;   /* shared by forked catalogs (cat_fork); NULL = sole owner */
+} StrTable;
+
+/* Dated lots of one SKU, oldest first: ring slots head .. head+count-1 (mod LOT_CAP), ordered by useBy.
+   A lot is sold through day useBy and becomes waste at the end of it. */
+typedef struct { int head, count; int qty[LOT_CAP]; int useBy[LOT_CAP]; } LotRing;
+
+/* X(type, field) for every per-SKU column. Hot counters first; id/nameOff are cold. */
+#define CATALOG_COLUMNS(X) \
+    X(int, stock) X(double, price) X(double, baseCost) X(unsigned int, flags) \
+    X(long long, requested) X(long long, served) X(long long, stockouts) X(long long, wasteUnits) \
+    X(double, revenue) X(double, cogs) X(double, ordersCost) \
+    X(int, policy) X(int, reorderPoint) X(int, orderQty) X(int, orderUpTo) /* POL_*; s/min, Q, S/max */ \
+    X(int, reviewPeriod) X(int, moq) X(int, casePack) \
+    X(double, fcLevel) X(double, fcTrend) X(double, fcMse) X(int, fcDays) /* forecast state; season by weekday: */ \
+    X(double, fcSeason0) X(double, fcSeason1) X(double, fcSeason2) X(double, fcSeason3) X(double, fcSeason4) X(double, fcSeason5) X(double, fcSeason6) \
+    X(double, dmBase) X(double, dmElast) X(double, dmPromo) /* demand model: base rate (0 = default), price elasticity, promo lift */ \
+    X(int, shelfLife) X(LotRing, lots) /* days a received unit can be sold (0 = stock not dated); its lots */ \
+    X(int, id) X(int, nameOff)
+/* Columns rebuilt from other state (not persisted) */
+#define CATALOG_DERIVED_COLUMNS(X) \
+    X(int, onOrder) X(int, polIdx) X(double, dmLam) X(double, dmExp) /* rate before seasonality; exp(-rate x dmFactor) */
+#define CATALOG_ALL_COLUMNS(X) CATALOG_COLUMNS(X) CATALOG_DERIVED_COLUMNS(X)
+/* Column bits for cat_own() */
+enum {
+#define X(type, field) CATCOL_##field,
+    CATALOG_ALL_COLUMNS(X)
+#undef X
+    CATCOL_COUNT
+};
+#define CATCOL(field) (1ull << CATCOL_##field)
+/* Columns simulate_day() writes, and those forecast_update() writes */
+#define CAT_DAY_COLUMNS (CATCOL(stock) | CATCOL(requested) | CATCOL(served) | CATCOL(stockouts) | CATCOL(wasteUnits) | \
+                         CATCOL(revenue) | CATCOL(cogs) | CATCOL(ordersCost) | CATCOL(onOrder) | CATCOL(lots))
+#define CAT_FORECAST_COLUMNS (CATCOL(fcLevel) | CATCOL(fcTrend) | CATCOL(fcMse) | CATCOL(fcDays) | CATCOL(fcSeason0) | CATCOL(fcSeason1) | \
+                              CATCOL(fcSeason2) | CATCOL(fcSeason3) | CATCOL(fcSeason4) | CATCOL(fcSeason5) | CATCOL(fcSeason6))
+
+/* Product catalog as struct-of-arrays: one CAT_ALIGN-aligned array per column, grown on demand */
+typedef struct {
+    int n, cap;
+#define X(type, field) type* field;
+    CATALOG_ALL_COLUMNS(X)
+#undef X
+    StrTable names;
+    int polStart[POL_COUNT + 1];   /* polIdx[polStart[t] .. polStart[t+1]) = SKUs with policy t, catalog order */
+    int polDirty;                  /* policy column changed -> rebuild polIdx */
+    int dmDirty;                   /* price, flags or a demand column changed -> rebuild dmLam */
+    double dmFactor;               /* season factor dmExp was computed for, -1 = none */
+    int lotDirty;                  /* stock or shelfLife changed outside the day loop -> lots_sync() */
+} Catalog;
+
+typedef struct {
+    int daysDefault;
+    int reorder_point;      // s
+    int order_quantity;     // Q
+    int leadMin, leadMax;   // inclusive
+    double orderCostFixed;  // per PO
+    double taxRate;
+    unsigned long long seed; // 0 = pick from clock at start
+    int fcModel;            // FC_*
+    double fcAlpha, fcBeta, fcGamma;   // level, trend, season smoothing
+    double serviceLevel;    // cycle service level of forecast policies
+    double coverDays;       // forecast policies: S = s + coverDays x daily forecast
+    int defaultPolicy;      // SKUs without their own policy: POL_CONFIG or POL_FORECAST
+    double seasonWeek[7];   // demand factor by day % 7
+    double seasonYear[SEASON_YEAR_MAX]; int nSeasonYear;   // annual demand curve spread over 365 days, 0 = flat
+} Config;
+
+typedef struct PO {
+    int poId;
+    int productIndex;
+    int qty;
+    int dueDay;
+    int leadTime;
+    struct PO* next;
+} PO;
+
+/* Open POs as a calendar queue: bucket (dueDay & (nb-1)) holds the FIFO of POs due that day.
+   Every open PO is due in (today, today+nb], so each bucket holds a single due day. */
+typedef struct {
+    PO** head; PO** tail;
+    int nb;      /* bucket count, power of two; grown when a lead time does not fit */
+    int count;   /* open POs */
+    PO* freeNodes;          /* node pool: received POs, reused before a new slab is allocated */
+    void* slabs;            /* PoSlab chain; each slab as large as all the previous ones together */
+    int capacity;           /* nodes in all slabs */
+    long long heapAllocs;   /* slabs and bucket arrays allocated */
+} POBook;
+
+/* Bump allocator for one day's scratch arrays: arena_reset() at the start of the day gives back
+   everything at once. A day that outgrows the block chains another one; the next reset merges
+   them into one block of the peak size, so from then on a day allocates nothing. */
+typedef struct ArenaBlock { struct ArenaBlock* prev; size_t size; } ArenaBlock;
+typedef struct {
+    ArenaBlock* block;
+    size_t used, inUse, peak;   /* in the current block, since the reset, most since creation */
+    long long heapAllocs;       /* blocks allocated */
+} Arena;
+
+typedef struct {
+    double revenue, cogs, ordersCost, profit;
+    long long requested, served, stockouts, wasteUnits;
+} DayTotals;
+
+/* Catalog-wide running totals, advanced by simulate_day(); valid = 0 -> rebuilt from the catalog on demand */
+typedef struct {
+    double revenue, cogs, ordersCost;
+    long long requested, served, stockouts, wasteUnits;
+    int valid;
+} Aggregates;
+
+/* Indexed binary max-heap over product indices: heap[slot] = product, pos[product] = slot.
+   Order: higher key first, ties by lower product index (stable across runs). */
+typedef struct { int* heap; int* pos; double* key; int n; } RankHeap;
+/* Top-K indexes behind the reports; kept current by simulate_day() once built */
+typedef struct {
+    RankHeap profit, stockouts; int valid;
+    int* frontier; int frontierCap;   /* rank_top() work space, grown to the largest K + 1 asked for */
+} Ranking;
+
+/* Philox4x32-10 counter-based stream: output block = philox(ctr, key).
+   ctr = { block, day, product, purpose }, key = simulation/replication key.
+   flip = ~0u turns every uniform u into 1-u (the antithetic twin of the same stream). */
+typedef struct {
+    unsigned int ctr[4], key[2];
+    unsigned int buf[4]; int left;
+    unsigned int flip;
+} Rng;
+
+/* Process-level settings from config.txt; not part of the saved simulation state */
+typedef struct {
+    int logFormat;       /* LOG_FMT_* */
+    int logFlushDays;    /* hand log data to the OS every N days; 0 = only on exit */
+    int checkpointDays;  /* compact the journal into a new checkpoint at least every N days */
+} RunOptions;
+
+/* Read-only view of a whole file (see map_file) */
+typedef struct { const unsigned char* p; size_t size; int mapped; void* hFile; void* hMap; } MappedFile;
+typedef struct { long long size, mtime; } FileStamp;
+
+/* One parsed CSV record: fields unescaped into buf */
+typedef struct { char* buf; size_t len, cap; size_t off[CSV_MAX_FIELDS]; char* fld[CSV_MAX_FIELDS]; int n; const char* bad; } CsvRow;
+typedef struct { long long line; char msg[96]; } CsvError;
+typedef struct {
+    const char* rawBegin, * rawEnd;    /* even byte split */
+    long long quotes, newlines;        /* in the raw slice */
+    const char* begin, * end;          /* records starting in [begin, end) */
+    long long line;                    /* line number at begin */
+    Catalog cat;                       /* rows of this chunk */
+    CsvError err[CSV_MAX_ERRORS]; long long errors; int oom;
+} CsvChunk;
+typedef struct { CsvChunk* ch; int nChunks, pass; const int* pcol; int hasPolicy, shelfCol; volatile long next; } CsvJob;
+
+/* Checkpoint: header + section table, every section CKPT_ALIGN-aligned so the file can be mapped.
+   Columns are found by name, so adding a column does not break older checkpoints. */
+typedef struct { char name[16]; unsigned long long offset, bytes; unsigned int elemSize, count; } CkptSection;
+typedef struct {
+    unsigned int magic, version, endian, hdrSize;
+    unsigned long long epoch;   /* identifies the journal that continues this checkpoint */
+    int day, nextPO, n, nSections;
+    CkptSection sec[CKPT_MAX_SECTIONS];
+} CkptHeader;
+
+/* Journal: file header, then one record per simulated day */
+typedef struct { unsigned int magic, version, endian, pad; unsigned long long epoch; } JournalFileHdr;
+typedef struct {
+    unsigned int magic, bytes, checksum;   /* bytes/checksum cover the payload after this header */
+    int day, nextPO, nChanged, nCreated, nReceived;
+} JournalDayHdr;
+typedef struct { int index, requested, served, waste; } JournalSku;   /* only SKUs with demand or waste that day */
+typedef struct { int poId, productIndex, qty, dueDay, leadTime; double orderCost; } NewPO;   /* PO placed today */
+
+typedef struct {
+    FILE* f;
+    char* buf; size_t len, cap;   /* day record being built */
+    int every;                    /* RunOptions.checkpointDays */
+    int days;                     /* records since the checkpoint */
+    long long bytes, ckptBytes;   /* journal size / size of the last checkpoint */
+} Journal;
+
+/* Binary log: each stream file starts with LogFileHdr, followed by fixed-size records */
+typedef struct { unsigned int magic, stream, recSize, endian; } LogFileHdr;
+typedef struct { int day, productId, requested, served, shortage, waste; double unitPrice; } LogSaleRec;
+typedef struct { int poId, dayPlaced, productId, qty, dueDay, leadTime; double orderCost; } LogOrderRec;
+typedef struct { int day, pad; double revenue, cogs, orders, profit, fillRate; long long stockouts; } LogDailyRec;
+typedef struct { int productId, len; } LogNameRec;   /* followed by len bytes of name */
+
+typedef struct LogBuf {
+    struct LogBuf* next;
+    int stream, flush;   /* flush: fflush the stream after writing this buffer */
+    size_t len;
+    char data[LOG_BUF_BYTES];
+} LogBuf;
+
+/* Rows are formatted into per-stream buffers by the simulation thread; full buffers are queued
+   to a background writer thread, which owns the FILE handles */
+typedef struct {
+    int format, flushDays;
+    FILE* f[LOG_STREAMS];
+    LogBuf* cur[LOG_STREAMS];       /* being filled (simulation thread only) */
+    LogBuf* freeList;               /* guarded by mu */
+    LogBuf* qHead, * qTail;         /* guarded by mu */
+    void* mem;                      /* LogBuf pool */
+    mm_mutex mu; mm_cond cvWork, cvFree;
+    mm_thread writer; int stop;
+    long long bytes;                /* bytes handed to the writer */
+} Logger;
+
+typedef struct { double total, max; long long count; long long hist[STATS_BUCKETS]; } PhaseStats;
+/* Per-simulation instrumentation (only filled in MM_STATS builds); phase[PH_COUNT] is the whole day */
+typedef struct {
+    PhaseStats phase[PH_COUNT + 1];
+    double cur[PH_COUNT]; unsigned int seen;   /* current day, by phase */
+    long long days, draws, posCreated, posReceived, logBytes, logMark, saveBytes, checkpoints, journalDays, heapAllocs;
+} Stats;
+
+/* Multi-echelon: a store's reorders of the day, sent to its warehouse instead of the supplier.
+   granted[k] is filled by the warehouse's allocation step. */
+typedef struct { int* item; int* qty; int* granted; int n, cap; } Outbox;
+
+/* One independent trajectory: everything simulate_day() reads or writes */
+typedef struct {
+    Config  cfg;
+    Catalog cat;
+    POBook  pos;             /* open purchase orders */
+    Arena   scratch;         /* simulate_day() scratch arrays, reset every day */
+    int     day;
+    int     nextPO;
+    unsigned long long rngKey; /* key of all random streams (cfg.seed, or derived per replication) */
+    unsigned int rngFlip;    /* 0, or ~0u: antithetic replication (Rng.flip) */
+    double  lambdaSum;       /* expected units requested so far (sum of the daily Poisson means) */
+
+    int     verbose;         /* per-day console output */
+    Journal* jnl;            /* end-of-day persistence, NULL = none */
+    unsigned long long stateEpoch; /* checkpoint the journal continues, 0 = none yet */
+    Logger* log;             /* NULL = no logging */
+    Aggregates agg;          /* catalog-wide totals for the reports */
+    Ranking* rank;           /* built by the first report, NULL = none */
+    Outbox* outbox;          /* multi-echelon store: reorders go here, NULL = straight to the supplier */
+    const POBook* posFrom;   /* forked (sim_fork): open POs still read from the parent, copied before the first day */
+#ifdef MM_STATS
+    Stats*  stats;           /* NULL = not instrumented */
+#endif
+} Sim;
+
+/* End-of-run KPIs of one replication */
+typedef struct {
+    double revenue, cogs, ordersCost, profit, fillRate;
+    long long requested, served, stockouts, wasteUnits;
+    double demandMean;       /* expected units requested (Sim.lambdaSum): the control variate's mean */
+} RepKPI;
+
+typedef struct { double mean, sd, ciLo, ciHi, p5, p50, p95; } KpiStats;
+
+/* Optimizer: KPIs of one policy group (SKUs sharing an (s,Q)) */
+typedef struct { double profit; long long requested, served; } GroupKPI;
+
+typedef struct {
+    const Sim* proto; int days, reps;
+    unsigned long long seed;
+    const int* groupOf; int nGroups;       /* SKU -> policy group */
+    const int* candS, * candQ; int nCand;  /* [nCand * nGroups] */
+    GroupKPI* out;                         /* [nCand * reps * nGroups] */
+    volatile long next;                    /* next (candidate, replication) to claim */
+    volatile long failed;                  /* replications that could not be run (OOM) */
+} OptJob;
+
+/* Persistent worker pool. pool_run() splits tasks [0,n) into one contiguous range per worker;
+   a worker whose range is empty steals the upper half of the fullest other range. */
+typedef void (*PoolFn)(void* ctx, int task);
+typedef struct { int lo, hi; mm_mutex mu; char pad[64 - 2 * sizeof(int)]; } PoolRange;
+struct Pool;
+typedef struct { struct Pool* pool; int id; } PoolWorker;
+typedef struct Pool {
+    int threads;
+    mm_thread th[MAX_THREADS]; PoolWorker w[MAX_THREADS];
+    PoolRange* range;                  /* [threads] */
+    PoolFn fn; void* ctx;
+    mm_mutex mu; mm_cond cvStart, cvDone;
+    long gen; int busy, stop;          /* guarded by mu */
+} Pool;
+
+/* Multi-echelon network: stores (Sim clones with an Outbox) replenished by warehouses (Sims without demand).
+   Store s is served by warehouse s % nWh. */
+typedef struct {
+    Sim* store; Outbox* box; int nStores;
+    Sim* wh; int nWh;
+    long long** need; int** left;      /* [nWh][n] allocation scratch, one row per warehouse */
+    int day;
+} Network;
+
+/* Timing wheel event; next links the slot list / free list (indices into TimingWheel.ev) */
+typedef struct { unsigned int time; int type, arg, next; } TwEvent;
+typedef struct {
+    TwEvent* ev; int cap, freeList;    /* event pool */
+    long long count; unsigned int now;
+    int head[TW_LEVELS][TW_SLOTS], tail[TW_LEVELS][TW_SLOTS];
+    unsigned long long mask[TW_LEVELS][TW_WORDS];   /* non-empty slots */
+} TimingWheel;
+
+enum { ID_EV_CUSTOMER, ID_EV_DELIVERY, ID_EV_RESTOCK };
+enum { ID_H_CUSTOMERS, ID_H_REQUESTED, ID_H_SERVED, ID_H_LOST_SHELF, ID_H_LOST_STOCK, ID_H_RESTOCKS, ID_H_DELIVERIES, ID_H_COUNT };
+typedef struct {
+    int openH, closeH;                 /* customers arrive in [openH, closeH) */
+    double basket;                     /* mean items per customer (1 + Poisson) */
+    double shelfDays;                  /* shelf capacity, in days of mean demand (at least 2 units) */
+    int restockMin;                    /* backroom -> shelf delay */
+    int deliveryFrom, deliveryTo;      /* PO delivery window, hours */
+} IntradayOptions;
+/* Per-SKU state of the current day, packed so a basket item touches one cache line; folded into the
+   catalog at closing */
+typedef struct { int shelf, back, cap, pending, requested, served; } IdSku;
+typedef struct { double prob; int alias, pad; } IdAlias;
+typedef struct {
+    IntradayOptions opt;
+    TimingWheel tw;
+    IdSku* sku;
+    IdAlias* pick; double* lam; double lamSum;   /* basket item choice: alias table on lambda */
+    double profileSum, profileMax;     /* hourly profile over the opening hours */
+    PO** po; int poCap;                /* today's deliveries, by event arg */
+    long long hour[24][ID_H_COUNT];    /* current day, by hour */
+    long long events;
+} Intraday;
+
+/* What-if branch: a fork of the current state plus changes; change[k] applies before day at[k]
+   (at or before the first simulated day = at the fork) */
+#define SCN_MAX_BRANCHES 16
+#define SCN_MAX_CHANGES  8
+typedef struct {
+    char name[32];
+    char change[SCN_MAX_CHANGES][96]; int at[SCN_MAX_CHANGES]; int nChanges;
+    Sim sim; RepKPI kpi;
+} Scenario;
+typedef struct { Scenario* sc; int days; } ScnJob;
+
+typedef struct {
+    const Sim* proto;        /* starting state, cloned per replication */
+    int days, first, reps;   /* this call runs replications [first, reps) */
+    int anti;                /* antithetic pairs: replication 2k+1 = replication 2k with every uniform mirrored */
+    unsigned long long seed;
+    RepKPI* out;             /* [reps] */
+    const Scenario* vs;      /* NULL, or each replication also runs with these changes into outVs[r] */
+    unsigned long long vsSeed; /* == seed: common random numbers for both runs */
+    RepKPI* outVs;
+    volatile long next;      /* next replication to claim */
+    volatile long failed;    /* replications that could not be run (OOM) */
+#ifdef MM_STATS
+    Stats* stats; mm_mutex mu;   /* workers merge their own Stats into *stats; NULL = off */
+#endif
+} RepJob;
+
+/* Server mode: the simulation thread publishes a Snapshot at every day boundary; client threads
+   answer read requests from it while the next days run */
+#define SRV_MAX_CLIENTS 64
+#define SRV_LINE_MAX    4096
+typedef struct {
+    volatile long refs;   /* 1 while current + 1 per reader; freed by whoever drops the last one */
+    long long epoch;      /* snapshots published so far */
+    Sim sim;              /* copy-on-write fork of the live simulation (read only) */
+    DayTotals last;       /* totals of its last day */
+    double at;            /* wall_seconds() at publication */
+} Snapshot;
+typedef struct { char* p; size_t n, cap; } SrvBuf;   /* response being built */
+/* A change made on the simulation thread between two days; the client waits for done. Once taken off
+   the queue the simulation thread always completes it, so the client must wait even when stopping. */
+typedef struct SrvRequest { int type; char line[256]; int taken, done, ok; struct SrvRequest* next; } SrvRequest;
+struct Server;
+typedef struct { struct Server* srv; mm_socket fd; mm_thread t; int used; volatile long done; } SrvClient;
+typedef struct Server {
+    Sim* S;
+    mm_mutex mu; mm_cond cvWork, cvDone;   /* mu guards the fields up to `stop` */
+    long long queued;                      /* days still to run */
+    int running, dayDone;                  /* a day in progress; last completed day */
+    SrvRequest* reqHead, * reqTail;
+    int stop;
+    mm_mutex snapMu; Snapshot* cur;        /* snapMu only covers taking a reference to cur */
+    mm_socket listenFd; mm_thread acceptor; char unixPath[108];
+    SrvClient client[SRV_MAX_CLIENTS]; volatile long clients;   /* connected */
+} Server;
+
+/* Log query index (sim_log.idx): header, then segments of whole days. Segment columns start 8-byte aligned at
+   off[] (relative to the segment); sale/order rows are sorted by (day, productId), and DAYS[d - firstDay] ..
+   DAYS[d - firstDay + 1] are the rows of day d. */
+enum {
+    QC_S_DAYS, QC_S_ID, QC_S_REQ, QC_S_SRV, QC_S_SHORT, QC_S_WASTE, QC_S_PRICE,   /* sale */
+    QC_O_DAYS, QC_O_ID, QC_O_QTY, QC_O_LEAD, QC_O_DUE, QC_O_PO, QC_O_COST,          /* order (day = dayPlaced) */
+    QC_D_DAY, QC_D_REV, QC_D_COGS, QC_D_ORD, QC_D_PROFIT, QC_D_FILL, QC_D_STO,      /* daily */
+    QC_COUNT
+};
+typedef struct {
+    unsigned int magic, version, endian, source;   /* source: LOG_FMT_CSV or LOG_FMT_BINARY */
+    long long consumed[3];                          /* log bytes indexed: CSV file, or sale/order/daily streams */
+    long long headLen; unsigned int headHash, pad;  /* fnv1a of the first headLen bytes of the (sale) log */
+    long long nSegments, bytes;                     /* bytes = file size covered by complete segments */
+} QIndexHdr;
+typedef struct {
+    unsigned int magic; int firstDay, lastDay, pad;
+    long long nSale, nOrder, nDaily, bytes;
+    long long off[QC_COUNT];
+} QSegHdr;
+/* Builder row: sale {requested, served, shortage, waste, unitPrice}, order {qty, lead, due, poId, cost} */
+typedef struct { int day, id, a, b, c, d; double v; } QRow;
+typedef struct { QRow* r; long long n, cap; } QRows;
+typedef struct { QRows sale, order; LogDailyRec* daily; long long nDaily, capDaily; } QBuild;
+
+/* ---------- Globals ---------- */
+static Sim G_sim;            /* interactive simulation */
+#ifdef MM_STATS
+static Stats G_stats;        /* its phase timings (menu 7) */
+#endif
+static const char* FC_MODEL_NAMES[FC_COUNT] = { "ses", "holt", "hw" };   /* config.txt forecast= */
+
+/* ---------- Prototypes ---------- */
+static void clear_line(void);
+static void rng_init(Rng* r, unsigned long long key, unsigned int stream, unsigned int purpose, unsigned int day);
+static unsigned int rng_u32(Rng* r);
+static double rng_u01(Rng* r);
+static int  rand_int(Rng* r, int a, int b);
+static int  sample_poisson(Rng* r, double lambda);
+static int  sample_poisson_cached(Rng* r, double lambda, double expNeg);
+static void sample_poisson_batch(unsigned long long key, unsigned int flip, int day, const double* lambda, const double* expNeg, int* out, int n);
+static unsigned long long rng_key_for(unsigned long long seed, unsigned long long replication);
+
+static void* arena_alloc(Arena* A, size_t bytes);
+static void  arena_reset(Arena* A);
+static void  arena_free(Arena* A);
+#if defined(MM_STATS) || defined(MINIMARKET_BENCH)
+static long long sim_heap_allocs(const Sim* S);
+#endif
+
+static PO* po_create(Sim* S, int productIndex, int qty, int dueDay, int lead);
+static PO*  pobook_node(POBook* B);
+static void pobook_release(POBook* B, PO* list);
+static int  pobook_add(POBook* B, Catalog* C, int today, PO* node);
+static PO*  pobook_pop_due(POBook* B, Catalog* C, int today);
+static PO*  pobook_next(const POBook* B, int today, PO* cur);
+static int  pobook_clone(POBook* dst, const POBook* src);
+static void pobook_free(POBook* B);
+
+static void* mm_aligned_alloc(size_t bytes);
+static void  mm_aligned_free(void* p);
+static int   strtab_intern(StrTable* T, const char* str);
+static void  strtab_free(StrTable* T);
+static int   strtab_clone(StrTable* dst, const StrTable* src);
+static void  cat_init(Catalog* C);
+static int   cat_reserve(Catalog* C, int cap);
+static int   cat_add(Catalog* C, int id, const char* name, double baseCost, double price, int stock, unsigned int flags);
+static void  cat_reset_counters(Catalog* C);
+static int   cat_clone(Catalog* dst, const Catalog* src);
+static int   cat_append(Catalog* dst, const Catalog* src);
+static void  cat_free(Catalog* C);
+static void  cat_fork(Catalog* dst, Catalog* src);
+static int   cat_own(Catalog* C, unsigned long long mask);
+static void  cat_bytes(const Catalog* C, unsigned long long* total, unsigned long long* priv);
+static const char* cat_name(const Catalog* C, int i);
+static void  sales_kernel(Catalog* C, const int* req, int* srv, int* shortage, DayTotals* D);
+
+static void sim_init(Sim* S);
+static void sim_rng(Rng* r, const Sim* S, unsigned int stream, unsigned int purpose);
+static int  sim_clone(Sim* dst, const Sim* src);
+static void sim_fork(Sim* dst, Sim* src);
+static int  sim_own(Sim* S);
+static void sim_free(Sim* S);
+
+static void load_defaults(Config* cfg);
+static void run_options_defaults(RunOptions* opt);
+static void load_config_txt(Config* cfg, RunOptions* opt, const char* path);
+static int  config_apply_line(Config* cfg, RunOptions* opt, const char* line);
+static int  config_to_text(const Config* cfg, char* buf, size_t size);
+static void demo_inventory(Sim* S);
+static void load_inventory_csv(Sim* S, const char* path);
+static const char* csv_record(const char* p, const char* end, CsvRow* R, long long* line);
+static int  parse_int(const char* s, int* out);
+static int  parse_doubles(const char* s, double* out, int max);
+static int  parse_double(const char* s, double* out);
+static int  map_file(MappedFile* m, const char* path);
+static void unmap_file(MappedFile* m);
+static int  file_stamp(const char* path, FileStamp* st);
+
+/* Replenishment policies */
+enum { PCOL_POLICY, PCOL_S, PCOL_Q, PCOL_UPTO, PCOL_R, PCOL_MOQ, PCOL_PACK, PCOL_COUNT };
+static int  policy_columns(char** hdr, int nh, int* col);
+static int  policy_apply_row(Catalog* C, int i, char** fld, int nf, const int* col);
+static void policy_index(Catalog* C);
+static void reorder_quantities(Sim* S, int* qty);
+static int  forecast_active(Sim* S);
+static void forecast_update(Sim* S, const int* y);
+static double normal_quantile(double p);
+
+static Logger* log_open(int format, int flushDays, int truncate, const Catalog* C);
+static void   log_end_day(Logger* L, int day);
+static void   log_close(Logger* L);
+static int    log_binary_to_csv(const char* outPath);
+static void   open_single_log_append(Sim* S, const RunOptions* opt);
+static void   reset_single_log_and_state(Sim* S);
+static void   close_single_log(Sim* S);
+
+static double demand_lambda_for(const Catalog* C, int i);
+static void   demand_index(Catalog* C);
+static double demand_refresh(Sim* S);
+static int    waste_units_for_day(Rng* r, int stock, unsigned int flags);
+static void   lot_push(LotRing* L, int qty, int useBy);
+static int    lot_take(LotRing* L, int qty);
+static int    lot_expire(LotRing* L, int day);
+static void   lot_receive(Catalog* C, int i, int qty, int day);
+static int    lots_end_day(Catalog* C, int i, int sold, int day);
+static void   lots_sync(Catalog* C, int day);
+static void   log_sale_row(Sim* S, int day, int i, int req, int srv, int shortage, int waste);
+static void   log_order_row(Sim* S, int dayPlaced, int poId, int i, int qty, int dueDay, int leadTime, double orderCost);
+static void   log_daily(Sim* S, int day, const DayTotals* D);
+
+static int  outbox_push(Outbox* B, int item, int qty);
+static void simulate_day(Sim* S, DayTotals* out);
+static void agg_sync(Sim* S);
+static int  rank_sync(Sim* S);
+static void rank_update(Ranking* R, const Catalog* C, int i);
+static int  rank_top(Ranking* R, const RankHeap* H, int K, int* out);
+static void print_top_stockouts(Sim* S, int K);
+static void rank_free(Ranking* R);
+static void report_top_products_by_profit(Sim* S);
+static void report_service_and_stockouts(Sim* S);
+static void report_summary_cumulative(Sim* S);
+static void show_open_pos(Sim* S);
+static int  fast_forward(Sim* S, int days, int writeLog);
+static int  headless_fast_forward(int argc, char** argv);
+static void open_session(Sim* S);
+static void print_menu(const Sim* S);
+
+/* Welcome screen */
+static void clear_screen(void);
+static void wait_enter(void);
+static void show_welcome(void);
+
+/* NEW: persistence */
+static int  save_state(Sim* S, const char* path);
+static int  load_state(Sim* S, const char* path);
+static Journal* journal_open(int checkpointDays);
+static void journal_end_day(Sim* S, const int* req, const int* srv, const int* waste, int nReceived, const NewPO* created, int nCreated);
+static void journal_close(Journal* J);
+
+/* Instrumentation */
+#ifdef MM_STATS
+static double stats_lap(Stats* St, double t0, int phase);
+static void stats_end_day(Stats* St, const Sim* S);
+static void stats_merge(Stats* dst, const Stats* src);
+static void stats_write(FILE* f, const Stats* St, int format);
+#endif
+static int  stats_format(const char* name);
+
+/* Replications (headless Monte Carlo) */
+static int  cpu_count(void);
+static void sim_collect_kpi(const Sim* S, RepKPI* k);
+static int  run_replications(RepJob* J, int threads, Stats* stats);
+static void kpi_stats(double* v, int n, KpiStats* st);
+static int  headless_replicate(int argc, char** argv);
+static int  load_policy_csv(Sim* S, const char* path);
+static int  load_demand_csv(Sim* S, const char* path);
+static int  headless_optimize(int argc, char** argv);
+static int  pool_start(Pool* P, int threads);
+static void pool_run(Pool* P, int n, PoolFn fn, void* ctx);
+static void pool_stop(Pool* P);
+static int  headless_network(int argc, char** argv);
+static int  tw_push(TimingWheel* W, unsigned int time, int type, int arg);
+static int  tw_pop(TimingWheel* W, TwEvent* out);
+static int  headless_intraday(int argc, char** argv);
+static int  scn_apply(Sim* S, const Catalog* ref, const char* change, char* err, size_t errSize);
+static int  scn_parse(Scenario* B, const char* spec, int index, const Catalog* ref, char* err, size_t errSize);
+static int  whatif(Sim* base, const char** specs, int nSpecs, int days, int threads, const char* outPath);
+static int  headless_whatif(int argc, char** argv);
+static int  serve(Sim* S, const char* bindAddr, int port, const char* unixPath);
+static int  headless_serve(int argc, char** argv);
+/* Log query engine */
+static int  cmp_daily_day(const void* a, const void* b);
+static unsigned int qidx_head_hash(const char* path, long long len);
+static long long qidx_update(int source, int rebuild);
+static int  headless_query(int argc, char** argv);
+static int  parse_range(const char* v, int* lo, int* hi, int* step);
+static int  run_command_line(int argc, char** argv);
+
+/* ---------- Portable I/O ---------- */
+/* Standard fopen/scanf only (no MSVC _s variants), so the same source builds with MSVC, GCC and Clang;
+   every file is opened through mm_fopen */
+static FILE* mm_fopen(const char* path, const char* mode) { return fopen(path, mode); }
+/* 64-bit offsets (long is 32 bits on Windows) */
+static int mm_fseek(FILE* f, long long off, int whence) {
+#ifdef _WIN32
+    return _fseeki64(f, off, whence);
+#else
+    return fseeko(f, (off_t)off, whence);
+#endif
+}
+#if defined(MINIMARKET_BENCH) || defined(MINIMARKET_TEST)
+static int mm_chdir(const char* dir) {
+#ifdef _WIN32
+    return _chdir(dir) == 0;
+#else
+    return chdir(dir) == 0;
+#endif
+}
+#endif
+static double wall_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER f, c; QueryPerformanceFrequency(&f); QueryPerformanceCounter(&c); return (double)c.QuadPart / (double)f.QuadPart;
+#else
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* ---------- Statistics ---------- */
+/* STATS_START opens a lap timer; STATS_LAP charges the time since the previous lap to a phase.
+   Both cost one branch when the Sim has no Stats, and nothing at all without MM_STATS. */
+#ifdef MM_STATS
+#define STATS_START(S, t)      double t = ((S)->stats ? wall_seconds() : 0.0)
+#define STATS_LAP(S, t, ph)    do { if ((S)->stats) (t) = stats_lap((S)->stats, (t), (ph)); } while (0)
+#define STATS_ADD(S, field, v) do { if ((S)->stats) (S)->stats->field += (v); } while (0)
+#define STATS_END_DAY(S)       do { if ((S)->stats) stats_end_day((S)->stats, (S)); } while (0)
+static const char* PHASE_NAMES[PH_COUNT + 1] = { "arrivals", "demand", "sales", "waste", "log", "forecast", "reorder", "print", "persist", "day" };
+
+static double stats_lap(Stats* St, double t0, int phase) {
+    double t = wall_seconds(); St->cur[phase] += t - t0; St->seen |= 1u << phase; return t;
+}
+static void stats_record(PhaseStats* P, double sec) {
+    int e = 0; double ns = sec * 1e9; if (ns >= 1.0) frexp(ns, &e);   /* ns in [2^(e-1), 2^e) */
+    P->hist[MIN(e, STATS_BUCKETS - 1)]++; P->count++; P->total += sec; if (sec > P->max) P->max = sec;
+}
+static void stats_end_day(Stats* St, const Sim* S) {
+    double day = 0;
+    for (int p = 0; p < PH_COUNT; p++) if (St->seen & (1u << p)) { stats_record(&St->phase[p], St->cur[p]); day += St->cur[p]; St->cur[p] = 0; }
+    stats_record(&St->phase[PH_COUNT], day); St->seen = 0; St->days++;
+    long long lb = S->log ? S->log->bytes : 0;   /* a reopened log restarts at 0 */
+    St->logBytes += (lb >= St->logMark ? lb - St->logMark : lb); St->logMark = lb;
+}
+static void stats_merge(Stats* dst, const Stats* src) {
+    for (int p = 0; p <= PH_COUNT; p++) {
+        PhaseStats* d = &dst->phase[p]; const PhaseStats* s = &src->phase[p];
+        d->total += s->total; d->count += s->count; if (s->max > d->max) d->max = s->max;
+        for (int b = 0; b < STATS_BUCKETS; b++) d->hist[b] += s->hist[b];
+    }
+    dst->days += src->days; dst->draws += src->draws; dst->posCreated += src->posCreated; dst->posReceived += src->posReceived;
+    dst->logBytes += src->logBytes; dst->saveBytes += src->saveBytes; dst->checkpoints += src->checkpoints; dst->journalDays += src->journalDays;
+    dst->heapAllocs += src->heapAllocs;
+}
+/* Quantile q in seconds, interpolated linearly inside its histogram bucket */
+static double stats_quantile(const PhaseStats* P, double q) {
+    double want = q * P->count, acc = 0;
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        if (!P->hist[b] || acc + P->hist[b] < want) { acc += P->hist[b]; continue; }
+        double lo = (b ? ldexp(1.0, b - 1) : 0.0), hi = ldexp(1.0, b);
+        return MIN((lo + (hi - lo) * (want - acc) / P->hist[b]) * 1e-9, P->max);
+    }
+    return P->max;
+}
+static void stats_write(FILE* f, const Stats* St, int format) {
+    const char* cname[] = { "rng_draws", "pos_created", "pos_received", "log_bytes", "save_bytes", "checkpoints", "journal_days", "heap_allocs" };
+    long long cval[] = { St->draws, St->posCreated, St->posReceived, St->logBytes, St->saveBytes, St->checkpoints, St->journalDays, St->heapAllocs };
+    int nc = (int)(sizeof(cval) / sizeof(cval[0]));
+    double dayTotal = St->phase[PH_COUNT].total;
+    if (format == STATS_FMT_JSON) {
+        fprintf(f, "{\n  \"days\": %lld,\n  \"counters\": {", St->days);
+        for (int c = 0; c < nc; c++) fprintf(f, "%s\"%s\": %lld", c ? ", " : "", cname[c], cval[c]);
+        fprintf(f, "},\n  \"phases\": [\n");
+        for (int p = 0; p <= PH_COUNT; p++) {
+            const PhaseStats* P = &St->phase[p];
+            fprintf(f, "    {\"name\": \"%s\", \"count\": %lld, \"total_s\": %.9g, \"mean_us\": %.6g, \"p50_us\": %.6g, \"p99_us\": %.6g, \"max_us\": %.6g, \"buckets_ns\": [",
+                PHASE_NAMES[p], P->count, P->total, P->count ? P->total / P->count * 1e6 : 0.0, stats_quantile(P, 0.5) * 1e6, stats_quantile(P, 0.99) * 1e6, P->max * 1e6);
+            for (int b = 0, first = 1; b < STATS_BUCKETS; b++) if (P->hist[b]) { fprintf(f, "%s[%.0f, %lld]", first ? "" : ", ", ldexp(1.0, b), P->hist[b]); first = 0; }
+            fprintf(f, "]}%s\n", p < PH_COUNT ? "," : "");
+        }
+        fprintf(f, "  ]\n}\n");
+    }
+    else if (format == STATS_FMT_PROM) {
+        fprintf(f, "# HELP minimarket_phase_seconds Time spent per simulate_day phase (phase=\"day\": whole day).\n# TYPE minimarket_phase_seconds histogram\n");
+        for (int p = 0; p <= PH_COUNT; p++) {
+            const PhaseStats* P = &St->phase[p]; long long acc = 0; int top = 0;
+            for (int b = 0; b < STATS_BUCKETS; b++) if (P->hist[b]) top = b;
+            for (int b = 0; b <= top; b++) { acc += P->hist[b]; fprintf(f, "minimarket_phase_seconds_bucket{phase=\"%s\",le=\"%.9g\"} %lld\n", PHASE_NAMES[p], ldexp(1.0, b) * 1e-9, acc); }
+            fprintf(f, "minimarket_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %lld\n", PHASE_NAMES[p], P->count);
+            fprintf(f, "minimarket_phase_seconds_sum{phase=\"%s\"} %.9g\nminimarket_phase_seconds_count{phase=\"%s\"} %lld\n", PHASE_NAMES[p], P->total, PHASE_NAMES[p], P->count);
+        }
+        fprintf(f, "# TYPE minimarket_days_total counter\nminimarket_days_total %lld\n", St->days);
+        for (int c = 0; c < nc; c++) fprintf(f, "# TYPE minimarket_%s_total counter\nminimarket_%s_total %lld\n", cname[c], cname[c], cval[c]);
+    }
+    else {
+        fprintf(f, "\n=== Performance stats: %lld days ===\n", St->days);
+        fprintf(f, "%-9s %9s %11s %10s %10s %10s %10s %7s\n", "Phase", "Count", "Total ms", "Mean us", "P50 us", "P99 us", "Max us", "Share");
+        for (int p = 0; p <= PH_COUNT; p++) {
+            const PhaseStats* P = &St->phase[p]; if (!P->count) continue;
+            fprintf(f, "%-9s %9lld %11.2f %10.2f %10.2f %10.2f %10.2f %6.1f%%\n", PHASE_NAMES[p], P->count, P->total * 1e3, P->total / P->count * 1e6,
+                stats_quantile(P, 0.5) * 1e6, stats_quantile(P, 0.99) * 1e6, P->max * 1e6, dayTotal > 0 ? 100.0 * P->total / dayTotal : 0.0);
+        }
+        fprintf(f, "Counters:");
+        for (int c = 0; c < nc; c++) fprintf(f, " %s=%lld", cname[c], cval[c]);
+        fprintf(f, "\n(P50/P99 interpolated within power-of-two histogram buckets)\n");
+    }
+}
+#else
+#define STATS_START(S, t)      ((void)0)
+#define STATS_LAP(S, t, ph)    ((void)0)
+#define STATS_ADD(S, field, v) ((void)0)
+#define STATS_END_DAY(S)       ((void)0)
+#endif
+
+/* ---------- Utils ---------- */
+static void clear_line(void) { int c; while ((c = getchar()) != '\n' && c != EOF) {} }
+static unsigned long long splitmix64(unsigned long long* x) {
+    unsigned long long z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL; z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* ---------- RNG (Philox4x32-10 streams) ---------- */
+static void philox4x32_10(const unsigned int ctr[4], const unsigned int key[2], unsigned int out[4]) {
+    unsigned int c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3], k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        unsigned long long p0 = 0xD2511F53ULL * c0, p1 = 0xCD9E8D57ULL * c2;
+        c0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0; c1 = (unsigned int)p1;
+        c2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1; c3 = (unsigned int)p0;
+        k0 += 0x9E3779B9u; k1 += 0xBB67AE85u;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+/* Independent stream for (key, stream, purpose, day): no hidden state, so draws do not depend on
+   the order products/days/replications are simulated in, nor on which thread runs them */
+static void rng_init(Rng* r, unsigned long long key, unsigned int stream, unsigned int purpose, unsigned int day) {
+    r->key[0] = (unsigned int)key; r->key[1] = (unsigned int)(key >> 32);
+    r->ctr[0] = 0; r->ctr[1] = day; r->ctr[2] = stream; r->ctr[3] = purpose; r->left = 0; r->flip = 0;
+}
+static unsigned int rng_u32(Rng* r) {
+    if (r->left == 0) { philox4x32_10(r->ctr, r->key, r->buf); r->ctr[0]++; r->left = 4; }
+    return r->buf[--r->left] ^ r->flip;
+}
+/* Uniform on the open interval (0,1) */
+static double rng_u01(Rng* r) { return ((double)rng_u32(r) + 0.5) * (1.0 / 4294967296.0); }
+static unsigned long long rng_key_for(unsigned long long seed, unsigned long long replication) {
+    unsigned long long x = seed ^ (replication * 0xD1B54A32D192ED03ULL); return splitmix64(&x);
+}
+/* Uniform integer in [a,b] without modulo bias (Lemire's multiply-and-reject) */
+static int rand_int(Rng* r, int a, int b) {
+    if (b < a) { int t = a; a = b; b = t; }
+    unsigned int range = (unsigned int)(b - a) + 1u; if (range == 0) return (int)rng_u32(r);
+    unsigned long long m = (unsigned long long)rng_u32(r) * range; unsigned int low = (unsigned int)m;
+    if (low < range) {
+        unsigned int thresh = (0u - range) % range;
+        while (low < thresh) { m = (unsigned long long)rng_u32(r) * range; low = (unsigned int)m; }
+    }
+    return a + (int)(m >> 32);
+}
+/* Poisson: sequential inversion for small lambda (one uniform, ~lambda steps),
+   Hormann's transformed rejection (PTRS) above POISSON_PTRS_MIN (constant expected time).
+   expNeg = exp(-lambda) when lambda < POISSON_PTRS_MIN (cached per SKU by the demand model). */
+static int poisson_invert(double u, double lambda, double expNeg) {
+    double p = expNeg, F = p; int k = 0;
+    while (u > F && k < 1000) { k++; p *= lambda / k; F += p; }
+    return k;
+}
+static int sample_poisson_cached(Rng* r, double lambda, double expNeg) {
+    if (lambda <= 0.0) return 0;
+    if (lambda < POISSON_PTRS_MIN) return poisson_invert(rng_u01(r), lambda, expNeg);
+    double slam = sqrt(lambda), loglam = log(lambda);
+    double b = 0.931 + 2.53 * slam, a = -0.059 + 0.02483 * b;
+    double invalpha = 1.1239 + 1.1328 / (b - 3.4), vr = 0.9277 - 3.6224 / (b - 2.0);
+    for (;;) {
+        double U = rng_u01(r) - 0.5, V = rng_u01(r), us = 0.5 - fabs(U);
+        double k = floor((2.0 * a / us + b) * U + lambda + 0.43);
+        if (us >= 0.07 && V <= vr) return (int)k;
+        if (k < 0 || (us < 0.013 && V > us)) continue;
+        if (log(V) + log(invalpha) - log(a / (us * us) + b) <= -lambda + k * loglam - lgamma(k + 1.0)) return (int)k;
+    }
+}
+static int sample_poisson(Rng* r, double lambda) { return sample_poisson_cached(r, lambda, lambda < POISSON_PTRS_MIN ? exp(-lambda) : 0.0); }
+/* One day of demand for n SKUs: out[i] ~ Poisson(lambda[i]) from stream (key, i, RNG_DEMAND, day); expNeg as in sample_poisson_cached */
+#if defined(__AVX512F__) || defined(__AVX2__)
+/* w[j] = first rng_u32() of stream (key, i0 + j, purpose, day), j < 8: word 3 of Philox block 0, for 8 streams
+   at once (64-bit lanes holding 32-bit words, so the 32x32->64 products are one mul_epu32) */
+static void philox_first8(unsigned long long key, unsigned int day, unsigned int i0, unsigned int purpose, unsigned int* w) {
+    unsigned int k0 = (unsigned int)key, k1 = (unsigned int)(key >> 32);
+#if defined(__AVX512F__)
+    const __m512i m0 = _mm512_set1_epi64(0xD2511F53LL), m1 = _mm512_set1_epi64(0xCD9E8D57LL), lo = _mm512_set1_epi64(0xFFFFFFFFLL);
+    __m512i c0 = _mm512_setzero_si512(), c1 = _mm512_set1_epi64(day), c3 = _mm512_set1_epi64(purpose);
+    __m512i c2 = _mm512_add_epi64(_mm512_set1_epi64(i0), _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0));
+    for (int round = 0; round < 10; round++) {
+        __m512i p0 = _mm512_mul_epu32(c0, m0), p1 = _mm512_mul_epu32(c2, m1);
+        c0 = _mm512_xor_si512(_mm512_srli_epi64(p1, 32), _mm512_xor_si512(c1, _mm512_set1_epi64(k0))); c1 = _mm512_and_si512(p1, lo);
+        c2 = _mm512_xor_si512(_mm512_srli_epi64(p0, 32), _mm512_xor_si512(c3, _mm512_set1_epi64(k1))); c3 = _mm512_and_si512(p0, lo);
+        k0 += 0x9E3779B9u; k1 += 0xBB67AE85u;
+    }
+    _mm256_storeu_si256((__m256i*)w, _mm512_cvtepi64_epi32(c3));
+#else
+    const __m256i m0 = _mm256_set1_epi64x(0xD2511F53LL), m1 = _mm256_set1_epi64x(0xCD9E8D57LL), lo = _mm256_set1_epi64x(0xFFFFFFFFLL);
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    for (int h = 0; h < 8; h += 4) {
+        unsigned int a = k0, b = k1;
+        __m256i c0 = _mm256_setzero_si256(), c1 = _mm256_set1_epi64x(day), c3 = _mm256_set1_epi64x(purpose);
+        __m256i c2 = _mm256_add_epi64(_mm256_set1_epi64x(i0 + h), _mm256_setr_epi64x(0, 1, 2, 3));
+        for (int round = 0; round < 10; round++) {
+            __m256i p0 = _mm256_mul_epu32(c0, m0), p1 = _mm256_mul_epu32(c2, m1);
+            c0 = _mm256_xor_si256(_mm256_srli_epi64(p1, 32), _mm256_xor_si256(c1, _mm256_set1_epi64x(a))); c1 = _mm256_and_si256(p1, lo);
+            c2 = _mm256_xor_si256(_mm256_srli_epi64(p0, 32), _mm256_xor_si256(c3, _mm256_set1_epi64x(b))); c3 = _mm256_and_si256(p0, lo);
+            a += 0x9E3779B9u; b += 0xBB67AE85u;
+        }
+        _mm_storeu_si128((__m128i*)(w + h), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(c3, even)));
+    }
+#endif
+}
+#endif
+static void sample_poisson_batch(unsigned long long key, unsigned int flip, int day, const double* lambda, const double* expNeg, int* out, int n) {
+    Rng r; int i = 0;
+#if defined(__AVX512F__) || defined(__AVX2__)
+    /* inversion needs one uniform: 8 SKUs' first words at once; PTRS (more uniforms) keeps its own stream */
+    unsigned int w[8];
+    for (; i + 8 <= n; i += 8) {
+        philox_first8(key, (unsigned)day, (unsigned)i, RNG_DEMAND, w);
+        for (int j = 0; j < 8; j++) {
+            double lam = lambda[i + j];
+            if (lam > 0.0 && lam < POISSON_PTRS_MIN) out[i + j] = poisson_invert(((double)(w[j] ^ flip) + 0.5) * (1.0 / 4294967296.0), lam, expNeg[i + j]);
+            else { rng_init(&r, key, (unsigned)(i + j), RNG_DEMAND, (unsigned)day); r.flip = flip; out[i + j] = sample_poisson_cached(&r, lam, expNeg[i + j]); }
+        }
+    }
+#endif
+    for (; i < n; i++) { rng_init(&r, key, (unsigned)i, RNG_DEMAND, (unsigned)day); r.flip = flip; out[i] = sample_poisson_cached(&r, lambda[i], expNeg[i]); }
+}
+
+/* ---------- Threads ---------- */
+#ifdef _WIN32
+static int  thread_start(mm_thread* t, DWORD(WINAPI* fn)(LPVOID), void* arg) { *t = CreateThread(NULL, 0, fn, arg, 0, NULL); return *t != NULL; }
+static void thread_join(mm_thread t) { WaitForSingleObject(t, INFINITE); CloseHandle(t); }
+static long atomic_next(volatile long* p) { return InterlockedIncrement(p) - 1; }
+static long atomic_add(volatile long* p, long v) { return InterlockedExchangeAdd(p, v) + v; }
+static int  cpu_count(void) { SYSTEM_INFO si; GetSystemInfo(&si); return (int)si.dwNumberOfProcessors; }
+static void mutex_init(mm_mutex* m) { InitializeCriticalSection(m); }
+static void mutex_destroy(mm_mutex* m) { DeleteCriticalSection(m); }
+static void mutex_lock(mm_mutex* m) { EnterCriticalSection(m); }
+static void mutex_unlock(mm_mutex* m) { LeaveCriticalSection(m); }
+static void cond_init(mm_cond* c) { InitializeConditionVariable(c); }
+static void cond_destroy(mm_cond* c) { (void)c; }
+static void cond_wait(mm_cond* c, mm_mutex* m) { SleepConditionVariableCS(c, m, INFINITE); }
+static void cond_signal(mm_cond* c) { WakeConditionVariable(c); }
+static void cond_broadcast(mm_cond* c) { WakeAllConditionVariable(c); }
+#else
+static int  thread_start(mm_thread* t, void* (*fn)(void*), void* arg) { return pthread_create(t, NULL, fn, arg) == 0; }
+static void thread_join(mm_thread t) { pthread_join(t, NULL); }
+static long atomic_next(volatile long* p) { return __sync_fetch_and_add(p, 1); }
+static long atomic_add(volatile long* p, long v) { return __sync_add_and_fetch(p, v); }
+static int  cpu_count(void) { long n = sysconf(_SC_NPROCESSORS_ONLN); return n > 0 ? (int)n : 1; }
+static void mutex_init(mm_mutex* m) { pthread_mutex_init(m, NULL); }
+static void mutex_destroy(mm_mutex* m) { pthread_mutex_destroy(m); }
+static void mutex_lock(mm_mutex* m) { pthread_mutex_lock(m); }
+static void mutex_unlock(mm_mutex* m) { pthread_mutex_unlock(m); }
+static void cond_init(mm_cond* c) { pthread_cond_init(c, NULL); }
+static void cond_destroy(mm_cond* c) { pthread_cond_destroy(c); }
+static void cond_wait(mm_cond* c, mm_mutex* m) { pthread_cond_wait(c, m); }
+static void cond_signal(mm_cond* c) { pthread_cond_signal(c); }
+static void cond_broadcast(mm_cond* c) { pthread_cond_broadcast(c); }
+#endif
+
+/* ---------- Memory (day arena, PO node pool) ---------- */
+#define ARENA_MIN_BLOCK (64 * 1024)
+#define POPOOL_MIN_SLAB 64
+typedef struct PoSlab { struct PoSlab* next; int nodes; } PoSlab;   /* followed by `nodes` POs */
+
+/* CAT_ALIGN-aligned, uninitialized; NULL on OOM */
+static void* arena_alloc(Arena* A, size_t bytes) {
+    bytes = (bytes + CAT_ALIGN - 1) & ~(size_t)(CAT_ALIGN - 1); if (!bytes) bytes = CAT_ALIGN;
+    if (!A->block || A->used + bytes > A->block->size) {
+        size_t size = MAX(MAX(bytes, A->peak), (size_t)ARENA_MIN_BLOCK);
+        if (A->block) size = MAX(size, 2 * A->block->size);
+        ArenaBlock* b = (ArenaBlock*)mm_aligned_alloc(CAT_ALIGN + size); if (!b) return NULL;
+        b->prev = A->block; b->size = size; A->block = b; A->used = 0; A->heapAllocs++;
+    }
+    void* p = (char*)A->block + CAT_ALIGN + A->used;
+    A->used += bytes; A->inUse += bytes; if (A->inUse > A->peak) A->peak = A->inUse;
+    return p;
+}
+static void arena_reset(Arena* A) {
+    if (A->block && A->block->prev) { size_t peak = A->peak; long long n = A->heapAllocs; arena_free(A); A->peak = peak; A->heapAllocs = n; }
+    A->used = A->inUse = 0;
+}
+static void arena_free(Arena* A) {
+    while (A->block) { ArenaBlock* b = A->block; A->block = b->prev; mm_aligned_free(b); }
+    memset(A, 0, sizeof(*A));
+}
+
+/* Adds a slab of `nodes` free nodes, threaded in address order */
+static int pobook_grow(POBook* B, int nodes) {
+    PoSlab* sl = (PoSlab*)malloc(sizeof(PoSlab) + sizeof(PO) * (size_t)nodes); if (!sl) return 0;
+    sl->next = (PoSlab*)B->slabs; sl->nodes = nodes; B->slabs = sl; B->capacity += nodes; B->heapAllocs++;
+    PO* n = (PO*)(sl + 1);
+    for (int k = 0; k < nodes - 1; k++) n[k].next = &n[k + 1];
+    n[nodes - 1].next = B->freeNodes; B->freeNodes = n;
+    return 1;
+}
+/* One node from the pool (fields unset); NULL on OOM */
+static PO* pobook_node(POBook* B) {
+    if (!B->freeNodes && !pobook_grow(B, MAX(B->capacity, POPOOL_MIN_SLAB))) return NULL;
+    PO* n = B->freeNodes; B->freeNodes = n->next; return n;
+}
+/* Gives a list of nodes (e.g. today's arrivals) back to the pool */
+static void pobook_release(POBook* B, PO* list) {
+    if (!list) return;
+    PO* t = list; while (t->next) t = t->next;
+    t->next = B->freeNodes; B->freeNodes = list;
+}
+#if defined(MM_STATS) || defined(MINIMARKET_BENCH)
+/* Heap blocks allocated for S so far (day scratch, PO slabs, PO buckets): constant across a steady-state day */
+static long long sim_heap_allocs(const Sim* S) { return S->scratch.heapAllocs + S->pos.heapAllocs; }
+#endif
+
+/* ---------- Linked list (POs) ---------- */
+static PO* po_create(Sim* S, int productIndex, int qty, int dueDay, int lead) {
+    PO* n = pobook_node(&S->pos); if (!n) return NULL;
+    n->poId = S->nextPO++; n->productIndex = productIndex; n->qty = qty; n->dueDay = dueDay; n->leadTime = lead; n->next = NULL;
+    return n;
+}
+
+/* ---------- Purchase-order book (calendar queue) ---------- */
+#define POBOOK_MIN_BUCKETS 8
+static int pobook_resize(POBook* B, int nb) {
+    PO** head = (PO**)calloc(nb, sizeof(PO*)), ** tail = (PO**)calloc(nb, sizeof(PO*));
+    if (!head || !tail) { free(head); free(tail); return 0; }
+    /* each old bucket is a single due day, so it moves whole into its new bucket */
+    for (int b = 0; b < B->nb; b++) {
+        if (!B->head[b]) continue;
+        int nbkt = B->head[b]->dueDay & (nb - 1);
+        head[nbkt] = B->head[b]; tail[nbkt] = B->tail[b];
+    }
+    free(B->head); free(B->tail); B->head = head; B->tail = tail; B->nb = nb; B->heapAllocs += 2;
+    return 1;
+}
+/* O(1): appends node to its due-day bucket and adds its qty to the product's on-order counter.
+   A PO due on or before today is moved to tomorrow (today's arrivals were already received). */
+static int pobook_add(POBook* B, Catalog* C, int today, PO* node) {
+    if (node->dueDay <= today) node->dueDay = today + 1;
+    int span = node->dueDay - today;
+    if (span > B->nb) { int nb = B->nb ? B->nb : POBOOK_MIN_BUCKETS; while (nb < span) nb *= 2; if (!pobook_resize(B, nb)) return 0; }
+    int b = node->dueDay & (B->nb - 1);
+    node->next = NULL;
+    if (B->tail[b]) B->tail[b]->next = node; else B->head[b] = node;
+    B->tail[b] = node;
+    C->onOrder[node->productIndex] += node->qty; B->count++;
+    return 1;
+}
+/* Detaches today's bucket (FIFO order) and takes its POs off the on-order counters */
+static PO* pobook_pop_due(POBook* B, Catalog* C, int today) {
+    if (!B->nb) return NULL;
+    int b = today & (B->nb - 1); PO* list = B->head[b];
+    B->head[b] = B->tail[b] = NULL;
+    for (PO* n = list; n; n = n->next) { C->onOrder[n->productIndex] -= n->qty; B->count--; }
+    return list;
+}
+/* First open PO in due order after `today`, or the one following `cur` */
+static PO* pobook_next(const POBook* B, int today, PO* cur) {
+    if (cur && cur->next) return cur->next;
+    for (int d = (cur ? cur->dueDay - today + 1 : 1); d <= B->nb; d++) { PO* h = B->head[(today + d) & (B->nb - 1)]; if (h) return h; }
+    return NULL;
+}
+static int pobook_clone(POBook* dst, const POBook* src) {
+    memset(dst, 0, sizeof(*dst)); if (!src->nb) return 1;
+    dst->head = (PO**)calloc(src->nb, sizeof(PO*)); dst->tail = (PO**)calloc(src->nb, sizeof(PO*)); dst->nb = src->nb; dst->heapAllocs = 2;
+    if (!dst->head || !dst->tail) { pobook_free(dst); return 0; }
+    if (src->count > 0 && !pobook_grow(dst, MAX(src->count, POPOOL_MIN_SLAB))) { pobook_free(dst); return 0; }
+    for (int b = 0; b < src->nb; b++) {
+        for (const PO* n = src->head[b]; n; n = n->next) {
+            PO* c = pobook_node(dst); if (!c) { pobook_free(dst); return 0; }
+            *c = *n; c->next = NULL;
+            if (dst->tail[b]) dst->tail[b]->next = c; else dst->head[b] = c;
+            dst->tail[b] = c; dst->count++;
+        }
+    }
+    return 1;
+}
+/* Frees the slabs: every node of B, open or not, is gone */
+static void pobook_free(POBook* B) {
+    for (PoSlab* sl = (PoSlab*)B->slabs; sl; ) { PoSlab* nx = sl->next; free(sl); sl = nx; }
+    free(B->head); free(B->tail); memset(B, 0, sizeof(*B));
+}
+
+/* ---------- Catalog (struct-of-arrays) ---------- */
+static void* mm_aligned_alloc(size_t bytes) {
+    bytes = (bytes + CAT_ALIGN - 1) & ~(size_t)(CAT_ALIGN - 1); if (!bytes) bytes = CAT_ALIGN;
+#ifdef _WIN32
+    return _aligned_malloc(bytes, CAT_ALIGN);
+#else
+    void* p = NULL; return posix_memalign(&p, CAT_ALIGN, bytes) == 0 ? p : NULL;
+#endif
+}
+static void mm_aligned_free(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+/* Catalog columns: a reference count in front of the data, so forked catalogs share them (cat_fork).
+   A column is written in place only while its count is 1; cat_own() copies it otherwise. */
+typedef struct { volatile long refs; } ColHdr;
+static void* col_alloc(size_t bytes) {
+    char* p = (char*)mm_aligned_alloc(CAT_ALIGN + bytes); if (!p) return NULL;
+    ((ColHdr*)p)->refs = 1; return p + CAT_ALIGN;
+}
+static void col_retain(void* col) { if (col) atomic_add(&((ColHdr*)((char*)col - CAT_ALIGN))->refs, 1); }
+static void col_release(void* col) { if (col && atomic_add(&((ColHdr*)((char*)col - CAT_ALIGN))->refs, -1) == 0) mm_aligned_free((char*)col - CAT_ALIGN); }
+static int  col_shared(const void* col) { return col && ((const ColHdr*)((const char*)col - CAT_ALIGN))->refs > 1; }
+static unsigned int str_hash(const char* s) { unsigned int h = 2166136261u; while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; } return h; }
+static int strtab_rehash(StrTable* T, int nslots) {
+    int* slots = (int*)calloc(nslots, sizeof(int)); if (!slots) return 0;
+    for (int off = 0; off < T->len; off += (int)strlen(T->buf + off) + 1) {
+        unsigned int h = str_hash(T->buf + off) & (unsigned)(nslots - 1);
+        while (slots[h]) h = (h + 1) & (unsigned)(nslots - 1);
+        slots[h] = off + 1;
+    }
+    free(T->slots); T->slots = slots; T->nslots = nslots; return 1;
+}
+/* Offset of str in T (added if new), -1 on OOM. Identical names share storage. */
+static int strtab_intern(StrTable* T, const char* str) {
+    if (T->refs && *T->refs > 1) {   /* shared with a fork: add to a private copy */
+        StrTable own; if (!strtab_clone(&own, T)) return -1;
+        strtab_free(T); *T = own;
+    }
+    if ((T->count + 1) * 2 > T->nslots && !strtab_rehash(T, T->nslots ? T->nslots * 2 : 64)) return -1;
+    unsigned int mask = (unsigned)(T->nslots - 1), h = str_hash(str) & mask;
+    for (; T->slots[h]; h = (h + 1) & mask) if (!strcmp(T->buf + T->slots[h] - 1, str)) return T->slots[h] - 1;
+    int need = (int)strlen(str) + 1;
+    if (T->len + need > T->cap) {
+        int cap = T->cap ? T->cap : 1024; while (T->len + need > cap) cap *= 2;
+        char* nb = (char*)realloc(T->buf, cap); if (!nb) return -1; T->buf = nb; T->cap = cap;
+    }
+    int off = T->len; memcpy(T->buf + off, str, need); T->len += need; T->count++;
+    T->slots[h] = off + 1;
+    return off;
+}
+static void strtab_free(StrTable* T) {
+    if (T->refs && atomic_add(T->refs, -1) > 0) { memset(T, 0, sizeof(*T)); return; }   /* still used by a fork */
+    free((void*)T->refs); free(T->buf); free(T->slots); memset(T, 0, sizeof(*T));
+}
+static int strtab_clone(StrTable* dst, const StrTable* src) {
+    memset(dst, 0, sizeof(*dst)); if (!src->cap) return 1;
+    dst->buf = (char*)malloc(src->cap); dst->slots = (int*)malloc(sizeof(int) * src->nslots);
+    if (!dst->buf || !dst->slots) { strtab_free(dst); return 0; }
+    memcpy(dst->buf, src->buf, src->len); memcpy(dst->slots, src->slots, sizeof(int) * src->nslots);
+    dst->len = src->len; dst->cap = src->cap; dst->nslots = src->nslots; dst->count = src->count;
+    return 1;
+}
+
+static void cat_init(Catalog* C) { memset(C, 0, sizeof(*C)); }
+static const char* cat_name(const Catalog* C, int i) { return C->names.buf + C->nameOff[i]; }
+/* Grows every column to hold cap SKUs; new slots are zeroed */
+static int cat_reserve(Catalog* C, int cap) {
+    if (cap <= C->cap) return 1;
+#define X(type, field) { type* p = (type*)col_alloc(sizeof(type) * (size_t)cap); if (!p) return 0; \
+        if (C->n) { memcpy(p, C->field, sizeof(type) * (size_t)C->n); } \
+        memset(p + C->n, 0, sizeof(type) * (size_t)(cap - C->n)); \
+        col_release(C->field); C->field = p; }
+    CATALOG_ALL_COLUMNS(X)
+#undef X
+    C->cap = cap; return 1;
+}
+/* Appends a SKU with zeroed counters; returns its index or -1 on OOM */
+static int cat_add(Catalog* C, int id, const char* name, double baseCost, double price, int stock, unsigned int flags) {
+    if (C->n == C->cap && !cat_reserve(C, C->cap ? C->cap * 2 : 64)) return -1;
+    int off = strtab_intern(&C->names, name); if (off < 0) return -1;
+    int i = C->n++;
+    C->id[i] = id; C->nameOff[i] = off; C->baseCost[i] = baseCost; C->price[i] = price; C->stock[i] = stock; C->flags[i] = flags;
+    C->requested[i] = C->served[i] = C->stockouts[i] = C->wasteUnits[i] = 0; C->revenue[i] = C->cogs[i] = C->ordersCost[i] = 0.0;
+    C->policy[i] = POL_CONFIG; C->reorderPoint[i] = C->orderQty[i] = C->orderUpTo[i] = C->moq[i] = 0; C->reviewPeriod[i] = C->casePack[i] = 1;
+    C->fcLevel[i] = C->fcTrend[i] = C->fcMse[i] = 0.0; C->fcDays[i] = 0;
+    C->fcSeason0[i] = C->fcSeason1[i] = C->fcSeason2[i] = C->fcSeason3[i] = C->fcSeason4[i] = C->fcSeason5[i] = C->fcSeason6[i] = 0.0;
+    C->dmBase[i] = 0.0; C->dmElast[i] = 1.0; C->dmPromo[i] = 1.25;
+    C->shelfLife[i] = 0; memset(&C->lots[i], 0, sizeof(LotRing));
+    C->onOrder[i] = 0; C->polDirty = 1; C->dmDirty = 1; C->lotDirty = 1;
+    return i;
+}
+static void cat_reset_counters(Catalog* C) {
+    size_t n = (size_t)C->n; if (!n) return;
+    memset(C->requested, 0, sizeof(long long) * n); memset(C->served, 0, sizeof(long long) * n);
+    memset(C->stockouts, 0, sizeof(long long) * n); memset(C->wasteUnits, 0, sizeof(long long) * n);
+    memset(C->revenue, 0, sizeof(double) * n); memset(C->cogs, 0, sizeof(double) * n); memset(C->ordersCost, 0, sizeof(double) * n);
+}
+static int cat_clone(Catalog* dst, const Catalog* src) {
+    cat_init(dst);
+    if (!cat_reserve(dst, src->cap) || !strtab_clone(&dst->names, &src->names)) { cat_free(dst); return 0; }
+#define X(type, field) if (src->n) memcpy(dst->field, src->field, sizeof(type) * (size_t)src->n);
+    CATALOG_ALL_COLUMNS(X)
+#undef X
+    dst->n = src->n; memcpy(dst->polStart, src->polStart, sizeof(dst->polStart)); dst->polDirty = src->polDirty;
+    dst->dmDirty = src->dmDirty; dst->dmFactor = src->dmFactor; dst->lotDirty = src->lotDirty;
+    return 1;
+}
+/* Appends all rows of src (persisted columns; names re-interned) */
+static int cat_append(Catalog* dst, const Catalog* src) {
+    if (!src->n) return 1;
+    if (!cat_reserve(dst, dst->n + src->n)) return 0;
+#define X(type, field) memcpy(dst->field + dst->n, src->field, sizeof(type) * (size_t)src->n);
+    CATALOG_COLUMNS(X)
+#undef X
+    for (int k = 0; k < src->n; k++) if ((dst->nameOff[dst->n + k] = strtab_intern(&dst->names, cat_name(src, k))) < 0) return 0;
+    dst->n += src->n; dst->polDirty = 1; dst->dmDirty = 1; dst->lotDirty = 1;
+    return 1;
+}
+static void cat_free(Catalog* C) {
+#define X(type, field) col_release(C->field);
+    CATALOG_ALL_COLUMNS(X)
+#undef X
+    strtab_free(&C->names); cat_init(C);
+}
+/* Copy-on-write copy: dst shares every column and the names with src, in O(columns) whatever the SKU
+   count. Writers call cat_own() first; src must be indexed, as policy_index() writes columns. */
+static void cat_fork(Catalog* dst, Catalog* src) {
+    if (src->polDirty) policy_index(src);
+    if (src->dmDirty) demand_index(src);
+    if (!src->names.refs && (src->names.refs = (volatile long*)malloc(sizeof(long))) != NULL) *src->names.refs = 1;
+    *dst = *src;
+#define X(type, field) col_retain(src->field);
+    CATALOG_ALL_COLUMNS(X)
+#undef X
+    if (src->names.refs) atomic_add(src->names.refs, 1); else memset(&dst->names, 0, sizeof(dst->names));   /* OOM: no names */
+}
+/* Gives C private copies of the columns in mask (CATCOL bits) that are still shared; 0 on OOM */
+static int cat_own(Catalog* C, unsigned long long mask) {
+    int ok = 1, bit = 0;
+#define X(type, field) if (ok && (mask >> bit & 1) && col_shared(C->field)) { type* p = (type*)col_alloc(sizeof(type) * (size_t)C->cap); \
+        if (!p) ok = 0; else { memcpy(p, C->field, sizeof(type) * (size_t)C->n); memset(p + C->n, 0, sizeof(type) * (size_t)(C->cap - C->n)); \
+        col_release(C->field); C->field = p; } } bit++;
+    CATALOG_ALL_COLUMNS(X)
+#undef X
+    return ok;
+}
+/* Bytes of C's columns, and how many of them are private (not shared with a fork) */
+static void cat_bytes(const Catalog* C, unsigned long long* total, unsigned long long* priv) {
+    *total = *priv = 0;
+#define X(type, field) { unsigned long long b = sizeof(type) * (unsigned long long)C->cap; *total += b; if (!col_shared(C->field)) *priv += b; }
+    CATALOG_ALL_COLUMNS(X)
+#undef X
+}
+
+/* ---------- Sales kernel ---------- */
+/* For every SKU: srv = min(req, stock), stock -= srv, shortage = req - srv, counters += day values.
+   Day totals are accumulated into D. AVX-512 / AVX2 when the compiler targets them, scalar otherwise. */
+static void sales_kernel(Catalog* C, const int* req, int* srv, int* shortage, DayTotals* D) {
+    int n = C->n, i = 0;
+    long long tReq = 0, tSrv = 0, tSto = 0; double tRev = 0.0, tCogs = 0.0;
+#if defined(__AVX512F__)
+    __m512i aReq = _mm512_setzero_si512(), aSrv = _mm512_setzero_si512(), aSto = _mm512_setzero_si512();
+    __m512d aRev = _mm512_setzero_pd(), aCogs = _mm512_setzero_pd();
+    for (; i + 8 <= n; i += 8) {
+        __m256i r = _mm256_loadu_si256((const __m256i*)(req + i)), st = _mm256_loadu_si256((const __m256i*)(C->stock + i));
+        __m256i v = _mm256_min_epi32(r, st), sh = _mm256_sub_epi32(r, v);
+        _mm256_storeu_si256((__m256i*)(C->stock + i), _mm256_sub_epi32(st, v));
+        _mm256_storeu_si256((__m256i*)(srv + i), v); _mm256_storeu_si256((__m256i*)(shortage + i), sh);
+        __m512i r64 = _mm512_cvtepi32_epi64(r), v64 = _mm512_cvtepi32_epi64(v), sh64 = _mm512_cvtepi32_epi64(sh);
+        _mm512_storeu_si512(C->requested + i, _mm512_add_epi64(_mm512_loadu_si512(C->requested + i), r64));
+        _mm512_storeu_si512(C->served + i, _mm512_add_epi64(_mm512_loadu_si512(C->served + i), v64));
+        _mm512_storeu_si512(C->stockouts + i, _mm512_add_epi64(_mm512_loadu_si512(C->stockouts + i), sh64));
+        __m512d vd = _mm512_cvtepi32_pd(v);
+        __m512d rev = _mm512_mul_pd(vd, _mm512_loadu_pd(C->price + i)), cg = _mm512_mul_pd(vd, _mm512_loadu_pd(C->baseCost + i));
+        _mm512_storeu_pd(C->revenue + i, _mm512_add_pd(_mm512_loadu_pd(C->revenue + i), rev));
+        _mm512_storeu_pd(C->cogs + i, _mm512_add_pd(_mm512_loadu_pd(C->cogs + i), cg));
+        aReq = _mm512_add_epi64(aReq, r64); aSrv = _mm512_add_epi64(aSrv, v64); aSto = _mm512_add_epi64(aSto, sh64);
+        aRev = _mm512_add_pd(aRev, rev); aCogs = _mm512_add_pd(aCogs, cg);
+    }
+    tReq = _mm512_reduce_add_epi64(aReq); tSrv = _mm512_reduce_add_epi64(aSrv); tSto = _mm512_reduce_add_epi64(aSto);
+    tRev = _mm512_reduce_add_pd(aRev); tCogs = _mm512_reduce_add_pd(aCogs);
+#elif defined(__AVX2__)
+    __m256i aReq = _mm256_setzero_si256(), aSrv = _mm256_setzero_si256(), aSto = _mm256_setzero_si256();
+    __m256d aRev = _mm256_setzero_pd(), aCogs = _mm256_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+        __m128i r = _mm_loadu_si128((const __m128i*)(req + i)), st = _mm_loadu_si128((const __m128i*)(C->stock + i));
+        __m128i v = _mm_min_epi32(r, st), sh = _mm_sub_epi32(r, v);
+        _mm_storeu_si128((__m128i*)(C->stock + i), _mm_sub_epi32(st, v));
+        _mm_storeu_si128((__m128i*)(srv + i), v); _mm_storeu_si128((__m128i*)(shortage + i), sh);
+        __m256i r64 = _mm256_cvtepi32_epi64(r), v64 = _mm256_cvtepi32_epi64(v), sh64 = _mm256_cvtepi32_epi64(sh);
+        _mm256_storeu_si256((__m256i*)(C->requested + i), _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(C->requested + i)), r64));
+        _mm256_storeu_si256((__m256i*)(C->served + i), _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(C->served + i)), v64));
+        _mm256_storeu_si256((__m256i*)(C->stockouts + i), _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(C->stockouts + i)), sh64));
+        __m256d vd = _mm256_cvtepi32_pd(v);
+        __m256d rev = _mm256_mul_pd(vd, _mm256_loadu_pd(C->price + i)), cg = _mm256_mul_pd(vd, _mm256_loadu_pd(C->baseCost + i));
+        _mm256_storeu_pd(C->revenue + i, _mm256_add_pd(_mm256_loadu_pd(C->revenue + i), rev));
+        _mm256_storeu_pd(C->cogs + i, _mm256_add_pd(_mm256_loadu_pd(C->cogs + i), cg));
+        aReq = _mm256_add_epi64(aReq, r64); aSrv = _mm256_add_epi64(aSrv, v64); aSto = _mm256_add_epi64(aSto, sh64);
+        aRev = _mm256_add_pd(aRev, rev); aCogs = _mm256_add_pd(aCogs, cg);
+    }
+    long long l[4]; double d[4];
+    _mm256_storeu_si256((__m256i*)l, aReq); tReq = l[0] + l[1] + l[2] + l[3];
+    _mm256_storeu_si256((__m256i*)l, aSrv); tSrv = l[0] + l[1] + l[2] + l[3];
+    _mm256_storeu_si256((__m256i*)l, aSto); tSto = l[0] + l[1] + l[2] + l[3];
+    _mm256_storeu_pd(d, aRev); tRev = d[0] + d[1] + d[2] + d[3];
+    _mm256_storeu_pd(d, aCogs); tCogs = d[0] + d[1] + d[2] + d[3];
+#endif
+    for (; i < n; i++) {
+        int r = req[i], v = MIN(r, C->stock[i]), sh = r - v;
+        C->stock[i] -= v; srv[i] = v; shortage[i] = sh;
+        C->requested[i] += r; C->served[i] += v; C->stockouts[i] += sh;
+        double rev = v * C->price[i], cg = v * C->baseCost[i];
+        C->revenue[i] += rev; C->cogs[i] += cg;
+        tReq += r; tSrv += v; tSto += sh; tRev += rev; tCogs += cg;
+    }
+    D->requested += tReq; D->served += tSrv; D->stockouts += tSto; D->revenue += tRev; D->cogs += tCogs;
+}
+
+/* ---------- Simulation state ---------- */
+static void sim_init(Sim* S) {
+    memset(S, 0, sizeof(*S));
+    load_defaults(&S->cfg);
+    S->nextPO = 1;
+}
+/* Stream (stream, purpose) of S's current day */
+static void sim_rng(Rng* r, const Sim* S, unsigned int stream, unsigned int purpose) {
+    rng_init(r, S->rngKey, stream, purpose, (unsigned)S->day); r->flip = S->rngFlip;
+}
+/* Deep copy (PO book included); dst gets no log, no auto-save, no report indexes, no outbox and no stats */
+static int sim_clone(Sim* dst, const Sim* src) {
+    *dst = *src; dst->log = NULL; dst->jnl = NULL; dst->rank = NULL; dst->outbox = NULL;
+#ifdef MM_STATS
+    dst->stats = NULL;
+#endif
+    memset(&dst->scratch, 0, sizeof(dst->scratch));
+    if (!cat_clone(&dst->cat, &src->cat)) { memset(&dst->pos, 0, sizeof(dst->pos)); return 0; }
+    if (!pobook_clone(&dst->pos, &src->pos)) { cat_free(&dst->cat); return 0; }
+    return 1;
+}
+/* Copy-on-write copy for what-if branches: shares src's catalog columns and open POs until it writes
+   them (sim_own, at the start of every day). Same RNG key, so an unchanged branch replays src's future.
+   src must not advance or be freed while a fork still has posFrom set. */
+static void sim_fork(Sim* dst, Sim* src) {
+    *dst = *src; dst->log = NULL; dst->jnl = NULL; dst->rank = NULL; dst->outbox = NULL; dst->verbose = 0;
+#ifdef MM_STATS
+    dst->stats = NULL;
+#endif
+    cat_fork(&dst->cat, &src->cat);
+    memset(&dst->pos, 0, sizeof(dst->pos)); dst->posFrom = (src->posFrom ? src->posFrom : &src->pos);
+    memset(&dst->scratch, 0, sizeof(dst->scratch));
+}
+/* Private copies of what a day writes; 0 on OOM */
+static int sim_own(Sim* S) {
+    if (S->posFrom) { if (!pobook_clone(&S->pos, S->posFrom)) return 0; S->posFrom = NULL; }
+    return cat_own(&S->cat, CAT_DAY_COLUMNS);
+}
+static void sim_free(Sim* S) { pobook_free(&S->pos); arena_free(&S->scratch); cat_free(&S->cat); rank_free(S->rank); S->rank = NULL; S->posFrom = NULL; }
+
+/* ---------- Loading ---------- */
+static void load_defaults(Config* cfg) {
+    cfg->daysDefault = 30; cfg->reorder_point = 15; cfg->order_quantity = 40;
+    cfg->leadMin = 2; cfg->leadMax = 4; cfg->orderCostFixed = 15.0; cfg->taxRate = 0.17; cfg->seed = 0;
+    cfg->fcModel = FC_SES; cfg->fcAlpha = 0.2; cfg->fcBeta = 0.1; cfg->fcGamma = 0.1; cfg->serviceLevel = 0.95; cfg->coverDays = 7.0;
+    cfg->defaultPolicy = POL_CONFIG;
+    for (int d = 0; d < 7; d++) cfg->seasonWeek[d] = 1.0;
+    cfg->nSeasonYear = 0;
+}
+static void run_options_defaults(RunOptions* opt) { opt->logFormat = LOG_FMT_CSV; opt->logFlushDays = 1; opt->checkpointDays = 30; }
+/* One "key=value" line; opt may be NULL (simulation settings only). Returns 1 if the key was known. */
+static int config_apply_line(Config* cfg, RunOptions* opt, const char* line) {
+    char key[64], val[256];
+    if (line[0] == '#' || (line[0] == '/' && line[1] == '/')) return 0;
+    if (sscanf(line, " %63[^=]=%255[^\n]", key, val) != 2) return 0;
+    for (int i = (int)strlen(key) - 1; i >= 0 && isspace((unsigned char)key[i]); --i) key[i] = '\0';
+    for (int i = 0; val[i]; ++i) if (val[i] == '\r' || val[i] == '\n') val[i] = '\0';
+    for (int i = 0; key[i]; ++i) key[i] = (char)tolower((unsigned char)key[i]);
+    if (!strcmp(key, "days"))               cfg->daysDefault = atoi(val);
+    else if (!strcmp(key, "s") || !strcmp(key, "reorder_point")) cfg->reorder_point = atoi(val);
+    else if (!strcmp(key, "q") || !strcmp(key, "order_quantity")) cfg->order_quantity = atoi(val);
+    else if (!strcmp(key, "leadtimemin"))   cfg->leadMin = atoi(val);
+    else if (!strcmp(key, "leadtimemax"))   cfg->leadMax = atoi(val);
+    else if (!strcmp(key, "ordercostfixed")) cfg->orderCostFixed = atof(val);
+    else if (!strcmp(key, "taxrate"))        cfg->taxRate = atof(val);
+    else if (!strcmp(key, "seed"))           cfg->seed = strtoull(val, NULL, 10);
+    else if (!strcmp(key, "forecast"))       cfg->fcModel = (!strncmp(val, "holt", 4) ? FC_HOLT : !strncmp(val, "hw", 2) ? FC_HW : FC_SES);
+    else if (!strcmp(key, "forecast_alpha")) cfg->fcAlpha = atof(val);
+    else if (!strcmp(key, "forecast_beta"))  cfg->fcBeta = atof(val);
+    else if (!strcmp(key, "forecast_gamma")) cfg->fcGamma = atof(val);
+    else if (!strcmp(key, "service_level"))  { double v = atof(val); cfg->serviceLevel = (v > 1.0 ? v / 100.0 : v); }
+    else if (!strcmp(key, "cover_days"))     cfg->coverDays = atof(val);
+    else if (!strcmp(key, "default_policy")) cfg->defaultPolicy = (!strncmp(val, "forecast", 8) ? POL_FORECAST : POL_CONFIG);
+    else if (!strcmp(key, "season_week")) { double v[7]; if (parse_doubles(val, v, 7) != 7) return 0; memcpy(cfg->seasonWeek, v, sizeof(v)); }
+    else if (!strcmp(key, "season_year")) { double v[SEASON_YEAR_MAX]; int k = parse_doubles(val, v, SEASON_YEAR_MAX); if (k < 0) return 0; memcpy(cfg->seasonYear, v, sizeof(double) * k); cfg->nSeasonYear = k; }
+    else if (!opt) return 0;
+    else if (!strcmp(key, "log_format"))     opt->logFormat = (!strncmp(val, "bin", 3) ? LOG_FMT_BINARY : !strncmp(val, "none", 4) ? LOG_FMT_NONE : LOG_FMT_CSV);
+    else if (!strcmp(key, "log_flush_days")) opt->logFlushDays = atoi(val);
+    else if (!strcmp(key, "checkpoint_every")) opt->checkpointDays = atoi(val);
+    else return 0;
+    return 1;
+}
+static void load_config_txt(Config* cfg, RunOptions* opt, const char* path) {
+    FILE* f = mm_fopen(path, "r"); if (!f) { return; } /* silent if not found */
+    char line[512];
+    while (fgets(line, sizeof(line), f)) config_apply_line(cfg, opt, line);
+    fclose(f);
+}
+/* Config in config.txt syntax (doubles round-trip exactly); returns length */
+static int config_to_text(const Config* cfg, char* buf, size_t size) {
+    int len = snprintf(buf, size, "days=%d\ns=%d\nq=%d\nleadtimemin=%d\nleadtimemax=%d\nordercostfixed=%.17g\ntaxrate=%.17g\nseed=%llu\n"
+        "forecast=%s\nforecast_alpha=%.17g\nforecast_beta=%.17g\nforecast_gamma=%.17g\nservice_level=%.17g\ncover_days=%.17g\ndefault_policy=%s\n",
+        cfg->daysDefault, cfg->reorder_point, cfg->order_quantity, cfg->leadMin, cfg->leadMax, cfg->orderCostFixed, cfg->taxRate, cfg->seed,
+        FC_MODEL_NAMES[cfg->fcModel], cfg->fcAlpha, cfg->fcBeta, cfg->fcGamma, cfg->serviceLevel, cfg->coverDays,
+        cfg->defaultPolicy == POL_FORECAST ? "forecast" : "sq");
+    for (int pass = 0; pass < 2; pass++) {   /* season lines only when set, so older builds read the same text */
+        const double* v = (pass ? cfg->seasonYear : cfg->seasonWeek); int k = (pass ? cfg->nSeasonYear : 7), flat = 1;
+        for (int j = 0; j < k; j++) if (v[j] != 1.0) flat = 0;
+        if (flat) continue;
+        for (int j = 0; j < k && len < (int)size; j++) len += snprintf(buf + len, size - len, "%s%.17g", j ? "," : pass ? "season_year=" : "season_week=", v[j]);
+        if (len < (int)size) len += snprintf(buf + len, size - len, "\n");
+    }
+    return len;
+}
+static void demo_inventory(Sim* S) {
+    cat_free(&S->cat); Catalog* C = &S->cat;
+    cat_add(C, 101, "Milk 1L",      6.0,  8.0,  50, PERISHABLE);
+    cat_add(C, 102, "Bread",        5.0,  7.5,  40, 0);
+    cat_add(C, 204, "Strawberries", 20.0, 28.0, 20, PERISHABLE);
+    cat_add(C, 305, "Olive Oil",    23.0, 35.0, 15, 0);
+}
+/* ---------- Log subsystem (async, batched) ---------- */
+THREAD_FN(log_writer_main, arg) {
+    Logger* L = (Logger*)arg;
+    mutex_lock(&L->mu);
+    for (;;) {
+        while (!L->qHead && !L->stop) cond_wait(&L->cvWork, &L->mu);
+        LogBuf* b = L->qHead; if (!b) break;   /* stop requested and queue drained */
+        L->qHead = b->next; if (!L->qHead) L->qTail = NULL;
+        mutex_unlock(&L->mu);
+        FILE* f = L->f[b->stream];
+        if (f) { if (b->len) fwrite(b->data, 1, b->len, f); if (b->flush) fflush(f); }
+        mutex_lock(&L->mu);
+        b->next = L->freeList; L->freeList = b; cond_signal(&L->cvFree);
+    }
+    mutex_unlock(&L->mu);
+    THREAD_RETURN;
+}
+static LogBuf* log_take_buf(Logger* L, int stream) {
+    mutex_lock(&L->mu);
+    while (!L->freeList) cond_wait(&L->cvFree, &L->mu);
+    LogBuf* b = L->freeList; L->freeList = b->next;
+    mutex_unlock(&L->mu);
+    b->next = NULL; b->stream = stream; b->flush = 0; b->len = 0;
+    return b;
+}
+static void log_submit(Logger* L, int stream, int flush) {
+    LogBuf* b = L->cur[stream]; if (!b) { if (!flush) return; b = log_take_buf(L, stream); }
+    L->cur[stream] = NULL; b->flush = flush; L->bytes += (long long)b->len;
+    mutex_lock(&L->mu);
+    if (L->qTail) L->qTail->next = b; else L->qHead = b;
+    L->qTail = b; cond_signal(&L->cvWork);
+    mutex_unlock(&L->mu);
+}
+/* Room for `need` more bytes on a stream; a full buffer is handed to the writer first */
+static char* log_reserve(Logger* L, int stream, size_t need) {
+    LogBuf* b = L->cur[stream];
+    if (b && b->len + need > LOG_BUF_BYTES) { log_submit(L, stream, 0); b = NULL; }
+    if (!b) b = L->cur[stream] = log_take_buf(L, stream);
+    return b->data + b->len;
+}
+static void log_put(Logger* L, int stream, const void* p, size_t n) {
+    memcpy(log_reserve(L, stream, n), p, n); L->cur[stream]->len += n;
+}
+static FILE* log_open_stream(const char* path, int truncate, int stream, unsigned int recSize, int binary) {
+    FILE* f = mm_fopen(path, truncate ? (binary ? "wb" : "w") : (binary ? "ab" : "a"));
+    if (!f) { fprintf(stderr, "ERR: cannot open %s\n", path); return NULL; }
+    fseek(f, 0, SEEK_END);
+    if (ftell(f) <= 0) {
+        if (binary) { LogFileHdr h = { LOG_MAGIC, (unsigned)stream, recSize, 0x01020304u }; fwrite(&h, sizeof(h), 1, f); }
+        else fputs(LOG_CSV_HEADER, f);
+        fflush(f);
+    }
+    return f;
+}
+/* Opens the log in append mode (truncate=0) or fresh (truncate=1) and starts the writer thread.
+   The binary format also records the catalog's id -> name table so it can be converted back to CSV. */
+static Logger* log_open(int format, int flushDays, int truncate, const Catalog* C) {
+    if (format == LOG_FMT_NONE) return NULL;
+    Logger* L = (Logger*)calloc(1, sizeof(Logger)); LogBuf* pool = (LogBuf*)malloc(sizeof(LogBuf) * LOG_POOL);
+    if (!L || !pool) { free(L); free(pool); fprintf(stderr, "ERR: cannot allocate log buffers\n"); return NULL; }
+    L->format = format; L->flushDays = flushDays; L->mem = pool;
+    for (int i = 0; i < LOG_POOL; i++) { pool[i].next = L->freeList; L->freeList = &pool[i]; }
+    if (format == LOG_FMT_CSV) L->f[LOG_S_CSV] = log_open_stream(LOG_PATH, truncate, LOG_S_CSV, 0, 0);
+    else {
+        L->f[LOG_S_SALE] = log_open_stream(LOG_SALE_PATH, truncate, LOG_S_SALE, sizeof(LogSaleRec), 1);
+        L->f[LOG_S_ORDER] = log_open_stream(LOG_ORDER_PATH, truncate, LOG_S_ORDER, sizeof(LogOrderRec), 1);
+        L->f[LOG_S_DAILY] = log_open_stream(LOG_DAILY_PATH, truncate, LOG_S_DAILY, sizeof(LogDailyRec), 1);
+        L->f[LOG_S_NAMES] = log_open_stream(LOG_NAMES_PATH, truncate, LOG_S_NAMES, 0, 1);
+    }
+    mutex_init(&L->mu); cond_init(&L->cvWork); cond_init(&L->cvFree);
+    if (!thread_start(&L->writer, log_writer_main, L)) {
+        fprintf(stderr, "ERR: cannot start log writer\n");
+        for (int s = 0; s < LOG_STREAMS; s++) if (L->f[s]) fclose(L->f[s]);
+        mutex_destroy(&L->mu); cond_destroy(&L->cvWork); cond_destroy(&L->cvFree); free(pool); free(L); return NULL;
+    }
+    if (format == LOG_FMT_BINARY && C) {
+        for (int i = 0; i < C->n; i++) {
+            const char* nm = cat_name(C, i); LogNameRec r = { C->id[i], (int)strlen(nm) };
+            log_put(L, LOG_S_NAMES, &r, sizeof(r)); log_put(L, LOG_S_NAMES, nm, (size_t)r.len);
+        }
+        log_submit(L, LOG_S_NAMES, 1);
+    }
+    return L;
+}
+/* Durability policy: every flushDays days, pending rows are queued and flushed to the OS */
+static void log_end_day(Logger* L, int day) {
+    if (!L || L->flushDays <= 0 || day % L->flushDays != 0) return;
+    for (int s = 0; s < LOG_STREAMS; s++) if (L->f[s]) log_submit(L, s, 1);
+}
+/* Queues every pending row and flushes the streams to the OS */
+static void log_flush(Logger* L) {
+    if (!L) return;
+    for (int s = 0; s < LOG_STREAMS; s++) if (L->f[s]) log_submit(L, s, 1);
+}
+static void log_close(Logger* L) {
+    if (!L) return;
+    log_flush(L);
+    mutex_lock(&L->mu); L->stop = 1; cond_broadcast(&L->cvWork); mutex_unlock(&L->mu);
+    thread_join(L->writer);
+    for (int s = 0; s < LOG_STREAMS; s++) if (L->f[s]) fclose(L->f[s]);
+    mutex_destroy(&L->mu); cond_destroy(&L->cvWork); cond_destroy(&L->cvFree);
+    free(L->mem); free(L);
+}
+
+/* ---------- Single log (append / reset) ---------- */
+static void open_single_log_append(Sim* S, const RunOptions* opt) {
+    if (S->log) return;
+    S->log = log_open(opt->logFormat, opt->logFlushDays, 0, &S->cat);
+}
+static void reset_single_log_and_state(Sim* S) {
+    int format = S->log ? S->log->format : LOG_FMT_NONE, flushDays = S->log ? S->log->flushDays : 1;
+    log_close(S->log); S->log = NULL;
+    pobook_free(&S->pos); if (S->cat.n) memset(S->cat.onOrder, 0, sizeof(int) * (size_t)S->cat.n);
+    cat_reset_counters(&S->cat);
+    S->day = 0; S->nextPO = 1; S->agg.valid = 0; if (S->rank) S->rank->valid = 0;
+    S->log = log_open(format, flushDays, 1, &S->cat);
+
+    /* NEW: also clear saved state so next run starts fresh */
+    remove(STATE_PATH); remove(JOURNAL_PATH);
+    S->stateEpoch = 0;   /* the next end of day writes a new checkpoint */
+}
+static void close_single_log(Sim* S) { log_close(S->log); S->log = NULL; }
+
+/* ---------- Demand / Waste ---------- */
+/* Daily rate of SKU i before seasonality: base x (12 / (price + 4))^elasticity, x the promo lift while on
+   sale. A SKU without a base rate of its own (dmBase 0) gets 6.0 (perishable) or 3.5, kept within [0.2, 18]. */
+static double demand_lambda_for(const Catalog* C, int i) {
+    double price = C->price[i], e = C->dmElast[i]; unsigned int flags = C->flags[i];
+    double base = (C->dmBase[i] > 0.0 ? C->dmBase[i] : (flags & PERISHABLE) ? 6.0 : 3.5);
+    double priceFactor = (price > 0 ? (12.0 / (price + 4.0)) : 2.0); if (e != 1.0) priceFactor = pow(priceFactor, e);
+    double promo = (flags & ON_SALE) ? C->dmPromo[i] : 1.0;
+    double lam = base * priceFactor * promo;
+    if (C->dmBase[i] <= 0.0) { if (lam < 0.2) lam = 0.2; if (lam > 18.0) lam = 18.0; }
+    return lam;
+}
+/* Demand factor of `day`: season_week[day % 7] x season_year value of the day's share of a 365-day year */
+static double season_factor(const Config* cfg, int day) {
+    double f = cfg->seasonWeek[day % 7];
+    if (cfg->nSeasonYear > 0) f *= cfg->seasonYear[(day > 0 ? (day - 1) % 365 : 0) * cfg->nSeasonYear / 365];
+    return f;
+}
+/* dmLam of every SKU; runs after a price, flag or demand parameter change (dmDirty) */
+static void demand_index(Catalog* C) {
+    if (!cat_own(C, CATCOL(dmLam))) { puts("OOM"); return; }
+    for (int i = 0; i < C->n; i++) C->dmLam[i] = demand_lambda_for(C, i);
+    C->dmDirty = 0; C->dmFactor = -1.0;
+}
+/* Today's season factor. The sampler's exp(-rate) is only recomputed when the rates or the factor
+   changed since it was last computed: never with flat seasons, once per bucket otherwise. */
+static double demand_refresh(Sim* S) {
+    Catalog* C = &S->cat; double f = season_factor(&S->cfg, S->day);
+    if (C->dmDirty) demand_index(C);
+    if (f != C->dmFactor) {
+        if (!cat_own(C, CATCOL(dmExp))) { puts("OOM"); return f; }
+        const double* L = C->dmLam; double* E = C->dmExp;
+        for (int i = 0; i < C->n; i++) { double lam = L[i] * f; E[i] = (lam < POISSON_PTRS_MIN ? exp(-lam) : 0.0); }
+        C->dmFactor = f;
+    }
+    return f;
+}
+/* Perishables without a shelf life: 1-3% of the stock, whatever its age */
+static int waste_units_for_day(Rng* r, int stock, unsigned int flags) {
+    if (!(flags & PERISHABLE)) return 0;
+    int s = stock;
+    if (s <= 0) return 0;
+    double rate = (rand_int(r, 1, 3)) / 100.0; int w = (int)floor(rate * s + 0.5); return (w > 0 ? w : 0);
+}
+
+/* ---------- Perishable lots ---------- */
+/* SKUs with a shelf life keep their stock as dated lots (Catalog.lots, one LotRing per SKU in a single
+   column): an arrival is a lot usable through day + shelfLife - 1, sales take the oldest lots first, and
+   a lot still there at the end of its last day is waste. Rings stay sorted by date, so selling and ageing
+   only touch the head; the day's pass is one linear walk over the column. */
+#define LOT_SLOT(L, k) (((L)->head + (k)) % LOT_CAP)
+/* Adds qty units usable through day useBy, in date order. Units of a date already held join that lot;
+   a full ring folds them into the newest older lot, whose earlier date they take. */
+static void lot_push(LotRing* L, int qty, int useBy) {
+    if (qty <= 0) return;
+    int j = L->count;
+    while (j > 0 && L->useBy[LOT_SLOT(L, j - 1)] > useBy) j--;   /* after every lot of the same date or older */
+    if (j > 0 && L->useBy[LOT_SLOT(L, j - 1)] == useBy) { L->qty[LOT_SLOT(L, j - 1)] += qty; return; }
+    if (L->count == LOT_CAP) {
+        int s = LOT_SLOT(L, j > 0 ? j - 1 : 0);
+        L->qty[s] += qty; if (useBy < L->useBy[s]) L->useBy[s] = useBy;
+        return;
+    }
+    for (int k = L->count; k > j; k--) { int to = LOT_SLOT(L, k), from = LOT_SLOT(L, k - 1); L->qty[to] = L->qty[from]; L->useBy[to] = L->useBy[from]; }
+    L->qty[LOT_SLOT(L, j)] = qty; L->useBy[LOT_SLOT(L, j)] = useBy; L->count++;
+}
+/* Removes up to qty units, oldest lots first; returns the units removed */
+static int lot_take(LotRing* L, int qty) {
+    int taken = 0;
+    while (qty > 0 && L->count) {
+        int h = L->head, t = MIN(qty, L->qty[h]);
+        L->qty[h] -= t; qty -= t; taken += t;
+        if (!L->qty[h]) { L->head = (h + 1 == LOT_CAP ? 0 : h + 1); L->count--; }
+    }
+    return taken;
+}
+/* Drops the lots whose last day is `day` or earlier; returns their units */
+static int lot_expire(LotRing* L, int day) {
+    int w = 0;
+    while (L->count && L->useBy[L->head] <= day) { w += L->qty[L->head]; L->head = (L->head + 1 == LOT_CAP ? 0 : L->head + 1); L->count--; }
+    return w;
+}
+#undef LOT_SLOT
+/* qty units of SKU i received on `day` */
+static void lot_receive(Catalog* C, int i, int qty, int day) {
+    if (C->shelfLife[i] > 0) lot_push(&C->lots[i], qty, day + C->shelfLife[i] - 1);
+}
+/* End of day for SKU i: the day's sales leave the oldest lots, then expired lots go; returns the waste */
+static int lots_end_day(Catalog* C, int i, int sold, int day) {
+    LotRing* L = &C->lots[i]; int h = L->head;
+    if (L->count && sold < L->qty[h]) L->qty[h] -= sold;   /* the usual day: the oldest lot covers the sales */
+    else lot_take(L, sold);
+    return (L->count && L->useBy[L->head] <= day ? lot_expire(L, day) : 0);
+}
+/* Matches every ring to its stock after a change outside the day loop (load, what-if): stock the lots
+   do not cover is taken as received on `day`, a surplus leaves the oldest lots. SKUs without a shelf
+   life hold no lots. */
+static void lots_sync(Catalog* C, int day) {
+    if (!cat_own(C, CATCOL(lots))) { puts("OOM"); return; }
+    for (int i = 0; i < C->n; i++) {
+        LotRing* L = &C->lots[i]; int life = C->shelfLife[i], have = 0, stock = MAX(C->stock[i], 0);
+        if (L->head < 0 || L->head >= LOT_CAP || L->count < 0 || L->count > LOT_CAP) memset(L, 0, sizeof(*L));   /* not a valid ring */
+        if (life <= 0) { if (L->count) memset(L, 0, sizeof(*L)); continue; }
+        for (int k = 0; k < L->count; k++) have += L->qty[(L->head + k) % LOT_CAP];
+        if (have < stock) lot_push(L, stock - have, day + life - 1);
+        else if (have > stock) lot_take(L, have - stock);
+    }
+    C->lotDirty = 0;
+}
+
+/* ---------- Log writers ---------- */
+#define LOG_NUM_MAX 352   /* longest fmt_fixed() field: %.4f of -DBL_MAX is 315 characters */
+#define LOG_ROW_MAX (192 + 2 * LOG_NUM_MAX)   /* longest CSV row without the product name (at most two fmt_fixed() fields) */
+/* Row formatting without printf (it dominated CSV logging); output is identical to %lld / %.Nf */
+static char* fmt_ll(char* p, long long v) {
+    char t[24]; int n = 0; unsigned long long u = (v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v);
+    if (v < 0) *p++ = '-';
+    do t[n++] = (char)('0' + u % 10); while (u /= 10);
+    while (n) *p++ = t[--n];
+    return p;
+}
+/* %.{dec}f: x*10^dec is rounded directly unless it is within 1e-6 of a tie (or negative / huge), where
+   printf's exact-value rounding decides */
+static char* fmt_fixed(char* p, double x, int dec) {
+    static const long long scale[5] = { 1, 10, 100, 1000, 10000 };
+    double y = x * (double)scale[dec];
+    if (!(x >= 0.0 && y < 1e15) || fabs(y - floor(y) - 0.5) < 1e-6) {
+        char buf[LOG_NUM_MAX]; int k = snprintf(buf, sizeof(buf), "%.*f", dec, x);   /* k: the untruncated length */
+        k = (k < 0 ? 0 : MIN(k, (int)sizeof(buf) - 1));
+        memcpy(p, buf, (size_t)k); return p + k;
+    }
+    long long v = (long long)(y + 0.5), f = v % scale[dec];
+    p = fmt_ll(p, v / scale[dec]); *p++ = '.';
+    for (int k = dec - 1; k >= 0; k--) { p[k] = (char)('0' + f % 10); f /= 10; }
+    return p + dec;
+}
+static char* fmt_str(char* p, const char* s) { size_t n = strlen(s); memcpy(p, s, n); return p + n; }
+static void log_sale_row(Sim* S, int day, int i, int req, int srv, int shortage, int waste) {
+    Logger* L = S->log; if (!L) return; const Catalog* C = &S->cat;
+    if (L->format == LOG_FMT_BINARY) {
+        LogSaleRec r = { day, C->id[i], req, srv, shortage, waste, C->price[i] }; log_put(L, LOG_S_SALE, &r, sizeof(r)); return;
+    }
+    const char* nm = cat_name(C, i); size_t room = LOG_ROW_MAX + strlen(nm);
+    char* p = log_reserve(L, LOG_S_CSV, room), * q = p; double rev = srv * C->price[i];
+    q = fmt_str(q, "sale,"); q = fmt_ll(q, day); q = fmt_str(q, ",,,,"); q = fmt_ll(q, C->id[i]); *q++ = ','; q = fmt_str(q, nm);
+    q = fmt_str(q, ",,,,"); q = fmt_ll(q, req); *q++ = ','; q = fmt_ll(q, srv); *q++ = ','; q = fmt_fixed(q, C->price[i], 2); *q++ = ',';
+    q = fmt_fixed(q, rev, 2); *q++ = ','; q = fmt_ll(q, shortage); *q++ = ','; q = fmt_ll(q, waste); q = fmt_str(q, ",,,,,,\n");
+    L->cur[LOG_S_CSV]->len += (size_t)(q - p);
+}
+static void log_order_row(Sim* S, int dayPlaced, int poId, int i, int qty, int dueDay, int leadTime, double orderCost) {
+    Logger* L = S->log; if (!L) return; const Catalog* C = &S->cat;
+    if (L->format == LOG_FMT_BINARY) {
+        LogOrderRec r = { poId, dayPlaced, C->id[i], qty, dueDay, leadTime, orderCost }; log_put(L, LOG_S_ORDER, &r, sizeof(r)); return;
+    }
+    const char* nm = cat_name(C, i); size_t room = LOG_ROW_MAX + strlen(nm);
+    char* p = log_reserve(L, LOG_S_CSV, room), * q = p;
+    q = fmt_str(q, "order,,"); q = fmt_ll(q, poId); *q++ = ','; q = fmt_ll(q, dayPlaced); *q++ = ','; q = fmt_ll(q, C->id[i]); *q++ = ',';
+    q = fmt_str(q, nm); *q++ = ','; q = fmt_ll(q, qty); *q++ = ','; q = fmt_ll(q, dueDay); *q++ = ','; q = fmt_ll(q, leadTime); *q++ = ',';
+    q = fmt_fixed(q, orderCost, 2); q = fmt_str(q, ",,,,,,,,,,,\n");
+    L->cur[LOG_S_CSV]->len += (size_t)(q - p);
+}
+static void log_daily(Sim* S, int day, const DayTotals* D) {
+    Logger* L = S->log; if (!L) return; double fill = (D->requested > 0 ? ((double)D->served / (double)D->requested) : 1.0);
+    if (L->format == LOG_FMT_BINARY) {
+        LogDailyRec r = { day, 0, D->revenue, D->cogs, D->ordersCost, D->profit, fill, D->stockouts }; log_put(L, LOG_S_DAILY, &r, sizeof(r));
+    }
+    else {
+        char* p = log_reserve(L, LOG_S_CSV, LOG_ROW_MAX);
+        int k = snprintf(p, LOG_ROW_MAX, "daily,%d,,,,,,,,,,,,,,,%.2f,%.2f,%.2f,%.2f,%.4f,%lld\n",
+            day, D->revenue, D->cogs, D->ordersCost, D->profit, fill, D->stockouts);
+        if (k < 0) k = 0;
+        if (k >= LOG_ROW_MAX) { k = LOG_ROW_MAX - 1; p[k - 1] = '\n'; }   /* truncated: count only what was written, keep the row ending */
+        L->cur[LOG_S_CSV]->len += (size_t)k;
+    }
+    log_end_day(L, day);
+}
+
+/* ---------- Binary log -> CSV converter ---------- */
+typedef struct { FILE* f; unsigned int recSize; } LogReader;
+static int log_reader_open(LogReader* R, const char* path, int stream, unsigned int recSize) {
+    R->f = NULL; R->recSize = recSize;
+    if ((R->f = mm_fopen(path, "rb")) == NULL) return 0;
+    LogFileHdr h;
+    if (fread(&h, sizeof(h), 1, R->f) != 1 || h.magic != LOG_MAGIC || h.stream != (unsigned)stream || h.recSize != recSize || h.endian != 0x01020304u) {
+        fprintf(stderr, "ERR: %s is not a compatible binary log\n", path); fclose(R->f); R->f = NULL; return 0;
+    }
+    return 1;
+}
+static int log_reader_next(LogReader* R, void* rec) { return R->f && fread(rec, R->recSize, 1, R->f) == 1; }
+/* id -> name offset, open addressing; last definition wins */
+typedef struct { int* keys; int* vals; int cap, count; } IdMap;
+static int idmap_put(IdMap* M, int key, int val) {
+    if ((M->count + 1) * 2 > M->cap) {
+        int cap = M->cap ? M->cap * 2 : 1024; int* k = (int*)malloc(sizeof(int) * cap), * v = (int*)malloc(sizeof(int) * cap);
+        if (!k || !v) { free(k); free(v); return 0; }
+        for (int i = 0; i < cap; i++) v[i] = -1;
+        for (int i = 0; i < M->cap; i++) if (M->vals[i] >= 0) {
+            unsigned int h = ((unsigned)M->keys[i] * 2654435761u) & (unsigned)(cap - 1);
+            while (v[h] >= 0) h = (h + 1) & (unsigned)(cap - 1);
+            k[h] = M->keys[i]; v[h] = M->vals[i];
+        }
+        free(M->keys); free(M->vals); M->keys = k; M->vals = v; M->cap = cap;
+    }
+    unsigned int h = ((unsigned)key * 2654435761u) & (unsigned)(M->cap - 1);
+    while (M->vals[h] >= 0 && M->keys[h] != key) h = (h + 1) & (unsigned)(M->cap - 1);
+    if (M->vals[h] < 0) M->count++;
+    M->keys[h] = key; M->vals[h] = val; return 1;
+}
+static int idmap_get(const IdMap* M, int key) {
+    if (!M->cap) return -1;
+    unsigned int h = ((unsigned)key * 2654435761u) & (unsigned)(M->cap - 1);
+    while (M->vals[h] >= 0) { if (M->keys[h] == key) return M->vals[h]; h = (h + 1) & (unsigned)(M->cap - 1); }
+    return -1;
+}
+static void idmap_free(IdMap* M) { free(M->keys); free(M->vals); memset(M, 0, sizeof(*M)); }
+/* Rebuilds today's sim_all.csv layout from the binary streams: per day its sale rows, then the
+   orders placed that day, then the daily row */
+static int log_binary_to_csv(const char* outPath) {
+    StrTable names; memset(&names, 0, sizeof(names)); IdMap ids; memset(&ids, 0, sizeof(ids));
+    FILE* fn = NULL;
+    if ((fn = mm_fopen(LOG_NAMES_PATH, "rb")) != NULL) {
+        LogFileHdr h; LogNameRec r; char buf[4096];
+        if (fread(&h, sizeof(h), 1, fn) == 1 && h.magic == LOG_MAGIC)
+            while (fread(&r, sizeof(r), 1, fn) == 1 && r.len >= 0) {
+                int take = MIN(r.len, (int)sizeof(buf) - 1);
+                if (fread(buf, 1, take, fn) != (size_t)take) break;
+                if (r.len > take) fseek(fn, r.len - take, SEEK_CUR);
+                buf[take] = '\0'; int off = strtab_intern(&names, buf); if (off >= 0) idmap_put(&ids, r.productId, off);
+            }
+        fclose(fn);
+    }
+    LogReader rs, ro, rd;
+    int okS = log_reader_open(&rs, LOG_SALE_PATH, LOG_S_SALE, sizeof(LogSaleRec));
+    int okO = log_reader_open(&ro, LOG_ORDER_PATH, LOG_S_ORDER, sizeof(LogOrderRec));
+    int okD = log_reader_open(&rd, LOG_DAILY_PATH, LOG_S_DAILY, sizeof(LogDailyRec));
+    FILE* out = NULL;
+    if ((!okS && !okO && !okD) || (out = mm_fopen(outPath, "w")) == NULL) {
+        fprintf(stderr, "ERR: nothing to convert or cannot open %s\n", outPath);
+        if (rs.f) fclose(rs.f);
+        if (ro.f) fclose(ro.f);
+        if (rd.f) fclose(rd.f);
+        strtab_free(&names); idmap_free(&ids); return 1;
+    }
+    setvbuf(out, NULL, _IOFBF, 1 << 20);
+    fputs(LOG_CSV_HEADER, out);
+    LogSaleRec s; LogOrderRec o; LogDailyRec d; long long rows = 0;
+    int hasS = log_reader_next(&rs, &s), hasO = log_reader_next(&ro, &o), hasD = log_reader_next(&rd, &d);
+    while (hasS || hasO || hasD) {
+        int day = 0x7FFFFFFF;
+        if (hasS) day = MIN(day, s.day);
+        if (hasO) day = MIN(day, o.dayPlaced);
+        if (hasD) day = MIN(day, d.day);
+        for (; hasS && s.day == day; hasS = log_reader_next(&rs, &s), rows++) {
+            int off = idmap_get(&ids, s.productId);
+            fprintf(out, "sale,%d,,,,%d,%s,,,,%d,%d,%.2f,%.2f,%d,%d,,,,,,\n", s.day, s.productId, off >= 0 ? names.buf + off : "",
+                s.requested, s.served, s.unitPrice, s.served * s.unitPrice, s.shortage, s.waste);
+        }
+        for (; hasO && o.dayPlaced == day; hasO = log_reader_next(&ro, &o), rows++) {
+            int off = idmap_get(&ids, o.productId);
+            fprintf(out, "order,,%d,%d,%d,%s,%d,%d,%d,%.2f,,,,,,,,,,,\n", o.poId, o.dayPlaced, o.productId, off >= 0 ? names.buf + off : "",
+                o.qty, o.dueDay, o.leadTime, o.orderCost);
+        }
+        for (; hasD && d.day == day; hasD = log_reader_next(&rd, &d), rows++)
+            fprintf(out, "daily,%d,,,,,,,,,,,,,,,%.2f,%.2f,%.2f,%.2f,%.4f,%lld\n", d.day, d.revenue, d.cogs, d.orders, d.profit, d.fillRate, d.stockouts);
+    }
+    fclose(out); if (rs.f) fclose(rs.f); if (ro.f) fclose(ro.f); if (rd.f) fclose(rd.f);
+    strtab_free(&names); idmap_free(&ids);
+    printf("Converted %lld rows to %s\n", rows, outPath);
+    return 0;
+}
+
+/* ---------- Demand forecasting ---------- */
+static void fc_seasons(const Catalog* C, double** s) {
+    s[0] = C->fcSeason0; s[1] = C->fcSeason1; s[2] = C->fcSeason2; s[3] = C->fcSeason3; s[4] = C->fcSeason4; s[5] = C->fcSeason5; s[6] = C->fcSeason6;
+}
+/* 1 if some SKU reorders on its forecast; the models are only kept up to date then */
+static int forecast_active(Sim* S) {
+    Catalog* C = &S->cat;
+    if (C->polDirty) policy_index(C);
+    return C->polStart[POL_FORECAST + 1] > C->polStart[POL_FORECAST] ||
+           (S->cfg.defaultPolicy == POL_FORECAST && C->polStart[POL_CONFIG + 1] > C->polStart[POL_CONFIG]);
+}
+/* Today's demand y (lost sales included) into every SKU's model, in one pass over the catalog.
+   Error-correction form of additive Holt-Winters: e = y - (level + trend + season[today]),
+   level += trend + a*e, trend += a*b*e, season[today] += (1-a)*g*e. Holt is g = 0 and SES also b = 0,
+   so the three models are the same branch-free loop. fcMse tracks the one-step error variance;
+   the first observation sets the level. AVX-512 / AVX2 when the compiler targets them, scalar otherwise. */
+static void forecast_update(Sim* S, const int* y) {
+    Catalog* C = &S->cat; const Config* cfg = &S->cfg; int n = C->n, i = 0;
+    if (!cat_own(C, CAT_FORECAST_COLUMNS)) { puts("OOM"); return; }
+    double a = cfg->fcAlpha, b = (cfg->fcModel >= FC_HOLT ? a * cfg->fcBeta : 0.0), g = (cfg->fcModel == FC_HW ? (1.0 - a) * cfg->fcGamma : 0.0);
+    double* seas[FC_PERIOD]; fc_seasons(C, seas);
+    double* L = C->fcLevel, * T = C->fcTrend, * V = C->fcMse, * P = seas[S->day % FC_PERIOD]; int* age = C->fcDays;
+#if defined(__AVX512F__)
+    __m512d va = _mm512_set1_pd(a), vb = _mm512_set1_pd(b), vg = _mm512_set1_pd(g), vk = _mm512_set1_pd(FC_MSE_SMOOTH), one = _mm512_set1_pd(1.0), zero = _mm512_setzero_pd();
+    for (; i + 8 <= n; i += 8) {
+        __m256i ag = _mm256_loadu_si256((const __m256i*)(age + i));
+        __mmask8 first = _mm512_cmpeq_epi64_mask(_mm512_cvtepi32_epi64(ag), _mm512_setzero_si512());
+        __m512d yi = _mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i*)(y + i)));
+        __m512d l = _mm512_loadu_pd(L + i), t = _mm512_loadu_pd(T + i), p = _mm512_loadu_pd(P + i), v = _mm512_loadu_pd(V + i);
+        __m512d lt = _mm512_add_pd(l, t), e = _mm512_sub_pd(yi, _mm512_add_pd(lt, p));
+        _mm512_storeu_pd(L + i, _mm512_mask_blend_pd(first, _mm512_add_pd(lt, _mm512_mul_pd(va, e)), yi));
+        _mm512_storeu_pd(T + i, _mm512_mask_blend_pd(first, _mm512_add_pd(t, _mm512_mul_pd(vb, e)), zero));
+        _mm512_storeu_pd(P + i, _mm512_mask_blend_pd(first, _mm512_add_pd(p, _mm512_mul_pd(vg, e)), zero));
+        __m512d vn = _mm512_add_pd(v, _mm512_mul_pd(vk, _mm512_sub_pd(_mm512_mul_pd(e, e), v)));
+        _mm512_storeu_pd(V + i, _mm512_mask_blend_pd(first, vn, _mm512_max_pd(yi, one)));
+        _mm256_storeu_si256((__m256i*)(age + i), _mm256_add_epi32(ag, _mm256_set1_epi32(1)));
+    }
+#elif defined(__AVX2__)
+    __m256d va = _mm256_set1_pd(a), vb = _mm256_set1_pd(b), vg = _mm256_set1_pd(g), vk = _mm256_set1_pd(FC_MSE_SMOOTH), one = _mm256_set1_pd(1.0), zero = _mm256_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+        __m128i ag = _mm_loadu_si128((const __m128i*)(age + i));
+        __m256d first = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(ag, _mm_setzero_si128())));
+        __m256d yi = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(y + i)));
+        __m256d l = _mm256_loadu_pd(L + i), t = _mm256_loadu_pd(T + i), p = _mm256_loadu_pd(P + i), v = _mm256_loadu_pd(V + i);
+        __m256d lt = _mm256_add_pd(l, t), e = _mm256_sub_pd(yi, _mm256_add_pd(lt, p));
+        _mm256_storeu_pd(L + i, _mm256_blendv_pd(_mm256_add_pd(lt, _mm256_mul_pd(va, e)), yi, first));
+        _mm256_storeu_pd(T + i, _mm256_blendv_pd(_mm256_add_pd(t, _mm256_mul_pd(vb, e)), zero, first));
+        _mm256_storeu_pd(P + i, _mm256_blendv_pd(_mm256_add_pd(p, _mm256_mul_pd(vg, e)), zero, first));
+        __m256d vn = _mm256_add_pd(v, _mm256_mul_pd(vk, _mm256_sub_pd(_mm256_mul_pd(e, e), v)));
+        _mm256_storeu_pd(V + i, _mm256_blendv_pd(vn, _mm256_max_pd(yi, one), first));
+        _mm_storeu_si128((__m128i*)(age + i), _mm_add_epi32(ag, _mm_set1_epi32(1)));
+    }
+#endif
+    for (; i < n; i++) {
+        double yi = y[i], lt = L[i] + T[i], e = yi - (lt + P[i]);
+        if (age[i] == 0) { L[i] = yi; T[i] = 0.0; P[i] = 0.0; V[i] = MAX(yi, 1.0); }
+        else { L[i] = lt + a * e; T[i] += b * e; P[i] += g * e; V[i] += FC_MSE_SMOOTH * (e * e - V[i]); }
+        age[i]++;
+    }
+}
+/* Forecast policy for the SKUs idx[0..cnt): protection period P = mean lead time + 1 review day,
+   s = forecast demand over P + z * sigma * sqrt(P) (z from the service level), S = s + coverDays x
+   the daily level; IP <= s -> order up to S */
+static void forecast_orders(const Sim* S, const int* idx, int cnt, int* qty) {
+    const Catalog* C = &S->cat; const Config* cfg = &S->cfg;
+    double P = (cfg->leadMin + cfg->leadMax) / 2.0 + 1.0; int whole = (int)P; double frac = P - whole;
+    double z = normal_quantile(MIN(MAX(cfg->serviceLevel, 0.5), 0.9999)), zs = z * sqrt(P);
+    double tri = whole * (whole + 1) / 2.0 + frac * (whole + 1);   /* sum of the horizons h = 1..P */
+    /* weekday seasons over the horizon: weight = how often each weekday occurs in it */
+    double* seas[FC_PERIOD]; fc_seasons(C, seas); const double* ws[FC_PERIOD]; double wt[FC_PERIOD] = { 0 }; int nw = 0;
+    if (cfg->fcModel == FC_HW) {
+        for (int h = 1; h <= whole; h++) wt[(S->day + h) % FC_PERIOD] += 1.0;
+        wt[(S->day + whole + 1) % FC_PERIOD] += frac;
+        for (int w = 0; w < FC_PERIOD; w++) if (wt[w] != 0.0) { ws[nw] = seas[w]; wt[nw++] = wt[w]; }
+    }
+    for (int k = 0; k < cnt; k++) {
+        int i = idx[k], ip = C->stock[i] + C->onOrder[i];
+        double mu = P * C->fcLevel[i] + tri * C->fcTrend[i];
+        for (int w = 0; w < nw; w++) mu += wt[w] * ws[w][i];
+        double sx = MAX(mu, 0.0) + zs * sqrt(C->fcMse[i]), qx = MAX(C->fcLevel[i], 0.0) * cfg->coverDays;
+        int sp = (int)sx, q = (int)qx; sp += (sp < sx); q += (q < qx);   /* ceil of non-negative values without the libm call */
+        int upTo = sp + MAX(1, q);
+        qty[i] = (ip <= sp) ? upTo - ip : 0;
+    }
+}
+
+/* ---------- Replenishment policies ---------- */
+static const char* POLICY_NAMES[POL_COUNT] = { "default", "sq", "ss", "rs", "base", "minmax", "forecast" };
+
+/* Header names -> column numbers (-1 if absent); returns 1 if any policy column is present */
+static int policy_columns(char** hdr, int nh, int* col) {
+    static const char* names[PCOL_COUNT][4] = {
+        { "policy" }, { "reorder_point", "s", "min" }, { "order_qty", "order_quantity", "q", "Q" },
+        { "order_up_to", "S", "max" }, { "review_period", "R" }, { "moq" }, { "case_pack", "pack" } };
+    int any = 0;
+    for (int k = 0; k < PCOL_COUNT; k++) {
+        col[k] = -1;
+        for (int c = 0; c < nh && col[k] < 0; c++)
+            for (int a = 0; a < 4 && names[k][a]; a++) if (!strcmp(hdr[c], names[k][a])) { col[k] = c; any = 1; break; }
+    }
+    return any;
+}
+/* Applies the policy columns of one row to SKU i; empty cells keep the current value. Without a policy
+   column the type follows the parameters: S given -> (s,S), Q given -> (s,Q). Returns 1 if anything was set,
+   -1 for an unknown policy name (nothing applied). */
+static int policy_apply_row(Catalog* C, int i, char** fld, int nf, const int* col) {
+#define PCELL(k) (col[k] >= 0 && col[k] < nf && fld[col[k]][0] ? fld[col[k]] : NULL)
+    const char* v; int set = 0, type = -1;
+    if ((v = PCELL(PCOL_POLICY)) != NULL) {
+        for (int t = 0; t < POL_COUNT; t++) { const char* a = POLICY_NAMES[t]; const char* b = v; while (*a && tolower((unsigned char)*b) == *a) { a++; b++; } if (!*a && !*b) type = t; }
+        if (type < 0) return -1;
+    }
+    if ((v = PCELL(PCOL_S)) != NULL)    { C->reorderPoint[i] = atoi(v); set = 1; }
+    if ((v = PCELL(PCOL_Q)) != NULL)    { C->orderQty[i] = atoi(v); set = 1; }
+    if ((v = PCELL(PCOL_UPTO)) != NULL) { C->orderUpTo[i] = atoi(v); set = 1; }
+    if ((v = PCELL(PCOL_R)) != NULL)    { C->reviewPeriod[i] = MAX(1, atoi(v)); set = 1; }
+    if ((v = PCELL(PCOL_MOQ)) != NULL)  { C->moq[i] = MAX(0, atoi(v)); set = 1; }
+    if ((v = PCELL(PCOL_PACK)) != NULL) { C->casePack[i] = MAX(1, atoi(v)); set = 1; }
+    if (type < 0) type = (PCELL(PCOL_UPTO) ? POL_SS : PCELL(PCOL_Q) ? POL_SQ : -1);
+#undef PCELL
+    if (type >= 0) { C->policy[i] = type; C->polDirty = 1; set = 1; }
+    return set;
+}
+/* sim_policy.csv: id plus policy columns by header name (id,name,policy,reorder_point,order_qty,...);
+   returns the number of SKUs updated */
+static int load_policy_csv(Sim* S, const char* path) {
+    MappedFile m; if (!map_file(&m, path)) return 0;
+    const char* p = (const char*)m.p, * end = p + m.size; long long line = 1;
+    if (m.size >= 3 && !memcmp(p, "\xEF\xBB\xBF", 3)) p += 3;
+    CsvRow R; memset(&R, 0, sizeof(R)); int pcol[PCOL_COUNT], idCol = -1, applied = 0;
+    p = csv_record(p, end, &R, &line);
+    for (int c = 0; c < R.n; c++) if (!strcmp(R.fld[c], "id")) idCol = c;
+    if (idCol < 0 || !policy_columns(R.fld, R.n, pcol)) {
+        fprintf(stderr, "ERR: %s needs an id column and policy columns\n", path); free(R.buf); unmap_file(&m); return 0;
+    }
+    Catalog* C = &S->cat; IdMap ids; memset(&ids, 0, sizeof(ids));
+    for (int i = 0; i < C->n; i++) idmap_put(&ids, C->id[i], i);
+    while (p < end) {
+        long long at = line; p = csv_record(p, end, &R, &line);
+        if (R.n <= idCol || !R.fld[idCol][0]) continue;
+        int id, i = -1, r = 0;
+        if (R.bad) { fprintf(stderr, "ERR: %s:%lld: %s\n", path, at, R.bad); continue; }
+        if (parse_int(R.fld[idCol], &id)) i = idmap_get(&ids, id);
+        if (i < 0) { fprintf(stderr, "ERR: %s:%lld: unknown product id '%s'\n", path, at, R.fld[idCol]); continue; }
+        if ((r = policy_apply_row(C, i, R.fld, R.n, pcol)) < 0) fprintf(stderr, "ERR: %s:%lld: unknown policy '%s'\n", path, at, R.fld[pcol[PCOL_POLICY]]);
+        else if (r) applied++;
+    }
+    free(R.buf); unmap_file(&m); idmap_free(&ids);
+    return applied;
+}
+/* sim_demand.csv: id plus any of base (units/day at the reference price), elasticity, promo (lift while on
+   sale); empty cells keep the current value. Returns the number of SKUs updated. */
+static int load_demand_csv(Sim* S, const char* path) {
+    MappedFile m; if (!map_file(&m, path)) return 0;
+    const char* p = (const char*)m.p, * end = p + m.size; long long line = 1;
+    if (m.size >= 3 && !memcmp(p, "\xEF\xBB\xBF", 3)) p += 3;
+    CsvRow R; memset(&R, 0, sizeof(R)); int col[3] = { -1, -1, -1 }, idCol = -1, applied = 0;
+    p = csv_record(p, end, &R, &line);
+    for (int c = 0; c < R.n; c++) {
+        if (!strcmp(R.fld[c], "id")) idCol = c;
+        else if (!strcmp(R.fld[c], "base") || !strcmp(R.fld[c], "base_rate")) col[0] = c;
+        else if (!strcmp(R.fld[c], "elasticity")) col[1] = c;
+        else if (!strcmp(R.fld[c], "promo") || !strcmp(R.fld[c], "promo_lift")) col[2] = c;
+    }
+    if (idCol < 0 || (col[0] < 0 && col[1] < 0 && col[2] < 0)) {
+        fprintf(stderr, "ERR: %s needs an id column and base / elasticity / promo columns\n", path); free(R.buf); unmap_file(&m); return 0;
+    }
+    Catalog* C = &S->cat; IdMap ids; memset(&ids, 0, sizeof(ids));
+    if (!cat_own(C, CATCOL(dmBase) | CATCOL(dmElast) | CATCOL(dmPromo))) { puts("OOM"); free(R.buf); unmap_file(&m); return 0; }
+    for (int i = 0; i < C->n; i++) idmap_put(&ids, C->id[i], i);
+    while (p < end) {
+        long long at = line; p = csv_record(p, end, &R, &line);
+        if (R.n <= idCol || !R.fld[idCol][0]) continue;
+        int id, i = -1, set = 0; double v[3];
+        if (R.bad) { fprintf(stderr, "ERR: %s:%lld: %s\n", path, at, R.bad); continue; }
+        if (parse_int(R.fld[idCol], &id)) i = idmap_get(&ids, id);
+        if (i < 0) { fprintf(stderr, "ERR: %s:%lld: unknown product id '%s'\n", path, at, R.fld[idCol]); continue; }
+        int bad = -1;
+        for (int k = 0; k < 3; k++) {
+            const char* cell = (col[k] >= 0 && col[k] < R.n ? R.fld[col[k]] : "");
+            v[k] = -1.0; if (cell[0] && (!parse_double(cell, &v[k]) || v[k] < 0.0)) bad = col[k];
+        }
+        if (bad >= 0) { fprintf(stderr, "ERR: %s:%lld: bad value '%s'\n", path, at, R.fld[bad]); continue; }
+        if (v[0] >= 0.0) { C->dmBase[i] = v[0]; set = 1; }
+        if (v[1] >= 0.0) { C->dmElast[i] = v[1]; set = 1; }
+        if (v[2] >= 0.0) { C->dmPromo[i] = v[2]; set = 1; }
+        applied += set;
+    }
+    free(R.buf); unmap_file(&m); idmap_free(&ids);
+    if (applied) C->dmDirty = 1;
+    return applied;
+}
+/* Groups SKUs by policy type (counting sort, catalog order within a type) */
+static void policy_index(Catalog* C) {
+    int cnt[POL_COUNT] = { 0 };
+    if (!cat_own(C, CATCOL(policy) | CATCOL(reviewPeriod) | CATCOL(polIdx))) { puts("OOM"); return; }
+    for (int i = 0; i < C->n; i++) {
+        if (C->policy[i] < 0 || C->policy[i] >= POL_COUNT) C->policy[i] = POL_CONFIG;
+        if (C->reviewPeriod[i] < 1) C->reviewPeriod[i] = 1;
+        cnt[C->policy[i]]++;
+    }
+    C->polStart[0] = 0; for (int t = 0; t < POL_COUNT; t++) C->polStart[t + 1] = C->polStart[t] + cnt[t];
+    int at[POL_COUNT]; memcpy(at, C->polStart, sizeof(at));
+    for (int i = 0; i < C->n; i++) C->polIdx[at[C->policy[i]]++] = i;
+    C->polDirty = 0;
+}
+/* qty[i] = units to order today (0 = none). One branch-free loop per policy type over its SKUs,
+   then MOQ and case-pack rounding. */
+static void reorder_quantities(Sim* S, int* qty) {
+    Catalog* C = &S->cat;
+    if (C->polDirty) policy_index(C);
+    const int* stock = C->stock, * onOrder = C->onOrder, * rop = C->reorderPoint, * oq = C->orderQty, * upTo = C->orderUpTo, * R = C->reviewPeriod;
+    for (int t = 0; t < POL_COUNT; t++) {
+        const int* idx = C->polIdx + C->polStart[t]; int cnt = C->polStart[t + 1] - C->polStart[t];
+        switch (t) {
+        case POL_CONFIG: {
+            if (S->cfg.defaultPolicy == POL_FORECAST) { forecast_orders(S, idx, cnt, qty); break; }
+            int sp = S->cfg.reorder_point, q = S->cfg.order_quantity;
+            for (int k = 0; k < cnt; k++) { int i = idx[k]; qty[i] = (stock[i] + onOrder[i] <= sp) ? q : 0; }
+        } break;
+        case POL_SQ:
+            for (int k = 0; k < cnt; k++) { int i = idx[k]; qty[i] = (stock[i] + onOrder[i] <= rop[i]) ? oq[i] : 0; }
+            break;
+        case POL_SS: case POL_MINMAX:
+            for (int k = 0; k < cnt; k++) { int i = idx[k], ip = stock[i] + onOrder[i]; qty[i] = (ip <= rop[i]) ? upTo[i] - ip : 0; }
+            break;
+        case POL_RS:
+            for (int k = 0; k < cnt; k++) { int i = idx[k], ip = stock[i] + onOrder[i]; qty[i] = (S->day % R[i] == 0) ? upTo[i] - ip : 0; }
+            break;
+        case POL_BASE:
+            for (int k = 0; k < cnt; k++) { int i = idx[k]; qty[i] = upTo[i] - stock[i] - onOrder[i]; }
+            break;
+        case POL_FORECAST:
+            forecast_orders(S, idx, cnt, qty);
+            break;
+        }
+    }
+    const int* moq = C->moq, * pack = C->casePack;
+    for (int i = 0; i < C->n; i++) {
+        int q = qty[i]; if (q <= 0) { qty[i] = 0; continue; }
+        if (q < moq[i]) q = moq[i];
+        if (pack[i] > 1) q = (q + pack[i] - 1) / pack[i] * pack[i];
+        qty[i] = q;
+    }
+}
+
+/* ---------- PERSISTENCE (checkpoint + journal) ---------- */
+typedef struct { int poId, productIndex, qty, dueDay, leadTime; } SavePO;
+/* Read-only view of a whole file: memory-mapped, or read into memory if mapping is unavailable */
+static int map_file(MappedFile* m, const char* path) {
+    memset(m, 0, sizeof(*m));
+#ifdef _WIN32
+    HANDLE hf = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hf == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER sz; if (!GetFileSizeEx(hf, &sz) || sz.QuadPart == 0) { CloseHandle(hf); return 0; }
+    HANDLE hm = CreateFileMappingA(hf, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void* p = hm ? MapViewOfFile(hm, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (p) { m->p = (const unsigned char*)p; m->size = (size_t)sz.QuadPart; m->mapped = 1; m->hFile = hf; m->hMap = hm; return 1; }
+    if (hm) CloseHandle(hm); CloseHandle(hf);
+#else
+    int fd = open(path, O_RDONLY); if (fd < 0) return 0;
+    struct stat st; if (fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return 0; }
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0); close(fd);
+    if (p != MAP_FAILED) { m->p = (const unsigned char*)p; m->size = (size_t)st.st_size; m->mapped = 1; return 1; }
+#endif
+    FILE* f = mm_fopen(path, "rb"); if (!f) return 0;
+    fseek(f, 0, SEEK_END); long sz2 = ftell(f); fseek(f, 0, SEEK_SET);
+    unsigned char* buf = (sz2 > 0 ? (unsigned char*)malloc((size_t)sz2) : NULL);
+    if (!buf || fread(buf, 1, (size_t)sz2, f) != (size_t)sz2) { free(buf); fclose(f); return 0; }
+    fclose(f); m->p = buf; m->size = (size_t)sz2; return 1;
+}
+static void unmap_file(MappedFile* m) {
+    if (!m->p) return;
+#ifdef _WIN32
+    if (m->mapped) { UnmapViewOfFile(m->p); CloseHandle((HANDLE)m->hMap); CloseHandle((HANDLE)m->hFile); }
+#else
+    if (m->mapped) munmap((void*)m->p, m->size);
+#endif
+    else free((void*)m->p);
+    memset(m, 0, sizeof(*m));
+}
+/* Data reaches the disk before the file is renamed over the previous checkpoint */
+static int file_sync(FILE* f) {
+    if (fflush(f) != 0) return 0;
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+static int file_stamp(const char* path, FileStamp* st) {
+#ifdef _WIN32
+    struct __stat64 sb; if (_stat64(path, &sb) != 0) return 0;
+#else
+    struct stat sb; if (stat(path, &sb) != 0) return 0;
+#endif
+    st->size = (long long)sb.st_size; st->mtime = (long long)sb.st_mtime; return 1;
+}
+static int file_replace(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+static unsigned int fnv1a(const void* p, size_t n) {
+    const unsigned char* b = (const unsigned char*)p; unsigned int h = 2166136261u;
+    for (size_t i = 0; i < n; i++) { h ^= b[i]; h *= 16777619u; }
+    return h;
+}
+
+typedef struct { FILE* f; unsigned long long pos; int ok; } CkptWriter;
+static void ckpt_write(CkptWriter* w, const void* p, size_t n) { if (w->ok && n && fwrite(p, 1, n, w->f) != n) w->ok = 0; w->pos += n; }
+static void ckpt_section(CkptWriter* w, CkptHeader* h, const char* name, const void* p, unsigned int elemSize, unsigned int count, unsigned long long bytes) {
+    static const char zeros[CKPT_ALIGN] = { 0 };
+    if (h->nSections >= CKPT_MAX_SECTIONS) { w->ok = 0; return; }
+    ckpt_write(w, zeros, (size_t)((CKPT_ALIGN - w->pos % CKPT_ALIGN) % CKPT_ALIGN));
+    CkptSection* s = &h->sec[h->nSections++];
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    s->offset = w->pos; s->bytes = bytes; s->elemSize = elemSize; s->count = count;
+    ckpt_write(w, p, (size_t)bytes);
+}
+static const CkptSection* ckpt_find(const CkptHeader* h, const char* name) {
+    for (int i = 0; i < h->nSections; i++) if (!strncmp(h->sec[i].name, name, sizeof(h->sec[i].name))) return &h->sec[i];
+    return NULL;
+}
+static int ckpt_begin(CkptWriter* w, CkptHeader* h, const char* tmp, unsigned int magic) {
+    w->f = NULL; w->pos = 0; w->ok = 1;
+    if ((w->f = mm_fopen(tmp, "wb")) == NULL) return 0;
+    memset(h, 0, sizeof(*h));
+    h->magic = magic; h->version = CKPT_VERSION; h->endian = ENDIAN_TAG; h->hdrSize = sizeof(*h);
+    ckpt_write(w, h, sizeof(*h));   /* placeholder, rewritten with the section table by ckpt_finish */
+    return 1;
+}
+static int ckpt_finish(CkptWriter* w, const CkptHeader* h, const char* tmp, const char* path) {
+    if (w->ok) { fseek(w->f, 0, SEEK_SET); if (fwrite(h, sizeof(*h), 1, w->f) != 1) w->ok = 0; }
+    if (w->ok && !file_sync(w->f)) w->ok = 0;
+    fclose(w->f);
+    if (!w->ok || !file_replace(tmp, path)) { remove(tmp); return 0; }
+    return 1;
+}
+/* Persisted columns by name, plus the name blob. Lots are left out while no SKU has a shelf life. */
+static void ckpt_write_catalog(CkptWriter* w, CkptHeader* h, const Catalog* C) {
+    int dated = 0; for (int i = 0; i < C->n && !dated; i++) dated = (C->shelfLife[i] > 0);
+#define X(type, field) if (CATCOL_##field != CATCOL_lots || dated) \
+        ckpt_section(w, h, #field, C->field, sizeof(type), (unsigned)C->n, (unsigned long long)sizeof(type) * C->n);
+    CATALOG_COLUMNS(X)
+#undef X
+    ckpt_section(w, h, "names", C->names.buf, 1, (unsigned)C->names.len, (unsigned long long)C->names.len);
+}
+/* Maps `path` and checks the header and section bounds; NULL if it is not a valid file of this kind */
+static const CkptHeader* ckpt_map(MappedFile* m, const char* path, unsigned int magic) {
+    if (!map_file(m, path)) return NULL;
+    const CkptHeader* h = (const CkptHeader*)m->p;
+    const size_t tableAt = offsetof(CkptHeader, sec);   /* older files have a shorter section table */
+    int ok = (m->size >= tableAt && h->magic == magic && h->version == CKPT_VERSION && h->endian == ENDIAN_TAG &&
+              h->hdrSize >= tableAt && h->hdrSize <= sizeof(CkptHeader) && m->size >= h->hdrSize && h->n >= 0 && h->nSections >= 0 &&
+              (size_t)h->nSections <= (h->hdrSize - tableAt) / sizeof(CkptSection));
+    for (int i = 0; ok && i < h->nSections; i++)
+        if (h->sec[i].offset > m->size || h->sec[i].bytes > m->size - h->sec[i].offset) ok = 0;
+    if (!ok) { unmap_file(m); return NULL; }
+    return h;
+}
+/* Copies the mapped columns into a fresh catalog T (owned arrays: the catalog grows and is mutated).
+   Columns missing from the file stay zero. */
+static int ckpt_read_catalog(const CkptHeader* h, const MappedFile* m, Catalog* T) {
+    int n = h->n;
+    cat_init(T);
+    if (!cat_reserve(T, n > 0 ? n : 1)) return 0;
+    int ok = 1; const CkptSection* sec;
+#define X(type, field) if (ok && (sec = ckpt_find(h, #field)) != NULL) { \
+        if (sec->elemSize != sizeof(type) || sec->count != (unsigned)n) ok = 0; else if (n) memcpy(T->field, m->p + sec->offset, sizeof(type) * (size_t)n); }
+    CATALOG_COLUMNS(X)
+#undef X
+    const CkptSection* secNames = ckpt_find(h, "names");
+    if (ok && n > 0 && !secNames) ok = 0;
+    if (ok && secNames) {
+        char* blob = (char*)malloc((size_t)secNames->bytes + 1);
+        if (!blob) ok = 0;
+        else {
+            memcpy(blob, m->p + secNames->offset, (size_t)secNames->bytes); blob[secNames->bytes] = '\0';
+            for (int i = 0; i < n && ok; i++) {
+                if (T->nameOff[i] < 0 || (unsigned long long)T->nameOff[i] >= secNames->bytes || (T->nameOff[i] = strtab_intern(&T->names, blob + T->nameOff[i])) < 0) ok = 0;
+            }
+            free(blob);
+        }
+    }
+    if (!ok) { cat_free(T); return 0; }
+    if (!ckpt_find(h, "dmElast")) for (int i = 0; i < n; i++) { T->dmElast[i] = 1.0; T->dmPromo[i] = 1.25; }   /* saved before the demand model */
+    T->n = n; T->polDirty = 1; T->dmDirty = 1; T->lotDirty = 1;
+    return 1;
+}
+
+/* Full checkpoint, written to a temp file and atomically renamed over `path`; starts a new journal */
+static int save_state(Sim* S, const char* path) {
+    char tmp[512]; snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    CkptWriter w; CkptHeader h;
+    if (!ckpt_begin(&w, &h, tmp, CKPT_MAGIC)) return 0;
+    const Catalog* C = &S->cat;
+    unsigned long long e = S->stateEpoch ^ (unsigned long long)time(NULL) ^ ((unsigned long long)S->day << 32);
+    h.epoch = splitmix64(&e) | 1; h.day = S->day; h.nextPO = S->nextPO; h.n = C->n;
+
+    char cfgText[4096]; int cfgLen = config_to_text(&S->cfg, cfgText, sizeof(cfgText));
+    ckpt_section(&w, &h, "config", cfgText, 1, (unsigned)cfgLen, (unsigned long long)cfgLen);
+    ckpt_write_catalog(&w, &h, C);
+    SavePO* pos = (SavePO*)malloc(sizeof(SavePO) * (S->pos.count > 0 ? S->pos.count : 1)); int count = 0;
+    if (!pos) w.ok = 0;
+    else for (PO* n = pobook_next(&S->pos, S->day, NULL); n; n = pobook_next(&S->pos, S->day, n)) {
+        SavePO sp = { n->poId, n->productIndex, n->qty, n->dueDay, n->leadTime }; pos[count++] = sp;
+    }
+    if (pos) ckpt_section(&w, &h, "pos", pos, sizeof(SavePO), (unsigned)count, (unsigned long long)sizeof(SavePO) * count);
+    free(pos);
+    if (!ckpt_finish(&w, &h, tmp, path)) return 0;
+    STATS_ADD(S, saveBytes, (long long)w.pos); STATS_ADD(S, checkpoints, 1);
+
+    /* the old journal's deltas are now inside the checkpoint */
+    S->stateEpoch = h.epoch;
+    FILE* jf = NULL;
+    if ((jf = mm_fopen(JOURNAL_PATH, "wb")) != NULL) {
+        JournalFileHdr jh = { JNL_MAGIC, CKPT_VERSION, ENDIAN_TAG, 0, h.epoch };
+        fwrite(&jh, sizeof(jh), 1, jf); fflush(jf);
+    }
+    if (S->jnl) {
+        if (S->jnl->f) fclose(S->jnl->f);
+        S->jnl->f = jf; S->jnl->days = 0; S->jnl->bytes = sizeof(JournalFileHdr); S->jnl->ckptBytes = (long long)w.pos;
+    }
+    else if (jf) fclose(jf);
+    return 1;
+}
+
+/* Applies one journal day record on top of S (the state at the end of the previous day) */
+static int journal_replay_day(Sim* S, const JournalDayHdr* h, const unsigned char* payload) {
+    Catalog* C = &S->cat;
+    const JournalSku* sku = (const JournalSku*)payload;
+    const NewPO* created = (const NewPO*)(payload + sizeof(JournalSku) * h->nChanged);
+    if (h->day != S->day + 1) return 0;
+    S->day = h->day;
+    int received = 0;
+    if (C->lotDirty) lots_sync(C, S->day);
+    PO* arrivals = pobook_pop_due(&S->pos, C, S->day);
+    for (PO* a = arrivals; a; a = a->next) { C->stock[a->productIndex] += a->qty; lot_receive(C, a->productIndex, a->qty, S->day); received++; }
+    pobook_release(&S->pos, arrivals);
+    if (received != h->nReceived) return 0;
+    for (int k = 0; k < h->nChanged; k++) {
+        int i = sku[k].index; if (i < 0 || i >= C->n) return 0;
+        int r = sku[k].requested, v = sku[k].served;
+        C->stock[i] -= v; C->requested[i] += r; C->served[i] += v; C->stockouts[i] += r - v;
+        C->revenue[i] += v * C->price[i]; C->cogs[i] += v * C->baseCost[i];
+        C->stock[i] -= sku[k].waste; C->wasteUnits[i] += sku[k].waste;
+        if (C->shelfLife[i] > 0) lots_end_day(C, i, v, S->day);   /* the recorded waste is what expired */
+    }
+    if (forecast_active(S)) {   /* the models saw the full day's demand, zeros included */
+        int* req = (int*)arena_alloc(&S->scratch, sizeof(int) * C->n); if (!req) return 0;
+        memset(req, 0, sizeof(int) * C->n);
+        for (int k = 0; k < h->nChanged; k++) req[sku[k].index] = sku[k].requested;
+        forecast_update(S, req); arena_reset(&S->scratch);
+    }
+    for (int k = 0; k < h->nCreated; k++) {
+        const NewPO* np = &created[k]; if (np->productIndex < 0 || np->productIndex >= C->n) return 0;
+        PO* node = pobook_node(&S->pos); if (!node) return 0;
+        node->poId = np->poId; node->productIndex = np->productIndex; node->qty = np->qty; node->dueDay = np->dueDay; node->leadTime = np->leadTime;
+        if (!pobook_add(&S->pos, C, S->day, node)) { pobook_release(&S->pos, node); return 0; }
+        C->ordersCost[np->productIndex] += np->orderCost;
+    }
+    S->nextPO = h->nextPO;
+    return 1;
+}
+/* Maps the checkpoint, then replays the journal tail. S->stateEpoch is left at 0 when the journal
+   cannot simply be appended to (missing, other epoch, torn tail), so the next save compacts. */
+static int load_state(Sim* S, const char* path) {
+    MappedFile m; const CkptHeader* h = ckpt_map(&m, path, CKPT_MAGIC);
+    if (!h) return 0;
+    int n = h->n;
+
+    /* read into a fresh catalog; the current one is only replaced once everything parsed */
+    Catalog T;
+    if (!ckpt_read_catalog(h, &m, &T)) { unmap_file(&m); return 0; }
+    cat_free(&S->cat); S->cat = T;
+    S->agg.valid = 0; if (S->rank) S->rank->valid = 0;   /* new counters: report indexes rebuild on demand */
+
+    const CkptSection* secCfg = ckpt_find(h, "config");
+    if (secCfg) {
+        const char* p = (const char*)m.p + secCfg->offset, * end = p + secCfg->bytes;
+        while (p < end) {
+            char line[512]; int len = 0;
+            while (p < end && *p != '\n' && len < (int)sizeof(line) - 1) line[len++] = *p++;
+            if (p < end) p++;
+            line[len] = '\0'; config_apply_line(&S->cfg, NULL, line);
+        }
+    }
+    S->day = h->day; S->nextPO = h->nextPO;
+    pobook_free(&S->pos);
+    const CkptSection* secPos = ckpt_find(h, "pos");
+    if (secPos && secPos->elemSize == sizeof(SavePO)) {
+        const SavePO* sp = (const SavePO*)(m.p + secPos->offset);
+        for (unsigned int i = 0; i < secPos->count && (unsigned long long)(i + 1) * sizeof(SavePO) <= secPos->bytes; i++) {
+            SavePO s = sp[i];
+            if (s.productIndex < 0 || s.productIndex >= n) continue;
+            PO* node = pobook_node(&S->pos);   /* not po_create(): the saved id is kept, nextPO untouched */
+            if (node) {
+                node->poId = s.poId; node->productIndex = s.productIndex; node->qty = s.qty; node->dueDay = s.dueDay; node->leadTime = s.leadTime; node->next = NULL;
+                if (!pobook_add(&S->pos, &S->cat, S->day, node)) pobook_release(&S->pos, node);
+            }
+            if (S->nextPO <= s.poId) S->nextPO = s.poId + 1;
+        }
+    }
+    unsigned long long epoch = h->epoch;
+    unmap_file(&m);
+    S->rngKey = S->cfg.seed;
+
+    /* journal tail: stop at the first record that is incomplete, corrupt or out of sequence */
+    S->stateEpoch = 0;
+    MappedFile jm;
+    if (map_file(&jm, JOURNAL_PATH)) {
+        const JournalFileHdr* jh = (const JournalFileHdr*)jm.p; size_t off = sizeof(JournalFileHdr); int clean = 0;
+        if (jm.size >= sizeof(JournalFileHdr) && jh->magic == JNL_MAGIC && jh->endian == ENDIAN_TAG && jh->epoch == epoch) {
+            clean = 1;
+            while (off < jm.size) {
+                JournalDayHdr dh;
+                if (jm.size - off < sizeof(dh)) { clean = 0; break; }
+                memcpy(&dh, jm.p + off, sizeof(dh));
+                size_t need = sizeof(JournalSku) * (size_t)dh.nChanged + sizeof(NewPO) * (size_t)dh.nCreated;
+                if (dh.magic != JNL_DAY_MAGIC || dh.nChanged < 0 || dh.nCreated < 0 || dh.bytes != need || jm.size - off - sizeof(dh) < need ||
+                    fnv1a(jm.p + off + sizeof(dh), need) != dh.checksum) { clean = 0; break; }
+                unsigned char* payload = (unsigned char*)malloc(need ? need : 1);   /* aligned copy */
+                if (!payload) { clean = 0; break; }
+                memcpy(payload, jm.p + off + sizeof(dh), need);
+                int applied = journal_replay_day(S, &dh, payload);
+                free(payload);
+                if (!applied) { clean = 0; break; }
+                off += sizeof(dh) + need;
+            }
+        }
+        unmap_file(&jm);
+        if (clean) S->stateEpoch = epoch;
+    }
+    else {
+        /* checkpoint without journal (e.g. written on exit): start an empty one */
+        FILE* jf = NULL;
+        if ((jf = mm_fopen(JOURNAL_PATH, "wb")) != NULL) {
+            JournalFileHdr jh = { JNL_MAGIC, CKPT_VERSION, ENDIAN_TAG, 0, epoch };
+            if (fwrite(&jh, sizeof(jh), 1, jf) == 1) S->stateEpoch = epoch;
+            fclose(jf);
+        }
+    }
+    return 1;
+}
+
+static Journal* journal_open(int checkpointDays) {
+    Journal* J = (Journal*)calloc(1, sizeof(Journal)); if (!J) return NULL;
+    J->every = checkpointDays;
+    return J;
+}
+/* Appends the day's changes to the journal (opened lazily), or compacts into a new checkpoint when
+   there is none yet, the interval is reached, or the journal outgrew the checkpoint */
+static void journal_end_day(Sim* S, const int* req, const int* srv, const int* waste, int nReceived, const NewPO* created, int nCreated) {
+    Journal* J = S->jnl; if (!J) return;
+    if (!S->stateEpoch || (J->every > 0 && J->days + 1 >= J->every) || (J->ckptBytes > 0 && J->bytes > J->ckptBytes)) {
+        if (!save_state(S, STATE_PATH)) fprintf(stderr, "ERR: cannot write %s\n", STATE_PATH);
+        return;
+    }
+    if (!J->f) {
+        if ((J->f = mm_fopen(JOURNAL_PATH, "ab")) == NULL) { S->stateEpoch = 0; return; }
+        fseek(J->f, 0, SEEK_END); J->bytes = ftell(J->f);
+    }
+    const Catalog* C = &S->cat; int nChanged = 0;
+    for (int i = 0; i < C->n; i++) if (req[i] || waste[i]) nChanged++;
+    size_t payload = sizeof(JournalSku) * (size_t)nChanged + sizeof(NewPO) * (size_t)nCreated, need = sizeof(JournalDayHdr) + payload;
+    if (need > J->cap) {
+        char* nb = (char*)realloc(J->buf, need); if (!nb) { S->stateEpoch = 0; return; }
+        J->buf = nb; J->cap = need;
+    }
+    JournalDayHdr h; h.magic = JNL_DAY_MAGIC; h.bytes = (unsigned)payload; h.day = S->day; h.nextPO = S->nextPO;
+    h.nChanged = nChanged; h.nCreated = nCreated; h.nReceived = nReceived;
+    JournalSku* sku = (JournalSku*)(J->buf + sizeof(h));
+    for (int i = 0, k = 0; i < C->n; i++) if (req[i] || waste[i]) { sku[k].index = i; sku[k].requested = req[i]; sku[k].served = srv[i]; sku[k].waste = waste[i]; k++; }
+    if (nCreated) memcpy(J->buf + sizeof(h) + sizeof(JournalSku) * (size_t)nChanged, created, sizeof(NewPO) * (size_t)nCreated);
+    h.checksum = fnv1a(J->buf + sizeof(h), payload);
+    memcpy(J->buf, &h, sizeof(h));
+    if (fwrite(J->buf, 1, need, J->f) != need || fflush(J->f) != 0) { S->stateEpoch = 0; return; }   /* compact next day */
+    J->bytes += (long long)need; J->days++;
+    STATS_ADD(S, saveBytes, (long long)need); STATS_ADD(S, journalDays, 1);
+}
+static void journal_close(Journal* J) {
+    if (!J) return;
+    if (J->f) fclose(J->f);
+    free(J->buf); free(J);
+}
+
+/* ---------- Inventory CSV loader ---------- */
+static int csv_reserve(CsvRow* R, size_t extra) {
+    if (R->len + extra <= R->cap) return 1;
+    size_t cap = R->cap ? R->cap : 256; while (cap < R->len + extra) cap *= 2;
+    char* nb = (char*)realloc(R->buf, cap); if (!nb) return 0;
+    R->buf = nb; R->cap = cap; return 1;
+}
+/* One RFC-4180 record: ',' separated, fields optionally quoted ("" = literal quote; quoted fields may
+   span lines). Unquoted fields are trimmed. Returns the position after the record; *line counts '\n'. */
+static const char* csv_record(const char* p, const char* end, CsvRow* R, long long* line) {
+    R->len = 0; R->n = 0; R->bad = NULL;
+    for (;;) {
+        size_t start = R->len;
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (p < end && *p == '"') {
+            p++;
+            for (;;) {
+                const char* q = p; while (q < end && *q != '"' && *q != '\n') q++;   /* copy runs, not bytes */
+                if (!csv_reserve(R, (size_t)(q - p) + 2)) { R->bad = "out of memory"; p = end; break; }
+                memcpy(R->buf + R->len, p, (size_t)(q - p)); R->len += (size_t)(q - p); p = q;
+                if (p >= end) { R->bad = "unterminated quoted field"; break; }
+                if (*p == '\n') { (*line)++; R->buf[R->len++] = *p++; continue; }
+                p++;   /* quote */
+                if (p < end && *p == '"') { R->buf[R->len++] = '"'; p++; continue; }
+                break;
+            }
+            while (p < end && (*p == ' ' || *p == '\t')) p++;
+            if (p < end && *p != ',' && *p != '\r' && *p != '\n') { if (!R->bad) R->bad = "text after a closing quote"; while (p < end && *p != ',' && *p != '\n') p++; }
+        }
+        else {
+            const char* b = p; while (p < end && *p != ',' && *p != '\n' && *p != '\r') p++;
+            const char* e = p; while (e > b && (e[-1] == ' ' || e[-1] == '\t')) e--;
+            if (!csv_reserve(R, (size_t)(e - b) + 1)) { R->bad = "out of memory"; p = end; }
+            else { memcpy(R->buf + R->len, b, (size_t)(e - b)); R->len += (size_t)(e - b); }
+        }
+        if (csv_reserve(R, 1)) R->buf[R->len++] = '\0';
+        if (R->n < CSV_MAX_FIELDS) R->off[R->n++] = start; else if (!R->bad) R->bad = "too many fields";
+        if (p < end && *p == ',') { p++; continue; }
+        if (p < end && *p == '\r') p++;
+        if (p < end && *p == '\n') { p++; (*line)++; }
+        break;
+    }
+    for (int k = 0; k < R->n; k++) R->fld[k] = (R->buf && R->off[k] < R->len ? R->buf + R->off[k] : (char*)"");
+    return p;
+}
+/* Optional sign and digits only */
+static int parse_int(const char* s, int* out) {
+    const char* p = s; int neg = 0; long long v = 0;
+    if (*p == '+' || *p == '-') neg = (*p++ == '-');
+    if (*p < '0' || *p > '9') return 0;
+    while (*p >= '0' && *p <= '9') { v = v * 10 + (*p++ - '0'); if (v > 2147483648LL) return 0; }
+    if (*p || (!neg && v > 2147483647LL)) return 0;
+    *out = (int)(neg ? -v : v); return 1;
+}
+/* Plain decimals with up to 15 significant digits and 22 decimals are one exact division (correctly
+   rounded, same as strtod); anything else (exponents, long mantissas) goes to strtod */
+static int parse_double(const char* s, double* out) {
+    static const double p10[23] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char* p = s; int neg = 0, digits = 0, frac = 0, slow = 0; unsigned long long m = 0;
+    if (*p == '+' || *p == '-') neg = (*p++ == '-');
+    for (; *p >= '0' && *p <= '9'; p++, digits++) { if (m < 100000000000000ULL) m = m * 10 + (unsigned)(*p - '0'); else slow = 1; }
+    if (*p == '.') for (p++; *p >= '0' && *p <= '9'; p++, digits++, frac++) { if (m < 100000000000000ULL) m = m * 10 + (unsigned)(*p - '0'); else slow = 1; }
+    if (!digits) return 0;
+    if (*p || slow || frac > 22) {
+        if (*p && *p != 'e' && *p != 'E') return 0;
+        char* e = NULL; double v = strtod(s, &e); if (!e || *e) return 0;
+        *out = v; return 1;
+    }
+    double v = (double)m / p10[frac];
+    *out = neg ? -v : v; return 1;
+}
+/* "a,b,c" or "a|b|c" (spaces allowed) into out[0..max); returns the count, -1 for a bad or negative
+   number or more than max. No strtok: callers may be inside a strtok loop of their own. */
+static int parse_doubles(const char* s, double* out, int max) {
+    int k = 0;
+    for (;;) {
+        char tok[64]; int len = 0;
+        while (isspace((unsigned char)*s)) s++;
+        while (*s && *s != ',' && *s != '|') { if (len < (int)sizeof(tok) - 1) tok[len++] = *s; s++; }
+        while (len > 0 && isspace((unsigned char)tok[len - 1])) len--;
+        tok[len] = '\0';
+        if (!len && !*s && k == 0) return 0;
+        if (k == max || !parse_double(tok, &out[k]) || out[k] < 0.0) return -1;
+        k++;
+        if (!*s++) return k;
+    }
+}
+/* A number, or NAME|NAME|... (case-insensitive) */
+static int parse_flags(const char* s, unsigned int* out) {
+    static const struct { const char* name; unsigned int bit; } names[] = { { "PERISHABLE", PERISHABLE }, { "ON_SALE", ON_SALE }, { "TAX_EXEMPT", TAX_EXEMPT } };
+    int v; if (parse_int(s, &v)) { *out = (unsigned)v; return 1; }
+    unsigned int flags = 0; const char* p = s;
+    while (*p) {
+        const char* e = p; while (*e && *e != '|') e++;
+        const char* a = p, * b = e; while (a < b && isspace((unsigned char)*a)) a++; while (b > a && isspace((unsigned char)b[-1])) b--;
+        int found = (a == b);   /* empty token */
+        for (int k = 0; k < (int)(sizeof(names) / sizeof(names[0])) && !found; k++) {
+            size_t len = strlen(names[k].name); if ((size_t)(b - a) != len) continue;
+            size_t j = 0; while (j < len && toupper((unsigned char)a[j]) == names[k].name[j]) j++;
+            if (j == len) { flags |= names[k].bit; found = 1; }
+        }
+        if (!found) return 0;
+        p = (*e ? e + 1 : e);
+    }
+    *out = flags; return 1;
+}
+static void csv_error(CsvChunk* K, long long line, const char* fmt, const char* detail) {
+    if (K->errors < CSV_MAX_ERRORS) { CsvError* e = &K->err[K->errors]; e->line = line; snprintf(e->msg, sizeof(e->msg), fmt, detail); }
+    K->errors++;
+}
+static void csv_parse_chunk(CsvChunk* K, const int* pcol, int hasPolicy, int shelfCol) {
+    CsvRow R; memset(&R, 0, sizeof(R)); cat_init(&K->cat);
+    const char* p = K->begin; long long line = K->line;
+    while (p < K->end) {
+        long long at = line; p = csv_record(p, K->end, &R, &line);
+        if (R.n == 1 && !R.fld[0][0]) continue;   /* blank line */
+        if (R.bad) { csv_error(K, at, "%s", R.bad); continue; }
+        if (R.n < 5) { csv_error(K, at, "expected id,name,baseCost,price,stock[,flags]%s", ""); continue; }
+        int id, stock; double bc, pr; unsigned int flags = 0;
+        if (!parse_int(R.fld[0], &id))     { csv_error(K, at, "bad id '%.40s'", R.fld[0]); continue; }
+        if (!parse_double(R.fld[2], &bc))  { csv_error(K, at, "bad baseCost '%.40s'", R.fld[2]); continue; }
+        if (!parse_double(R.fld[3], &pr))  { csv_error(K, at, "bad price '%.40s'", R.fld[3]); continue; }
+        if (!parse_int(R.fld[4], &stock))  { csv_error(K, at, "bad stock '%.40s'", R.fld[4]); continue; }
+        if (R.n >= 6 && R.fld[5][0] && !parse_flags(R.fld[5], &flags)) { csv_error(K, at, "bad flags '%.40s'", R.fld[5]); continue; }
+        if (strlen(R.fld[1]) >= NAME_LEN) R.fld[1][NAME_LEN - 1] = '\0';
+        int i = cat_add(&K->cat, id, R.fld[1], bc, pr, stock, flags);
+        if (i < 0) { K->oom = 1; break; }
+        if (hasPolicy && policy_apply_row(&K->cat, i, R.fld, R.n, pcol) < 0) { csv_error(K, at, "unknown policy '%.40s'", R.fld[pcol[PCOL_POLICY]]); K->cat.n--; continue; }
+        if (shelfCol >= 0 && shelfCol < R.n && R.fld[shelfCol][0] && (!parse_int(R.fld[shelfCol], &K->cat.shelfLife[i]) || K->cat.shelfLife[i] < 0)) {
+            csv_error(K, at, "bad shelf_life '%.40s'", R.fld[shelfCol]); K->cat.n--;
+        }
+    }
+    free(R.buf);
+}
+/* pass 0: count quotes and newlines of each raw slice; pass 1: parse each chunk */
+THREAD_FN(csv_worker, arg) {
+    CsvJob* J = (CsvJob*)arg;
+    for (;;) {
+        long c = atomic_next(&J->next); if (c >= J->nChunks) break;
+        CsvChunk* K = &J->ch[c];
+        if (J->pass == 0) {
+            long long q = 0, nl = 0;
+            for (const char* p = K->rawBegin; p < K->rawEnd; p++) { q += (*p == '"'); nl += (*p == '\n'); }
+            K->quotes = q; K->newlines = nl;
+        }
+        else csv_parse_chunk(K, J->pcol, J->hasPolicy, J->shelfCol);
+    }
+    THREAD_RETURN;
+}
+static void csv_run(CsvJob* J, int pass) {
+    J->pass = pass; J->next = 0;
+    int threads = MIN(MIN(cpu_count(), MAX_THREADS), J->nChunks);
+    mm_thread th[MAX_THREADS]; int started = 0;
+    for (int t = 1; t < threads; t++) if (thread_start(&th[started], csv_worker, J)) started++;
+    csv_worker(J);
+    for (int t = 0; t < started; t++) thread_join(th[t]);
+}
+/* Catalog image: the parsed catalog plus the CSV's size/mtime, in the checkpoint section format */
+static int save_catalog_image(const Catalog* C, const char* path, const FileStamp* st) {
+    char tmp[600]; snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    CkptWriter w; CkptHeader h;
+    if (!ckpt_begin(&w, &h, tmp, IMG_MAGIC)) return 0;
+    h.n = C->n;
+    ckpt_section(&w, &h, "source", st, sizeof(FileStamp), 1, sizeof(FileStamp));
+    ckpt_write_catalog(&w, &h, C);
+    return ckpt_finish(&w, &h, tmp, path);
+}
+static int load_catalog_image(Catalog* C, const char* path, const FileStamp* st) {
+    MappedFile m; const CkptHeader* h = ckpt_map(&m, path, IMG_MAGIC);
+    if (!h) return 0;
+    const CkptSection* src = ckpt_find(h, "source"); FileStamp fs; Catalog T;
+    int ok = (src && src->bytes == sizeof(fs));
+    if (ok) { memcpy(&fs, m.p + src->offset, sizeof(fs)); ok = (fs.size == st->size && fs.mtime == st->mtime); }
+    if (ok) ok = (ckpt_find(h, "shelfLife") != NULL);   /* cached before the shelf_life column: parse again */
+    if (ok) ok = ckpt_read_catalog(h, &m, &T);
+    unmap_file(&m);
+    if (!ok) return 0;
+    cat_free(C); *C = T;
+    return 1;
+}
+/* inventory.csv: id,name,baseCost,price,stock[,flags][,policy columns and shelf_life by header name].
+   The file is mapped and split into chunks; a quote-parity pass moves each split to a record start,
+   then chunks are parsed in parallel and appended in file order. Bad rows are reported with their
+   line number and skipped. A clean parse is cached as <path>.bin, used while the CSV is unchanged. */
+static void load_inventory_csv(Sim* S, const char* path) {
+    FileStamp st; char img[512]; snprintf(img, sizeof(img), "%s%s", path, CATALOG_IMAGE_EXT);
+    if (!file_stamp(path, &st)) { demo_inventory(S); return; }   /* silent fallback */
+    if (load_catalog_image(&S->cat, img, &st)) return;
+    MappedFile m; if (!map_file(&m, path)) { demo_inventory(S); return; }
+    const char* p = (const char*)m.p, * end = p + m.size; long long line = 1;
+    if (m.size >= 3 && !memcmp(p, "\xEF\xBB\xBF", 3)) p += 3;
+    CsvRow R; memset(&R, 0, sizeof(R)); int pcol[PCOL_COUNT];
+    p = csv_record(p, end, &R, &line);   /* header */
+    int hasPolicy = policy_columns(R.fld, R.n, pcol), shelfCol = -1;
+    for (int c = 0; c < R.n; c++) if (!strcmp(R.fld[c], "shelf_life")) shelfCol = c;
+    free(R.buf);
+
+    size_t bytes = (size_t)(end - p);
+    int nChunks = (bytes < 2 * CSV_CHUNK_MIN ? 1 : (int)MIN((size_t)cpu_count() * 4, bytes / CSV_CHUNK_MIN));
+    CsvChunk* ch = (CsvChunk*)calloc((size_t)nChunks, sizeof(CsvChunk));
+    if (!ch) { puts("OOM"); unmap_file(&m); return; }
+    for (int c = 0; c < nChunks; c++) { ch[c].rawBegin = p + bytes * c / nChunks; ch[c].rawEnd = p + bytes * (c + 1) / nChunks; }
+    CsvJob J; J.ch = ch; J.nChunks = nChunks; J.pcol = pcol; J.hasPolicy = hasPolicy; J.shelfCol = shelfCol;
+    if (nChunks > 1) csv_run(&J, 0);
+
+    /* chunk c starts after the first newline at or after its split that is outside quotes */
+    long long quotes = 0, lines = line;
+    ch[0].begin = p; ch[0].line = line;
+    for (int c = 1; c < nChunks; c++) {
+        quotes += ch[c - 1].quotes; lines += ch[c - 1].newlines;
+        const char* k = ch[c].rawBegin - 1; int inQ = (int)(quotes & 1) ^ (*k == '"');
+        long long nl = 0;
+        for (; k < end; k++) {
+            if (*k == '"') inQ ^= 1;
+            else if (*k == '\n') { if (k >= ch[c].rawBegin) nl++; if (!inQ) break; }
+        }
+        const char* b = (k < end ? k + 1 : end); if (b < ch[c - 1].begin) b = ch[c - 1].begin;
+        ch[c].begin = ch[c - 1].end = b; ch[c].line = lines + nl;
+    }
+    ch[nChunks - 1].end = end;
+    csv_run(&J, 1);
+
+    Catalog T; cat_init(&T); long long errors = 0; int shown = 0, oom = 0;
+    for (int c = 0; c < nChunks; c++) {
+        if (!oom && (ch[c].oom || !cat_append(&T, &ch[c].cat))) oom = 1;
+        for (int e = 0; e < ch[c].errors && e < CSV_MAX_ERRORS; e++)
+            if (shown++ < CSV_MAX_ERRORS) fprintf(stderr, "ERR: %s:%lld: %s\n", path, ch[c].err[e].line, ch[c].err[e].msg);
+        errors += ch[c].errors; cat_free(&ch[c].cat);
+    }
+    free(ch); unmap_file(&m);
+    if (oom) { puts("OOM"); cat_free(&T); return; }
+    if (errors > shown) fprintf(stderr, "ERR: %s: %lld bad rows skipped\n", path, errors);
+    cat_free(&S->cat); S->cat = T;
+    S->agg.valid = 0; if (S->rank) S->rank->valid = 0;   /* new counters: report indexes rebuild on demand */
+    if (!errors) save_catalog_image(&S->cat, img, &st);
+}
+
+/* ---------- Log query engine ---------- */
+/* sim_log.idx: a header, then segments appended back to back. A segment holds complete days of the log as
+   columns: sale and order rows sorted by (day, productId) with a per-day row directory, daily rows by day.
+   Each query first indexes whatever the log gained since the last one; a log that was reset, shrank or
+   switched format is re-indexed from scratch. Queries map the index and touch only the columns and day
+   ranges they need. */
+static int qrow_cmp(const void* a, const void* b) {
+    const QRow* x = (const QRow*)a, * y = (const QRow*)b;
+    if (x->day != y->day) return x->day < y->day ? -1 : 1;
+    return (x->id > y->id) - (x->id < y->id);
+}
+static int qrows_push(QRows* R, const QRow* r) {
+    if (R->n == R->cap) {
+        long long cap = R->cap ? R->cap * 2 : 4096; QRow* nr = (QRow*)realloc(R->r, sizeof(QRow) * (size_t)cap);
+        if (!nr) return 0;
+        R->r = nr; R->cap = cap;
+    }
+    R->r[R->n++] = *r; return 1;
+}
+static int qdaily_push(QBuild* B, const LogDailyRec* d) {
+    if (B->nDaily == B->capDaily) {
+        long long cap = B->capDaily ? B->capDaily * 2 : 256; LogDailyRec* nd = (LogDailyRec*)realloc(B->daily, sizeof(LogDailyRec) * (size_t)cap);
+        if (!nd) return 0;
+        B->daily = nd; B->capDaily = cap;
+    }
+    B->daily[B->nDaily++] = *d; return 1;
+}
+static void qcol_write(FILE* f, QSegHdr* h, int col, long long* pos, const void* p, size_t bytes) {
+    long long pad = (8 - (*pos & 7)) & 7; static const char zero[8] = { 0 };
+    if (pad) { fwrite(zero, 1, (size_t)pad, f); *pos += pad; }
+    h->off[col] = *pos; if (bytes) fwrite(p, 1, bytes, f); *pos += (long long)bytes;
+}
+/* Writes rows (sorted here) as one segment at the end of f and resets the builder */
+static int qseg_write(FILE* f, QIndexHdr* ih, QBuild* B) {
+    if (!B->nDaily) return 1;
+    qsort(B->sale.r, (size_t)B->sale.n, sizeof(QRow), qrow_cmp); qsort(B->order.r, (size_t)B->order.n, sizeof(QRow), qrow_cmp);
+    qsort(B->daily, (size_t)B->nDaily, sizeof(LogDailyRec), cmp_daily_day);
+    QSegHdr h; memset(&h, 0, sizeof(h)); h.magic = QSEG_MAGIC;
+    h.firstDay = B->daily[0].day; h.lastDay = B->daily[B->nDaily - 1].day;
+    if (B->sale.n) { h.firstDay = MIN(h.firstDay, B->sale.r[0].day); h.lastDay = MAX(h.lastDay, B->sale.r[B->sale.n - 1].day); }
+    if (B->order.n) { h.firstDay = MIN(h.firstDay, B->order.r[0].day); h.lastDay = MAX(h.lastDay, B->order.r[B->order.n - 1].day); }
+    h.nSale = B->sale.n; h.nOrder = B->order.n; h.nDaily = B->nDaily;
+    long long nDays = (long long)h.lastDay - h.firstDay + 1, most = MAX(MAX(h.nSale, h.nOrder), MAX(h.nDaily, nDays + 1));
+    void* tmp = malloc((size_t)most * 8); if (!tmp) return 0;
+    long long start = ih->bytes, pos = sizeof(QSegHdr);
+    mm_fseek(f, start + (long long)sizeof(QSegHdr), SEEK_SET);   /* header last, once the offsets are known */
+    for (int t = 0; t < 2; t++) {
+        const QRows* R = t ? &B->order : &B->sale; long long* ds = (long long*)tmp; long long r = 0;
+        for (long long d = 0; d <= nDays; d++) { while (r < R->n && R->r[r].day < h.firstDay + d) r++; ds[d] = r; }
+        qcol_write(f, &h, t ? QC_O_DAYS : QC_S_DAYS, &pos, ds, sizeof(long long) * (size_t)(nDays + 1));
+        int* col = (int*)tmp; int base = t ? QC_O_ID : QC_S_ID;
+        for (int c = 0; c < 5; c++) {
+            for (long long k = 0; k < R->n; k++) { const QRow* q = &R->r[k]; col[k] = c == 0 ? q->id : c == 1 ? q->a : c == 2 ? q->b : c == 3 ? q->c : q->d; }
+            qcol_write(f, &h, base + c, &pos, col, sizeof(int) * (size_t)R->n);
+        }
+        double* v = (double*)tmp; for (long long k = 0; k < R->n; k++) v[k] = R->r[k].v;
+        qcol_write(f, &h, t ? QC_O_COST : QC_S_PRICE, &pos, v, sizeof(double) * (size_t)R->n);
+    }
+    int* dd = (int*)tmp; for (long long k = 0; k < B->nDaily; k++) dd[k] = B->daily[k].day;
+    qcol_write(f, &h, QC_D_DAY, &pos, dd, sizeof(int) * (size_t)B->nDaily);
+    for (int c = 0; c < 6; c++) {
+        double* v = (double*)tmp;
+        for (long long k = 0; k < B->nDaily; k++) {
+            const LogDailyRec* d = &B->daily[k];
+            v[k] = c == 0 ? d->revenue : c == 1 ? d->cogs : c == 2 ? d->orders : c == 3 ? d->profit : c == 4 ? d->fillRate : (double)d->stockouts;
+        }
+        qcol_write(f, &h, QC_D_REV + c, &pos, v, sizeof(double) * (size_t)B->nDaily);
+    }
+    free(tmp);
+    h.bytes = (pos + 7) & ~7LL; if (h.bytes > pos) { static const char zero[8] = { 0 }; fwrite(zero, 1, (size_t)(h.bytes - pos), f); }
+    mm_fseek(f, start, SEEK_SET); fwrite(&h, sizeof(h), 1, f);
+    if (ferror(f)) return 0;
+    ih->bytes += h.bytes; ih->nSegments++;
+    B->sale.n = B->order.n = B->nDaily = 0;
+    return 1;
+}
+/* Persists consumed offsets after the segment data is on disk, so a crash never indexes a day twice */
+static int qidx_commit(FILE* f, QIndexHdr* ih) {
+    ih->headLen = MIN(ih->consumed[0], (long long)QIDX_HEAD_BYTES); ih->headHash = qidx_head_hash(ih->source == LOG_FMT_BINARY ? LOG_SALE_PATH : LOG_PATH, ih->headLen);
+    fflush(f); file_sync(f);
+    mm_fseek(f, 0, SEEK_SET); fwrite(ih, sizeof(*ih), 1, f); fflush(f);
+    return !ferror(f);
+}
+static int cmp_daily_day(const void* a, const void* b) { int x = ((const LogDailyRec*)a)->day, y = ((const LogDailyRec*)b)->day; return (x > y) - (x < y); }
+/* Fingerprint of the first len bytes of the log: a log that was reset and has grown back past the
+   indexed size still differs here (run header, first day) */
+static unsigned int qidx_head_hash(const char* path, long long len) {
+    MappedFile m; if (len <= 0 || !map_file(&m, path)) return 0;
+    unsigned int h = ((long long)m.size >= len ? fnv1a(m.p, (size_t)len) : 0);
+    unmap_file(&m); return h;
+}
+/* CSV log: rows are committed at each `daily` row (the last row of a day), so a partly written day waits for the next update */
+static int qidx_ingest_csv(FILE* f, QIndexHdr* ih, QBuild* B, const char* path, long long* added) {
+    MappedFile m; if (!map_file(&m, path)) return 0;
+    const char* base = (const char*)m.p, * end = base + m.size, * p = base + ih->consumed[0];
+    CsvRow R; memset(&R, 0, sizeof(R)); long long line = 1, cSale = B->sale.n, cOrder = B->order.n, cDaily = B->nDaily; int ok = 1;   /* committed rows */
+    while (p < end && ok) {
+        const char* rowEnd = csv_record(p, end, &R, &line);
+        if (rowEnd >= end && end[-1] != '\n') break;   /* unterminated last row */
+        p = rowEnd;
+        if (R.bad) continue;
+        QRow q; memset(&q, 0, sizeof(q)); const char* t = R.fld[0];
+        if (!strcmp(t, "sale") && R.n >= 16) {
+            if (!parse_int(R.fld[1], &q.day) || !parse_int(R.fld[5], &q.id)) continue;   /* sale rows carry productId one column right of the header */
+            parse_int(R.fld[10], &q.a); parse_int(R.fld[11], &q.b); parse_int(R.fld[14], &q.c); parse_int(R.fld[15], &q.d); parse_double(R.fld[12], &q.v);
+            ok = qrows_push(&B->sale, &q);
+        }
+        else if (!strcmp(t, "order") && R.n >= 10) {
+            if (!parse_int(R.fld[3], &q.day) || !parse_int(R.fld[4], &q.id)) continue;
+            parse_int(R.fld[6], &q.a); parse_int(R.fld[8], &q.b); parse_int(R.fld[7], &q.c); parse_int(R.fld[2], &q.d); parse_double(R.fld[9], &q.v);
+            ok = qrows_push(&B->order, &q);
+        }
+        else if (!strcmp(t, "daily") && R.n >= 22) {
+            LogDailyRec d; memset(&d, 0, sizeof(d)); double sto = 0;
+            if (!parse_int(R.fld[1], &d.day)) continue;
+            parse_double(R.fld[16], &d.revenue); parse_double(R.fld[17], &d.cogs); parse_double(R.fld[18], &d.orders);
+            parse_double(R.fld[19], &d.profit); parse_double(R.fld[20], &d.fillRate); parse_double(R.fld[21], &sto); d.stockouts = (long long)sto;
+            if (!(ok = qdaily_push(B, &d))) break;
+            *added += (B->sale.n - cSale) + (B->order.n - cOrder) + 1; ih->consumed[0] = (long long)(p - base);
+            if (B->sale.n >= QSEG_ROWS) ok = qseg_write(f, ih, B) && qidx_commit(f, ih);
+            cSale = B->sale.n; cOrder = B->order.n; cDaily = B->nDaily;
+        }
+    }
+    B->sale.n = cSale; B->order.n = cOrder; B->nDaily = cDaily;   /* drop the uncommitted tail */
+    free(R.buf); unmap_file(&m); return ok;
+}
+/* Binary log: the three streams are merged by day like --log-to-csv; a day is committed by its daily record */
+static int qidx_ingest_binary(FILE* f, QIndexHdr* ih, QBuild* B, long long* added) {
+    static const char* paths[3] = { LOG_SALE_PATH, LOG_ORDER_PATH, LOG_DAILY_PATH };
+    static const unsigned int recSize[3] = { sizeof(LogSaleRec), sizeof(LogOrderRec), sizeof(LogDailyRec) };
+    MappedFile m[3]; long long pos[3], cnt[3]; int ok = 1;
+    for (int s = 0; s < 3; s++) {
+        const LogFileHdr* h = NULL; pos[s] = cnt[s] = 0;
+        if (map_file(&m[s], paths[s]) && m[s].size >= sizeof(LogFileHdr)) h = (const LogFileHdr*)m[s].p;
+        if (h && (h->magic != LOG_MAGIC || h->recSize != recSize[s] || h->endian != ENDIAN_TAG)) { fprintf(stderr, "ERR: %s is not a compatible binary log\n", paths[s]); h = NULL; ok = 0; }
+        if (h) { pos[s] = MAX(ih->consumed[s], (long long)sizeof(LogFileHdr)); cnt[s] = (long long)((m[s].size - sizeof(LogFileHdr)) / recSize[s]) * recSize[s] + (long long)sizeof(LogFileHdr); }
+    }
+    while (ok && pos[2] + (long long)sizeof(LogDailyRec) <= cnt[2]) {
+        LogDailyRec d; memcpy(&d, m[2].p + pos[2], sizeof(d));
+        for (; pos[0] + (long long)sizeof(LogSaleRec) <= cnt[0] && ok; pos[0] += sizeof(LogSaleRec)) {
+            LogSaleRec r; memcpy(&r, m[0].p + pos[0], sizeof(r)); if (r.day > d.day) break;
+            QRow q = { r.day, r.productId, r.requested, r.served, r.shortage, r.waste, r.unitPrice }; ok = qrows_push(&B->sale, &q); (*added)++;
+        }
+        for (; pos[1] + (long long)sizeof(LogOrderRec) <= cnt[1] && ok; pos[1] += sizeof(LogOrderRec)) {
+            LogOrderRec r; memcpy(&r, m[1].p + pos[1], sizeof(r)); if (r.dayPlaced > d.day) break;
+            QRow q = { r.dayPlaced, r.productId, r.qty, r.leadTime, r.dueDay, r.poId, r.orderCost }; ok = qrows_push(&B->order, &q); (*added)++;
+        }
+        if (!ok || !(ok = qdaily_push(B, &d))) break;
+        pos[2] += sizeof(LogDailyRec); (*added)++;
+        for (int s = 0; s < 3; s++) ih->consumed[s] = pos[s];
+        if (B->sale.n >= QSEG_ROWS) ok = qseg_write(f, ih, B) && qidx_commit(f, ih);
+    }
+    for (int s = 0; s < 3; s++) unmap_file(&m[s]);
+    return ok;
+}
+/* Brings the index up to date with the log; returns the number of log rows added, -1 on error */
+static long long qidx_update(int source, int rebuild) {
+    const char* head = (source == LOG_FMT_BINARY ? LOG_SALE_PATH : LOG_PATH);   /* consumed[0] is an offset into it */
+    QIndexHdr ih; memset(&ih, 0, sizeof(ih)); FILE* f = NULL;
+    if (!rebuild && (f = mm_fopen(LOG_INDEX_PATH, "r+b")) != NULL) {
+        int ok = (fread(&ih, sizeof(ih), 1, f) == 1 && ih.magic == QIDX_MAGIC && ih.version == QIDX_VERSION && ih.endian == ENDIAN_TAG &&
+                  (int)ih.source == source && qidx_head_hash(head, ih.headLen) == ih.headHash);
+        for (int s = 0; s < (source == LOG_FMT_BINARY ? 3 : 1) && ok; s++) {
+            static const char* paths[3] = { LOG_SALE_PATH, LOG_ORDER_PATH, LOG_DAILY_PATH };
+            FileStamp st; ok = (source == LOG_FMT_BINARY ? file_stamp(paths[s], &st) : file_stamp(LOG_PATH, &st)) && st.size >= ih.consumed[s];
+        }
+        if (!ok) { fclose(f); f = NULL; }
+    }
+    if (!f) {   /* new, reset or foreign: start over */
+        if ((f = mm_fopen(LOG_INDEX_PATH, "w+b")) == NULL) { fprintf(stderr, "ERR: cannot write %s\n", LOG_INDEX_PATH); return -1; }
+        memset(&ih, 0, sizeof(ih)); ih.magic = QIDX_MAGIC; ih.version = QIDX_VERSION; ih.endian = ENDIAN_TAG; ih.source = (unsigned)source;
+        ih.bytes = sizeof(ih);
+        fwrite(&ih, sizeof(ih), 1, f);
+    }
+    QBuild B; memset(&B, 0, sizeof(B)); long long added = 0;
+    int ok = (source == LOG_FMT_BINARY ? qidx_ingest_binary(f, &ih, &B, &added) : qidx_ingest_csv(f, &ih, &B, LOG_PATH, &added));
+    if (ok) ok = qseg_write(f, &ih, &B) && qidx_commit(f, &ih);
+    free(B.sale.r); free(B.order.r); free(B.daily); fclose(f);
+    if (!ok) { fprintf(stderr, "ERR: indexing failed (%s)\n", LOG_INDEX_PATH); remove(LOG_INDEX_PATH); return -1; }
+    return added;
+}
+
+/* Query: metric (record column), aggregate, filters, grouping */
+typedef struct { const char* name; int rec, col; } QMetric;   /* rec: 0 sale, 1 order, 2 daily; col -1 = sale revenue */
+static const QMetric Q_METRICS[] = {
+    { "sale.requested", 0, QC_S_REQ }, { "sale.served", 0, QC_S_SRV }, { "sale.shortage", 0, QC_S_SHORT }, { "sale.waste", 0, QC_S_WASTE },
+    { "sale.price", 0, QC_S_PRICE }, { "sale.revenue", 0, -1 },
+    { "order.qty", 1, QC_O_QTY }, { "order.lead", 1, QC_O_LEAD }, { "order.due", 1, QC_O_DUE }, { "order.cost", 1, QC_O_COST },
+    { "daily.revenue", 2, QC_D_REV }, { "daily.cogs", 2, QC_D_COGS }, { "daily.orders", 2, QC_D_ORD }, { "daily.profit", 2, QC_D_PROFIT },
+    { "daily.fill", 2, QC_D_FILL }, { "daily.stockouts", 2, QC_D_STO } };
+enum { QA_SUM, QA_AVG, QA_MIN, QA_MAX, QA_COUNT, QA_PCT };
+enum { QG_NONE, QG_DAY, QG_PRODUCT };
+typedef struct { double sum, min, max; long long count; } QAcc;
+typedef struct {
+    const QMetric* metric; int agg, by; double pct;
+    int d0, d1;                    /* inclusive day range */
+    const int* ids; int nIds;      /* sorted product filter, NULL = all */
+    IdMap groups; QAcc* acc; int* key; int nGroups, capGroups;
+    double* pairs; long long nVals, capVals;   /* percentiles: (group, value) per matched row */
+    long long rows; int oom;
+} Query;
+static int query_group(Query* Q, int key) {
+    int g = idmap_get(&Q->groups, key); if (g >= 0) return g;
+    if (Q->nGroups == Q->capGroups) {
+        int cap = Q->capGroups ? Q->capGroups * 2 : 64;
+        QAcc* a = (QAcc*)realloc(Q->acc, sizeof(QAcc) * cap); if (!a) return -1; Q->acc = a;
+        int* k = (int*)realloc(Q->key, sizeof(int) * cap); if (!k) return -1; Q->key = k;
+        Q->capGroups = cap;
+    }
+    g = Q->nGroups++; Q->key[g] = key; Q->acc[g].sum = 0; Q->acc[g].count = 0; Q->acc[g].min = HUGE_VAL; Q->acc[g].max = -HUGE_VAL;
+    return idmap_put(&Q->groups, key, g) ? g : -1;
+}
+static void query_add(Query* Q, int day, int id, double v) {
+    int key = Q->by == QG_DAY ? day : Q->by == QG_PRODUCT ? id : 0;
+    int g = (Q->by == QG_NONE ? 0 : query_group(Q, key)); if (g < 0) { Q->oom = 1; return; }
+    QAcc* a = &Q->acc[g]; a->sum += v; a->count++; if (v < a->min) a->min = v; if (v > a->max) a->max = v;
+    Q->rows++;
+    if (Q->agg == QA_PCT) {
+        if (Q->nVals == Q->capVals) {
+            long long cap = Q->capVals ? Q->capVals * 2 : 4096;
+            double* np = (double*)realloc(Q->pairs, sizeof(double) * 2 * (size_t)cap); if (!np) { Q->oom = 1; return; }
+            Q->pairs = np; Q->capVals = cap;
+        }
+        Q->pairs[2 * Q->nVals] = g; Q->pairs[2 * Q->nVals + 1] = v; Q->nVals++;
+    }
+}
+/* First row in [lo,hi) of ids[] that is >= id */
+static long long q_lower(const int* ids, long long lo, long long hi, int id) {
+    while (lo < hi) { long long mid = lo + (hi - lo) / 2; if (ids[mid] < id) lo = mid + 1; else hi = mid; }
+    return lo;
+}
+static void query_segment(Query* Q, const unsigned char* seg) {
+    const QSegHdr* h = (const QSegHdr*)seg; int rec = Q->metric->rec;
+    int d0 = MAX(Q->d0, h->firstDay), d1 = MIN(Q->d1, h->lastDay); if (d0 > d1) return;
+    if (rec == 2) {
+        const int* day = (const int*)(seg + h->off[QC_D_DAY]); const double* v = (const double*)(seg + h->off[Q->metric->col]);
+        for (long long k = q_lower(day, 0, h->nDaily, d0); k < h->nDaily && day[k] <= d1; k++) query_add(Q, day[k], 0, v[k]);
+        return;
+    }
+    const long long* ds = (const long long*)(seg + h->off[rec ? QC_O_DAYS : QC_S_DAYS]);
+    const int* id = (const int*)(seg + h->off[rec ? QC_O_ID : QC_S_ID]);
+    const int* iv = (Q->metric->col >= 0 && Q->metric->col != QC_S_PRICE && Q->metric->col != QC_O_COST) ? (const int*)(seg + h->off[Q->metric->col]) : NULL;
+    const double* dv = (const double*)(seg + h->off[rec ? QC_O_COST : QC_S_PRICE]);
+    const int* served = (const int*)(seg + h->off[QC_S_SRV]);
+    for (int d = d0; d <= d1; d++) {
+        long long a = ds[d - h->firstDay], b = ds[d - h->firstDay + 1];
+        #define Q_VALUE(k) (iv ? (double)iv[k] : Q->metric->col < 0 ? served[k] * dv[k] : dv[k])
+        if (!Q->ids) { for (long long k = a; k < b; k++) query_add(Q, d, id[k], Q_VALUE(k)); continue; }
+        for (int j = 0; j < Q->nIds && a < b; j++) {   /* rows are sorted by id within the day */
+            a = q_lower(id, a, b, Q->ids[j]);
+            for (; a < b && id[a] == Q->ids[j]; a++) query_add(Q, d, id[a], Q_VALUE(a));
+        }
+        #undef Q_VALUE
+    }
+}
+static int cmp_int_asc(const void* a, const void* b) { int x = *(const int*)a, y = *(const int*)b; return (x > y) - (x < y); }
+static int cmp_group_val(const void* a, const void* b) {   /* (group, value) pairs */
+    const double* x = (const double*)a, * y = (const double*)b;
+    if (x[0] != y[0]) return x[0] < y[0] ? -1 : 1;
+    return (x[1] > y[1]) - (x[1] < y[1]);
+}
+/* Usage: --query METRIC [--agg sum|avg|min|max|count|pNN] [--product ID[,ID...]] [--flag PERISHABLE|ON_SALE|TAX_EXEMPT]
+          [--days a:b] [--by none|day|product] [--rebuild]
+   METRIC: sale.{requested,served,shortage,waste,price,revenue} | order.{qty,lead,due,cost} | daily.{revenue,cogs,orders,profit,fill,stockouts} */
+static int headless_query(int argc, char** argv) {
+    Query Q; memset(&Q, 0, sizeof(Q)); Q.d0 = INT_MIN; Q.d1 = INT_MAX;
+    const char* metric = NULL, * productList = NULL, * flagArg = NULL; int rebuild = 0, unused;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i]; const char* v = (i + 1 < argc ? argv[i + 1] : NULL);
+        if (!strcmp(a, "--query") && v) { metric = v; i++; }
+        else if (!strcmp(a, "--agg") && v) {
+            i++;
+            if (!strcmp(v, "sum")) Q.agg = QA_SUM; else if (!strcmp(v, "avg")) Q.agg = QA_AVG; else if (!strcmp(v, "min")) Q.agg = QA_MIN;
+            else if (!strcmp(v, "max")) Q.agg = QA_MAX; else if (!strcmp(v, "count")) Q.agg = QA_COUNT;
+            else if ((v[0] == 'p' || v[0] == 'P') && parse_double(v + 1, &Q.pct) && Q.pct >= 0 && Q.pct <= 100) Q.agg = QA_PCT;
+            else { fprintf(stderr, "ERR: --agg sum|avg|min|max|count|p50|p95|...\n"); return 2; }
+        }
+        else if (!strcmp(a, "--product") && v) { productList = v; i++; }
+        else if (!strcmp(a, "--flag") && v) { flagArg = v; i++; }
+        else if (!strcmp(a, "--days") && v && parse_range(v, &Q.d0, &Q.d1, &unused)) { i++; }
+        else if (!strcmp(a, "--by") && v) { Q.by = !strcmp(v, "day") ? QG_DAY : !strcmp(v, "product") ? QG_PRODUCT : QG_NONE; i++; }
+        else if (!strcmp(a, "--rebuild")) rebuild = 1;
+        else { fprintf(stderr, "ERR: unknown argument %s\n", a); return 2; }
+    }
+    for (int k = 0; metric && k < (int)(sizeof(Q_METRICS) / sizeof(Q_METRICS[0])); k++) if (!strcmp(metric, Q_METRICS[k].name)) Q.metric = &Q_METRICS[k];
+    if (!Q.metric) { fprintf(stderr, "ERR: unknown metric %s\n", metric ? metric : "(none)"); return 2; }
+    if (Q.metric->rec == 2 && (productList || flagArg || Q.by == QG_PRODUCT)) { fprintf(stderr, "ERR: daily metrics have no product\n"); return 2; }
+
+    /* product filter: explicit ids and/or the catalog's products with all the given flags */
+    int* ids = NULL; int nIds = 0, capIds = 0;
+    if (productList) for (const char* p = productList; *p;) {
+        char* e; long id = strtol(p, &e, 10); if (e == p) { fprintf(stderr, "ERR: bad --product list\n"); free(ids); return 2; }
+        if (nIds == capIds) { capIds = capIds ? capIds * 2 : 16; int* ni = (int*)realloc(ids, sizeof(int) * capIds); if (!ni) { free(ids); return 1; } ids = ni; }
+        ids[nIds++] = (int)id; p = (*e == ',' ? e + 1 : e);
+    }
+    if (flagArg) {
+        unsigned int mask = 0; if (!parse_flags(flagArg, &mask)) { fprintf(stderr, "ERR: bad --flag %s\n", flagArg); free(ids); return 2; }
+        Sim cat; sim_init(&cat); load_inventory_csv(&cat, "inventory.csv");
+        int* kept = (int*)malloc(sizeof(int) * (size_t)(cat.cat.n + 1)); int nk = 0;
+        if (!kept) { sim_free(&cat); free(ids); return 1; }
+        if (productList) qsort(ids, nIds, sizeof(int), cmp_int_asc);
+        for (int i = 0; i < cat.cat.n; i++)
+            if ((cat.cat.flags[i] & mask) == mask && (!productList || bsearch(&cat.cat.id[i], ids, nIds, sizeof(int), cmp_int_asc))) kept[nk++] = cat.cat.id[i];
+        free(ids); ids = kept; nIds = nk; sim_free(&cat);
+    }
+    if (ids) {
+        qsort(ids, nIds, sizeof(int), cmp_int_asc);
+        int u = 0; for (int k = 0; k < nIds; k++) if (!u || ids[u - 1] != ids[k]) ids[u++] = ids[k];
+        Q.ids = ids; Q.nIds = nIds = u;
+    }
+
+    RunOptions opt; run_options_defaults(&opt); Config cfg; load_defaults(&cfg);
+    load_config_txt(&cfg, &opt, "config.txt");
+    int source = (opt.logFormat == LOG_FMT_BINARY ? LOG_FMT_BINARY : LOG_FMT_CSV);
+    double t0 = wall_seconds();
+    long long added = qidx_update(source, rebuild);
+    double t1 = wall_seconds();
+    if (added < 0) { free(ids); return 1; }
+
+    MappedFile m; if (!map_file(&m, LOG_INDEX_PATH) || m.size < sizeof(QIndexHdr)) { fprintf(stderr, "ERR: cannot read %s\n", LOG_INDEX_PATH); free(ids); return 1; }
+    const QIndexHdr* ih = (const QIndexHdr*)m.p; long long segs = 0;
+    if (Q.by == QG_NONE) query_group(&Q, 0);
+    for (long long off = sizeof(QIndexHdr); off + (long long)sizeof(QSegHdr) <= ih->bytes && off + (long long)sizeof(QSegHdr) <= (long long)m.size; segs++) {
+        const QSegHdr* h = (const QSegHdr*)(m.p + off);
+        if (h->magic != QSEG_MAGIC || h->bytes <= 0 || off + h->bytes > (long long)m.size) break;
+        query_segment(&Q, m.p + off); off += h->bytes;
+    }
+    /* percentiles: sort (group, value) pairs, then pick per group */
+    double* pv = Q.pairs;
+    if (pv) qsort(pv, (size_t)Q.nVals, 2 * sizeof(double), cmp_group_val);
+    int* order = (int*)malloc(sizeof(int) * 2 * (size_t)(Q.nGroups + 1)); long long* first = (long long*)calloc((size_t)Q.nGroups + 1, sizeof(long long));
+    if (Q.oom || !order || !first) puts("OOM");
+    else {
+        for (int g = 0; g < Q.nGroups; g++) { order[2 * g] = Q.key[g]; order[2 * g + 1] = g; }   /* (key, group), output by key */
+        qsort(order, (size_t)Q.nGroups, 2 * sizeof(int), cmp_int_asc);
+        if (pv) for (long long k = 0, g = -1; k < Q.nVals; k++) if ((int)pv[2 * k] != g) { g = (int)pv[2 * k]; first[g] = k; }
+        static const char* aggNames[] = { "sum", "avg", "min", "max", "count" };
+        char aggName[16]; if (Q.agg == QA_PCT) snprintf(aggName, sizeof(aggName), "p%g", Q.pct); else snprintf(aggName, sizeof(aggName), "%s", aggNames[Q.agg]);
+        if (Q.by != QG_NONE) printf("%s,%s(%s)\n", Q.by == QG_DAY ? "day" : "productId", aggName, Q.metric->name);
+        else printf("%s(%s)\n", aggName, Q.metric->name);
+        for (int o = 0; o < Q.nGroups; o++) {
+            int g = order[2 * o + 1]; const QAcc* a = &Q.acc[g]; double v = 0;
+            if (Q.agg == QA_SUM) v = a->sum; else if (Q.agg == QA_AVG) v = a->count ? a->sum / a->count : 0; else if (Q.agg == QA_MIN) v = a->count ? a->min : 0;
+            else if (Q.agg == QA_MAX) v = a->count ? a->max : 0; else if (Q.agg == QA_COUNT) v = (double)a->count;
+            else if (pv && a->count) {   /* group g's values are sorted at pv[2*first[g] + 1], stride 2 */
+                double pos = Q.pct / 100.0 * (double)(a->count - 1); long long lo = (long long)pos; const double* x = pv + 2 * first[g] + 1;
+                v = (lo >= a->count - 1 ? x[2 * (a->count - 1)] : x[2 * lo] + (pos - (double)lo) * (x[2 * (lo + 1)] - x[2 * lo]));
+            }
+            if (Q.by != QG_NONE) printf("%d,", Q.key[g]);
+            if (Q.agg == QA_COUNT) printf("%lld\n", a->count); else printf("%.4f\n", v);
+        }
+    }
+    double t2 = wall_seconds();
+    fprintf(stderr, "# %lld rows matched in %lld segment(s) | index: +%lld log rows in %.1f ms | query %.1f ms\n",
+        Q.rows, segs, added, (t1 - t0) * 1e3, (t2 - t1) * 1e3);
+    free(order); free(first); free(Q.pairs); free(Q.acc); free(Q.key); idmap_free(&Q.groups); free(ids); unmap_file(&m);
+    return 0;
+}
+
+/* ---------- One day ---------- */
+/* 0 on OOM (the reorder is lost) */
+static int outbox_push(Outbox* B, int item, int qty) {
+    if (B->n == B->cap) {
+        int cap = B->cap ? B->cap * 2 : 256;
+        int* a = (int*)realloc(B->item, sizeof(int) * cap); if (!a) return 0; B->item = a;
+        int* b = (int*)realloc(B->qty, sizeof(int) * cap); if (!b) return 0; B->qty = b;
+        int* c = (int*)realloc(B->granted, sizeof(int) * cap); if (!c) return 0; B->granted = c;
+        B->cap = cap;
+    }
+    B->item[B->n] = item; B->qty[B->n] = qty; B->granted[B->n] = 0; B->n++;
+    return 1;
+}
+
+static void simulate_day(Sim* S, DayTotals* out) {
+    if (out) memset(out, 0, sizeof(*out));   /* callers sum / publish it even when the day cannot run */
+    if (!sim_own(S)) { puts("OOM"); return; }
+#ifdef MM_STATS
+    long long heap0 = sim_heap_allocs(S);
+#endif
+    Catalog* C = &S->cat; int n = C->n;
+
+    /* Scratch before anything changes: out of memory leaves the day unplayed. Every array is fully written before it is read. */
+    Arena* A = &S->scratch; arena_reset(A);
+    int* reqArr = (int*)arena_alloc(A, sizeof(int) * n), * srvArr = (int*)arena_alloc(A, sizeof(int) * n);
+    int* shortArr = (int*)arena_alloc(A, sizeof(int) * n), * wstArr = (int*)arena_alloc(A, sizeof(int) * n), * ordArr = (int*)arena_alloc(A, sizeof(int) * n);
+    double* lamArr = (double*)arena_alloc(A, sizeof(double) * n);
+    NewPO* today = (NewPO*)arena_alloc(A, sizeof(NewPO) * n);
+    if (!reqArr || !srvArr || !shortArr || !wstArr || !ordArr || !lamArr || !today) { puts("OOM"); return; }
+
+    S->day += 1;
+    DayTotals D; memset(&D, 0, sizeof(D));
+    int verbose = S->verbose;
+    STATS_START(S, lap);
+
+    /* Arrivals: a dated lot each for SKUs with a shelf life */
+    if (C->lotDirty) lots_sync(C, S->day);
+    PO* arrivals = pobook_pop_due(&S->pos, C, S->day);
+    int nReceived = 0; for (PO* a = arrivals; a; a = a->next) { C->stock[a->productIndex] += a->qty; lot_receive(C, a->productIndex, a->qty, S->day); nReceived++; }
+    STATS_LAP(S, lap, PH_ARRIVALS);
+    if (verbose && arrivals) {
+        printf("Arrivals: ");
+        for (PO* a = arrivals; a; a = a->next) printf("%s%s +%d (PO#%d)", a == arrivals ? "" : ", ", cat_name(C, a->productIndex), a->qty, a->poId);
+        puts(""); STATS_LAP(S, lap, PH_PRINT);
+    }
+    pobook_release(&S->pos, arrivals);
+
+    /* Demand & sales */
+    double season = demand_refresh(S), lamSum = 0.0; const double* lam0 = C->dmLam;
+    for (int i = 0; i < n; i++) { lamArr[i] = lam0[i] * season; lamSum += lamArr[i]; }
+    sample_poisson_batch(S->rngKey, S->rngFlip, S->day, lamArr, C->dmExp, reqArr, n); S->lambdaSum += lamSum;
+    STATS_ADD(S, draws, n); STATS_LAP(S, lap, PH_DEMAND);
+    sales_kernel(C, reqArr, srvArr, shortArr, &D);
+    STATS_LAP(S, lap, PH_SALES);
+
+    if (verbose) {
+        printf("Demand: ");
+        for (int i = 0; i < n; i++) { if (i) printf(", "); printf("%s=%d", cat_name(C, i), reqArr[i]); }
+        puts("");
+        printf("Sales:  ");
+        for (int i = 0; i < n && i < 4; i++) { if (i) printf(", "); printf("%s=%d", cat_name(C, i), srvArr[i]); }
+        if (n > 4) printf(", ...");
+        printf(" (0 backorders)\n");
+        STATS_LAP(S, lap, PH_PRINT);
+    }
+
+    /* Waste (expired lots, or the undated perishables' daily share), then one log row per product */
+    int anyWaste = 0, anySto = 0, nDraws = 0; Rng rng; const int* life = C->shelfLife;
+    for (int i = 0; i < n; i++) {
+        int waste = 0;
+        if (life[i] > 0) waste = lots_end_day(C, i, srvArr[i], S->day);
+        else if (C->flags[i] & PERISHABLE) {
+            sim_rng(&rng, S, (unsigned)i, RNG_WASTE); nDraws++;
+            waste = waste_units_for_day(&rng, C->stock[i], C->flags[i]); if (waste > C->stock[i]) waste = C->stock[i];
+        }
+        if (waste > 0) { C->stock[i] -= waste; C->wasteUnits[i] += waste; D.wasteUnits += waste; anyWaste = 1; }
+        wstArr[i] = waste; if (shortArr[i] > 0) anySto = 1;
+    }
+    STATS_LAP(S, lap, PH_WASTE);
+    for (int i = 0; i < n; i++) log_sale_row(S, S->day, i, reqArr[i], srvArr[i], shortArr[i], wstArr[i]);
+    STATS_LAP(S, lap, PH_LOG);
+
+    if (verbose) {
+        if (anySto) {
+            printf("Stockout Alerts: "); int first = 1;
+            for (int i = 0; i < n; i++) if (shortArr[i] > 0) { if (!first) printf(", "); printf("%s short by %d units", cat_name(C, i), shortArr[i]); first = 0; }
+            puts("");
+        }
+        else puts("Stockout Alerts: none");
+
+        if (anyWaste) {
+            printf("Waste (Perishables): "); int first = 1;
+            for (int i = 0; i < n; i++) if (wstArr[i] > 0) { if (!first) printf(", "); printf("%s -%d units", cat_name(C, i), wstArr[i]); first = 0; }
+            puts("");
+        }
+        STATS_LAP(S, lap, PH_PRINT);
+    }
+
+    if (forecast_active(S)) { forecast_update(S, reqArr); STATS_LAP(S, lap, PH_FORECAST); }
+
+    /* Reorders: quantities per policy type, then POs in catalog order */
+    reorder_quantities(S, ordArr);
+    int nToday = 0, lost = 0;
+    for (int i = 0; i < n; i++) {
+        if (ordArr[i] > 0 && S->outbox) { lost += !outbox_push(S->outbox, i, ordArr[i]); continue; }   /* shipped by the warehouse */
+        if (ordArr[i] > 0) {
+            sim_rng(&rng, S, (unsigned)i, RNG_LEAD); nDraws++;
+            int lt = rand_int(&rng, S->cfg.leadMin, S->cfg.leadMax), due = S->day + lt;
+            PO* node = po_create(S, i, ordArr[i], due, lt);
+            if (node && !pobook_add(&S->pos, C, S->day, node)) { pobook_release(&S->pos, node); node = NULL; }
+            if (node) {
+                C->ordersCost[i] += S->cfg.orderCostFixed; D.ordersCost += S->cfg.orderCostFixed;
+                log_order_row(S, S->day, node->poId, i, node->qty, node->dueDay, node->leadTime, S->cfg.orderCostFixed);
+                NewPO* t = &today[nToday++];
+                t->poId = node->poId; t->productIndex = i; t->qty = node->qty; t->dueDay = node->dueDay; t->leadTime = lt; t->orderCost = S->cfg.orderCostFixed;
+            }
+        }
+    }
+    if (lost) puts("OOM");
+    STATS_ADD(S, draws, nDraws); STATS_ADD(S, posCreated, nToday); STATS_ADD(S, posReceived, nReceived);
+    STATS_LAP(S, lap, PH_REORDER);
+    if (verbose) {
+        if (nToday > 0) {
+            printf("Reorders: ");
+            for (int k = 0; k < nToday; k++) { if (k) printf(", "); printf("%s - Order quantity: %d, ETA: Day %d", cat_name(C, today[k].productIndex), today[k].qty, today[k].dueDay); }
+            puts("");
+        }
+        else puts("Reorders: none");
+    }
+
+    D.profit = D.revenue - D.cogs - D.ordersCost;
+    if (S->agg.valid) {
+        Aggregates* A = &S->agg;
+        A->revenue += D.revenue; A->cogs += D.cogs; A->ordersCost += D.ordersCost;
+        A->requested += D.requested; A->served += D.served; A->stockouts += D.stockouts; A->wasteUnits += D.wasteUnits;
+    }
+    if (S->rank && S->rank->valid)   /* profit moves with sales and orders, stockouts only with shortages */
+        for (int i = 0; i < n; i++) if (srvArr[i] > 0 || ordArr[i] > 0 || shortArr[i] > 0) rank_update(S->rank, C, i);
+    if (verbose) { printf("KPI: Revenue=%.0f ILS | COGS=%.0f ILS | Orders=%.0f ILS | Profit=%.0f ILS\n", D.revenue, D.cogs, D.ordersCost, D.profit); STATS_LAP(S, lap, PH_PRINT); }
+    log_daily(S, S->day, &D);
+    STATS_LAP(S, lap, PH_LOG);
+
+    /* persist the day: journal record, or a compacted checkpoint */
+    if (!today && S->jnl) S->stateEpoch = 0;   /* created POs unknown: checkpoint instead */
+    journal_end_day(S, reqArr, srvArr, wstArr, nReceived, today, today ? nToday : 0);
+    STATS_LAP(S, lap, PH_PERSIST);
+    STATS_ADD(S, heapAllocs, sim_heap_allocs(S) - heap0);
+    STATS_END_DAY(S);
+    if (out) *out = D;
+}
+
+/* ---------- Report indexes ---------- */
+/* Totals are rebuilt only after a load / reset; simulate_day() then adds each day's DayTotals */
+static void agg_sync(Sim* S) {
+    Aggregates* A = &S->agg; if (A->valid) return;
+    const Catalog* C = &S->cat; memset(A, 0, sizeof(*A));
+    for (int i = 0; i < C->n; i++) {
+        A->revenue += C->revenue[i]; A->cogs += C->cogs[i]; A->ordersCost += C->ordersCost[i];
+        A->requested += C->requested[i]; A->served += C->served[i]; A->stockouts += C->stockouts[i]; A->wasteUnits += C->wasteUnits[i];
+    }
+    A->valid = 1;
+}
+static int rank_above(const RankHeap* H, int a, int b) { return H->key[a] > H->key[b] || (H->key[a] == H->key[b] && a < b); }
+static void rank_place(RankHeap* H, int slot, int i) { H->heap[slot] = i; H->pos[i] = slot; }
+static void rank_sift_up(RankHeap* H, int slot) {
+    int i = H->heap[slot];
+    while (slot > 0) { int up = (slot - 1) / 2; if (!rank_above(H, i, H->heap[up])) break; rank_place(H, slot, H->heap[up]); slot = up; }
+    rank_place(H, slot, i);
+}
+static void rank_sift_down(RankHeap* H, int slot) {
+    int i = H->heap[slot];
+    for (;;) {
+        int c = 2 * slot + 1; if (c >= H->n) break;
+        if (c + 1 < H->n && rank_above(H, H->heap[c + 1], H->heap[c])) c++;
+        if (!rank_above(H, H->heap[c], i)) break;
+        rank_place(H, slot, H->heap[c]); slot = c;
+    }
+    rank_place(H, slot, i);
+}
+static void rank_set(RankHeap* H, int i, double key) {
+    double old = H->key[i]; H->key[i] = key;
+    if (key > old) rank_sift_up(H, H->pos[i]); else if (key < old) rank_sift_down(H, H->pos[i]);
+}
+static int rank_heap_build(RankHeap* H, int n) {
+    free(H->heap); free(H->pos); free(H->key); H->n = 0;
+    H->heap = (int*)malloc(sizeof(int) * (n > 0 ? n : 1)); H->pos = (int*)malloc(sizeof(int) * (n > 0 ? n : 1)); H->key = (double*)malloc(sizeof(double) * (n > 0 ? n : 1));
+    if (!H->heap || !H->pos || !H->key) return 0;
+    H->n = n; for (int i = 0; i < n; i++) H->heap[i] = H->pos[i] = i;
+    return 1;
+}
+static void rank_heapify(RankHeap* H) { for (int slot = H->n / 2 - 1; slot >= 0; slot--) rank_sift_down(H, slot); }
+/* Builds the indexes on first use and after a load / reset: O(n) */
+static int rank_sync(Sim* S) {
+    const Catalog* C = &S->cat;
+    if (!S->rank && (S->rank = (Ranking*)calloc(1, sizeof(Ranking))) == NULL) return 0;
+    Ranking* R = S->rank;
+    if (R->valid && R->profit.n == C->n) return 1;
+    if (!rank_heap_build(&R->profit, C->n) || !rank_heap_build(&R->stockouts, C->n)) { R->valid = 0; return 0; }
+    for (int i = 0; i < C->n; i++) { R->profit.key[i] = C->revenue[i] - C->cogs[i] - C->ordersCost[i]; R->stockouts.key[i] = (double)C->stockouts[i]; }
+    rank_heapify(&R->profit); rank_heapify(&R->stockouts);
+    R->valid = 1; return 1;
+}
+/* Product i's counters changed: O(log n), usually O(1) as keys move little from day to day */
+static void rank_update(Ranking* R, const Catalog* C, int i) {
+    rank_set(&R->profit, i, C->revenue[i] - C->cogs[i] - C->ordersCost[i]);
+    rank_set(&R->stockouts, i, (double)C->stockouts[i]);
+}
+/* The K best products of H (one of R's heaps), best first, into out[]; returns how many. Best-first
+   walk of the heap with a frontier of at most K+1 slots: O(K log K), independent of the catalog size. */
+static int rank_top(Ranking* R, const RankHeap* H, int K, int* out) {
+    if (K > H->n) K = H->n;
+    if (K <= 0) return 0;
+    if (K + 1 > R->frontierCap) {
+        int* nf = (int*)realloc(R->frontier, sizeof(int) * (K + 1)); if (!nf) return 0;
+        R->frontier = nf; R->frontierCap = K + 1;
+    }
+    int* fr = R->frontier;
+    int nf = 0, got = 0; fr[nf++] = 0;
+    while (got < K && nf > 0) {
+        int slot = fr[0]; out[got++] = H->heap[slot];
+        fr[0] = fr[--nf];   /* pop the frontier's best, then push both heap children */
+        for (int j = 0; nf > 0;) {
+            int c = 2 * j + 1; if (c >= nf) break;
+            if (c + 1 < nf && rank_above(H, H->heap[fr[c + 1]], H->heap[fr[c]])) c++;
+            if (!rank_above(H, H->heap[fr[c]], H->heap[fr[j]])) break;
+            int t = fr[c]; fr[c] = fr[j]; fr[j] = t; j = c;
+        }
+        for (int c = 2 * slot + 1; c <= 2 * slot + 2 && c < H->n && nf <= K; c++) {
+            int j = nf++; fr[j] = c;
+            while (j > 0 && rank_above(H, H->heap[fr[j]], H->heap[fr[(j - 1) / 2]])) { int t = fr[j]; fr[j] = fr[(j - 1) / 2]; fr[(j - 1) / 2] = t; j = (j - 1) / 2; }
+        }
+    }
+    return got;
+}
+static void rank_free(Ranking* R) {
+    if (!R) return;
+    free(R->profit.heap); free(R->profit.pos); free(R->profit.key);
+    free(R->stockouts.heap); free(R->stockouts.pos); free(R->stockouts.key);
+    free(R->frontier); free(R);
+}
+
+/* ---------- Reports ---------- */
+static void report_top_products_by_profit(Sim* S) {
+    int K = 5; printf("How many products to show (Top-K)? [default 5]: ");
+    int tmp; if (scanf("%d", &tmp) == 1 && tmp > 0) K = tmp;
+    const Catalog* C = &S->cat; if (K > C->n) K = C->n;
+    int* top = (int*)malloc(sizeof(int) * (K > 0 ? K : 1)); if (!top || !rank_sync(S)) { puts("OOM"); free(top); return; }
+    K = rank_top(S->rank, &S->rank->profit, K, top);
+    puts("\n=== Top products by profit ===");
+    printf("%-3s %-6s %-18s %-6s %-8s %-8s %-8s %-8s\n", "#", "ID", "Name", "Sold", "Revenue", "COGS", "Orders", "Profit");
+    for (int j = 0; j < K; j++) {
+        int i = top[j]; double pr = C->revenue[i] - C->cogs[i] - C->ordersCost[i]; long long sold = C->served[i];
+        printf("%-3d %-6d %-18s %-6lld %-8.0f %-8.0f %-8.0f %-8.0f\n", j + 1, C->id[i], cat_name(C, i), sold,
+            C->revenue[i], C->cogs[i], C->ordersCost[i], pr);
+    }
+    free(top);
+}
+/* "Top stockout products: A 12, B 7, C 3" (products with at least one unit short) */
+static void print_top_stockouts(Sim* S, int K) {
+    const Catalog* C = &S->cat; int top[3], got = 0, printed = 0;
+    if (K > 3) K = 3;
+    if (rank_sync(S)) got = rank_top(S->rank, &S->rank->stockouts, K, top);
+    printf("Top stockout products: ");
+    for (int k = 0; k < got; k++) { int i = top[k]; if (C->stockouts[i] > 0) { if (printed) printf(", "); printf("%s %lld", cat_name(C, i), C->stockouts[i]); printed = 1; } }
+    if (!printed) printf("none");
+    puts("");
+}
+static void report_service_and_stockouts(Sim* S) {
+    agg_sync(S); const Aggregates* A = &S->agg;
+    double fill = (A->requested > 0 ? ((double)A->served / (double)A->requested) : 1.0) * 100.0;
+    puts("\n=== Service level & stockouts ===");
+    printf("Fill rate: %.2f%%\n", fill); printf("Stockouts (units): %lld\n", A->stockouts);
+    print_top_stockouts(S, 3);
+}
+static void report_summary_cumulative(Sim* S) {
+    agg_sync(S); const Aggregates* A = &S->agg;
+    double profit = A->revenue - A->cogs - A->ordersCost; double fill = (A->requested > 0 ? ((double)A->served / (double)A->requested) : 1.0) * 100.0;
+    printf("\n=== Summary (cumulative) - Days 1..%d ===\n", S->day);
+    printf("Revenue: %.0f ILS\nCOGS:    %.0f ILS\nOrders:  %.0f ILS\nPROFIT:  %.0f ILS\n\n", A->revenue, A->cogs, A->ordersCost, profit);
+    printf("Fill rate: %.2f%%\nStockouts (units): %lld\n", fill, A->stockouts);
+    print_top_stockouts(S, 3);
+    if (!S->log) puts("\nLogging is off (log_format=none).");
+    else if (S->log->format == LOG_FMT_BINARY) printf("\nSaved to: %s, %s, %s (convert with --log-to-csv)\n", LOG_SALE_PATH, LOG_ORDER_PATH, LOG_DAILY_PATH);
+    else printf("\nSaved to: %s\n", LOG_PATH);
+}
+static void show_open_pos(Sim* S) {
+    puts("\nOpen Purchase Orders (ETAs)\n---------------------------");
+    if (!S->pos.count) { puts("(none)"); return; }
+    for (PO* n = pobook_next(&S->pos, S->day, NULL); n; n = pobook_next(&S->pos, S->day, n)) {
+        int daysLeft = n->dueDay - S->day; if (daysLeft < 0) daysLeft = 0;
+        printf("PO#%d | %-16s | Order quantity: %d | ETA: Day %d | Days left: %d\n",
+            n->poId, cat_name(&S->cat, n->productIndex), n->qty, n->dueDay, daysLeft);
+    }
+}
+
+/* ---------- Fast-forward ---------- */
+static volatile sig_atomic_t G_cancel;   /* set by Ctrl+C during a fast-forward */
+static void ff_on_sigint(int sig) { (void)sig; G_cancel = 1; signal(SIGINT, ff_on_sigint); }
+/* Runs up to `days` days with no per-day console output or persistence: journal detached, log rows
+   (if writeLog, else dropped) buffered until the end, per-day totals kept in memory. Ctrl+C stops after
+   the current day. Ends with one summary and one checkpoint. Returns the number of days run. */
+static int fast_forward(Sim* S, int days, int writeLog) {
+    DayTotals* daily = (DayTotals*)malloc(sizeof(DayTotals) * (size_t)days);
+    if (!daily) { puts("OOM"); return 0; }
+    int verbose = S->verbose; Journal* jnl = S->jnl; Logger* log = S->log; int flushDays = log ? log->flushDays : 0;
+    S->verbose = 0; S->jnl = NULL;
+    if (!writeLog) S->log = NULL; else if (log) log->flushDays = 0;   /* hand buffers over only when full */
+    G_cancel = 0; void (*prevSig)(int) = signal(SIGINT, ff_on_sigint);
+
+    int first = S->day + 1, done = 0; double t0 = wall_seconds(), next = t0 + 0.2;
+    while (done < days && !G_cancel) {
+        simulate_day(S, &daily[done]); done++;
+        double now = wall_seconds();
+        if (now >= next || done == days) {
+            double rate = done / MAX(now - t0, 1e-9);
+            fprintf(stderr, "\rDay %d/%d  %5.1f%%  %.0f days/s  ETA %.1f s   ", done, days, 100.0 * done / days, rate, (days - done) / rate);
+            fflush(stderr); next = now + 0.2;
+        }
+    }
+    double secs = wall_seconds() - t0;
+    fputc('\n', stderr);
+    signal(SIGINT, prevSig == SIG_ERR ? SIG_DFL : prevSig);
+
+    S->verbose = verbose; S->jnl = jnl; S->log = log;
+    if (log) { log->flushDays = flushDays; log_flush(log); }
+
+    /* Summary from the in-memory per-day totals */
+    DayTotals T; memset(&T, 0, sizeof(T)); int best = 0, worst = 0;
+    for (int d = 0; d < done; d++) {
+        const DayTotals* D = &daily[d];
+        T.revenue += D->revenue; T.cogs += D->cogs; T.ordersCost += D->ordersCost; T.profit += D->profit;
+        T.requested += D->requested; T.served += D->served; T.stockouts += D->stockouts; T.wasteUnits += D->wasteUnits;
+        if (D->profit > daily[best].profit) best = d;
+        if (D->profit < daily[worst].profit) worst = d;
+    }
+    printf("\n=== Fast-forward - Days %d..%d%s ===\n", first, S->day, G_cancel ? " (cancelled)" : "");
+    printf("%d days in %.2f s (%.0f days/s)\n", done, secs, done / MAX(secs, 1e-9));
+    if (done) {
+        double fill = (T.requested > 0 ? ((double)T.served / (double)T.requested) : 1.0) * 100.0;
+        printf("Revenue: %.0f ILS\nCOGS:    %.0f ILS\nOrders:  %.0f ILS\nPROFIT:  %.0f ILS\n", T.revenue, T.cogs, T.ordersCost, T.profit);
+        printf("Fill rate: %.2f%% | Stockouts (units): %lld | Waste (units): %lld\n", fill, T.stockouts, T.wasteUnits);
+        printf("Daily profit: mean %.0f | best %.0f (day %d) | worst %.0f (day %d)\n",
+            T.profit / done, daily[best].profit, first + best, daily[worst].profit, first + worst);
+    }
+    if (!writeLog) puts("Log rows were not written for these days.");
+    if (done && S->jnl) {   /* one checkpoint for the whole run; it also restarts the journal */
+        if (save_state(S, STATE_PATH)) printf("Checkpoint: %s (day %d)\n", STATE_PATH, S->day);
+        else fprintf(stderr, "ERR: cannot write %s\n", STATE_PATH);
+    }
+    free(daily); G_cancel = 0;
+    return done;
+}
+/* Usage: --fast-forward N [--no-log]   (continues the saved simulation, like the menu) */
+static int headless_fast_forward(int argc, char** argv) {
+    int days = 0, writeLog = 1;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i]; const char* v = (i + 1 < argc ? argv[i + 1] : NULL);
+        if (!strcmp(a, "--fast-forward") && v) { days = atoi(v); i++; }
+        else if (!strcmp(a, "--no-log")) writeLog = 0;
+        else { fprintf(stderr, "ERR: unknown argument %s\n", a); return 2; }
+    }
+    if (days <= 0) { fprintf(stderr, "ERR: need --fast-forward N > 0\n"); return 2; }
+    Sim* S = &G_sim; sim_init(S);
+#ifdef MM_STATS
+    S->stats = &G_stats;
+#endif
+    open_session(S);
+    fast_forward(S, days, writeLog);
+    close_single_log(S); journal_close(S->jnl); S->jnl = NULL; sim_free(S);
+    return 0;
+}
+
+/* ---------- Replications (headless Monte Carlo) ---------- */
+static void sim_collect_kpi(const Sim* S, RepKPI* k) {
+    memset(k, 0, sizeof(*k));
+    const Catalog* C = &S->cat;
+    for (int i = 0; i < C->n; i++) {
+        k->revenue += C->revenue[i]; k->cogs += C->cogs[i]; k->ordersCost += C->ordersCost[i];
+        k->requested += C->requested[i]; k->served += C->served[i]; k->stockouts += C->stockouts[i]; k->wasteUnits += C->wasteUnits[i];
+    }
+    k->profit = k->revenue - k->cogs - k->ordersCost;
+    k->fillRate = (k->requested > 0 ? ((double)k->served / (double)k->requested) : 1.0);
+    k->demandMean = S->lambdaSum;
+}
+THREAD_FN(replication_worker, arg) {
+    RepJob* J = (RepJob*)arg; char err[128];
+#ifdef MM_STATS
+    Stats* st = J->stats ? (Stats*)calloc(1, sizeof(Stats)) : NULL;   /* this thread's, merged at the end */
+#endif
+    for (;;) {
+        long r = atomic_next(&J->next); if (r >= J->reps) break;
+        for (int v = 0; v < (J->vs ? 2 : 1); v++) {
+            RepKPI* k = (v ? J->outVs : J->out) + r;
+            Sim s;
+            if (!sim_clone(&s, J->proto)) { memset(k, 0, sizeof(RepKPI)); atomic_add(&J->failed, 1); break; }   /* a zero row would skew every estimate */
+            s.rngKey = rng_key_for(v ? J->vsSeed : J->seed, (unsigned long long)(J->anti ? r / 2 : r)); s.verbose = 0;
+            s.rngFlip = (J->anti && (r & 1) ? ~0u : 0u);
+#ifdef MM_STATS
+            s.stats = st;
+#endif
+            for (int d = 0; d < J->days; d++) {
+                if (v) for (int c = 0; c < J->vs->nChanges; c++)
+                    if (J->vs->at[c] == s.day + 1 || (d == 0 && J->vs->at[c] <= s.day + 1)) scn_apply(&s, &s.cat, J->vs->change[c], err, sizeof(err));
+                simulate_day(&s, NULL);
+            }
+            sim_collect_kpi(&s, k);
+            sim_free(&s);
+        }
+    }
+#ifdef MM_STATS
+    if (st) { mutex_lock(&J->mu); stats_merge(J->stats, st); mutex_unlock(&J->mu); free(st); }
+#endif
+    THREAD_RETURN;
+}
+/* Runs replications [J->first, J->reps) of J->days days from J->proto; out[r] is replication r.
+   Replication r draws from streams keyed by (seed, r) only (r/2 and a mirror flag for antithetic pairs),
+   so results do not depend on the thread count nor on how the replications are split into calls.
+   stats (may be NULL) receives the phase timings of all replications. Returns the threads used, 0 if a
+   replication could not be set up (OOM). */
+static int run_replications(RepJob* J, int threads, Stats* stats) {
+    J->next = J->first;
+#ifdef MM_STATS
+    J->stats = stats; if (J->stats) mutex_init(&J->mu);
+#else
+    (void)stats;
+#endif
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if (threads > J->reps - J->first) threads = MAX(J->reps - J->first, 1);
+    mm_thread th[MAX_THREADS]; int started = 0;
+    for (int t = 1; t < threads; t++) if (thread_start(&th[started], replication_worker, J)) started++;
+    replication_worker(J); /* calling thread works too */
+    for (int t = 0; t < started; t++) thread_join(th[t]);
+#ifdef MM_STATS
+    if (J->stats) mutex_destroy(&J->mu);
+#endif
+    return J->failed ? 0 : started + 1;
+}
+static int cmp_double_asc(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b; return (x > y) - (x < y);
+}
+static double quantile_sorted(const double* v, int n, double q) {
+    if (n <= 0) return 0.0;
+    double pos = q * (n - 1); int lo = (int)pos;
+    if (lo >= n - 1) return v[n - 1];
+    return v[lo] + (pos - lo) * (v[lo + 1] - v[lo]);
+}
+/* Student t critical value for a two-sided 95% interval */
+static double t_crit95(int df) {
+    static const double t[30] = { 12.706,4.303,3.182,2.776,2.571,2.447,2.365,2.306,2.262,2.228,2.201,2.179,2.160,2.145,2.131,
+                                   2.120,2.110,2.101,2.093,2.086,2.080,2.074,2.069,2.064,2.060,2.056,2.052,2.048,2.045,2.042 };
+    if (df <= 0) return 0.0;
+    if (df <= 30) return t[df - 1];
+    return 1.96 + 2.4 / df;
+}
+/* Inverse standard normal CDF (Acklam's rational approximation, relative error < 1.2e-9) */
+static double normal_quantile(double p) {
+    static const double a[6] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+    static const double b[5] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01 };
+    static const double c[6] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+    static const double d[4] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00, 3.754408661907416e+00 };
+    if (p <= 0.0) return -HUGE_VAL;
+    if (p >= 1.0) return HUGE_VAL;
+    if (p < 0.02425 || p > 0.97575) {
+        double q = sqrt(-2.0 * log(p < 0.5 ? p : 1.0 - p));
+        double x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+        return p < 0.5 ? x : -x;
+    }
+    double q = p - 0.5, r = q * q;
+    return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+}
+/* Sorts v in place */
+static void kpi_stats(double* v, int n, KpiStats* st) {
+    memset(st, 0, sizeof(*st)); if (n <= 0) return;
+    double sum = 0; for (int i = 0; i < n; i++) sum += v[i]; st->mean = sum / n;
+    double ss = 0; for (int i = 0; i < n; i++) ss += (v[i] - st->mean) * (v[i] - st->mean);
+    st->sd = (n > 1 ? sqrt(ss / (n - 1)) : 0.0);
+    double half = (n > 1 ? t_crit95(n - 1) * st->sd / sqrt((double)n) : 0.0);
+    st->ciLo = st->mean - half; st->ciHi = st->mean + half;
+    qsort(v, n, sizeof(double), cmp_double_asc);
+    st->p5 = quantile_sorted(v, n, 0.05); st->p50 = quantile_sorted(v, n, 0.50); st->p95 = quantile_sorted(v, n, 0.95);
+}
+static void print_kpi_row(const char* label, const KpiStats* st) {
+    printf("%-18s %12.2f %12.2f %12.2f %12.2f %12.2f %12.2f %12.2f\n", label, st->mean, st->sd, st->ciLo, st->ciHi, st->p5, st->p50, st->p95);
+}
+/* "table" / "json" / "prom"; -1 = unknown */
+static int stats_format(const char* name) {
+    return !strcmp(name, "json") ? STATS_FMT_JSON : (!strcmp(name, "prom") || !strcmp(name, "prometheus")) ? STATS_FMT_PROM : !strcmp(name, "table") ? STATS_FMT_TABLE : -1;
+}
+/* KPI k of a replication: profit, revenue, fill rate (%), stockouts, waste */
+#define REP_KPIS 5
+static const char* REP_KPI_NAMES[REP_KPIS] = { "Profit (ILS)", "Revenue (ILS)", "Fill rate (%)", "Stockouts (units)", "Waste (units)" };
+static double rep_kpi(const RepKPI* r, int k) {
+    return k == 0 ? r->profit : k == 1 ? r->revenue : k == 2 ? 100.0 * r->fillRate : k == 3 ? (double)r->stockouts : (double)r->wasteUnits;
+}
+/* One observation: a replication, or the mean of an antithetic pair */
+static double rep_obs(const double* v, int j, int anti) { return anti ? 0.5 * (v[2 * j] + v[2 * j + 1]) : v[j]; }
+/* Mean of y over n replications with a 95% CI half-width; returns the variance of the estimate.
+   Antithetic pairs count as one observation each. With a control c (known mean 0: demand minus its
+   expectation) the estimate is mean(y) - beta * mean(c), beta the least-squares slope of y on c. */
+static double rep_estimate(const double* y, const double* c, int n, int anti, double* mean, double* half) {
+    int m = (anti ? n / 2 : n); double my = 0, mc = 0, syy = 0, scc = 0, syc = 0;
+    *mean = 0.0; *half = 0.0; if (m <= 0) return 0.0;
+    for (int j = 0; j < m; j++) { my += rep_obs(y, j, anti); if (c) mc += rep_obs(c, j, anti); }
+    my /= m; mc /= m;
+    for (int j = 0; j < m; j++) {
+        double dy = rep_obs(y, j, anti) - my, dc = (c ? rep_obs(c, j, anti) - mc : 0.0);
+        syy += dy * dy; scc += dc * dc; syc += dy * dc;
+    }
+    int p = (c && scc > 0.0 ? 2 : 1); double beta = (p == 2 ? syc / scc : 0.0);
+    *mean = my - beta * mc;
+    if (m <= p) return 0.0;
+    double s2 = MAX(syy - beta * syc, 0.0) / (m - p), var = s2 * (1.0 / m + (p == 2 ? mc * mc / scc : 0.0));
+    *half = t_crit95(m - p) * sqrt(var);
+    return var;
+}
+/* y[r] = KPI k of replication r (of vs - base with a comparison); c[r] = its demand control (NULL = none) */
+static void rep_columns(const RepKPI* out, const RepKPI* outVs, int n, int k, double* y, double* c) {
+    for (int r = 0; r < n; r++) {
+        y[r] = (outVs ? rep_kpi(&outVs[r], k) - rep_kpi(&out[r], k) : rep_kpi(&out[r], k));
+        if (c) c[r] = ((double)out[r].requested - out[r].demandMean) + (outVs ? (double)outVs[r].requested - outVs[r].demandMean : 0.0);
+    }
+}
+#define REPS_BATCH        32        /* --ci-width: the CI is checked after every REPS_BATCH replications */
+#define REPS_ADAPTIVE_MAX 100000    /* --ci-width without --reps */
+/* Usage: --reps N [--days D] [--threads T] [--seed S] [--out file.csv] [--stats table|json|prom]
+          [--antithetic] [--cv] [--vs "name: change, change@day"] [--no-crn] [--ci-width W] [--ci-on profit|fill]
+   --antithetic runs replications in pairs, the second mirroring every uniform of the first; --cv corrects
+   every KPI with total demand as control variate; --vs also runs each replication with the changes (as in
+   --whatif) on the same random numbers (--no-crn: independent ones) and reports the differences;
+   --ci-width stops after the first batch of REPS_BATCH where the 95% CI of profit (fill rate: in points;
+   of the difference with --vs) is at most W wide, at N replications at the latest. */
+static int headless_replicate(int argc, char** argv) {
+    int reps = 0, days = -1, threads = cpu_count(), statsFmt = -1, anti = 0, cv = 0, crn = 1, ciKpi = 0; unsigned long long seed = 0;
+    double ciWidth = 0.0; const char* outPath = REPS_PATH, * vsSpec = NULL; char err[160];
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i]; const char* v = (i + 1 < argc ? argv[i + 1] : NULL);
+        if (!strcmp(a, "--reps") && v) { reps = atoi(v); i++; }
+        else if (!strcmp(a, "--days") && v) { days = atoi(v); i++; }
+        else if (!strcmp(a, "--threads") && v) { threads = atoi(v); i++; }
+        else if (!strcmp(a, "--seed") && v) { seed = strtoull(v, NULL, 10); i++; }
+        else if (!strcmp(a, "--out") && v) { outPath = v; i++; }
+        else if (!strcmp(a, "--stats") && v) { if ((statsFmt = stats_format(v)) < 0) { fprintf(stderr, "ERR: --stats table|json|prom\n"); return 2; } i++; }
+        else if (!strcmp(a, "--antithetic")) anti = 1;
+        else if (!strcmp(a, "--cv")) cv = 1;
+        else if (!strcmp(a, "--vs") && v) { vsSpec = v; i++; }
+        else if (!strcmp(a, "--no-crn")) crn = 0;
+        else if (!strcmp(a, "--ci-width") && v) { ciWidth = atof(v); i++; }
+        else if (!strcmp(a, "--ci-on") && v) {
+            if (!strcmp(v, "profit")) ciKpi = 0; else if (!strcmp(v, "fill")) ciKpi = 2; else { fprintf(stderr, "ERR: --ci-on profit|fill\n"); return 2; }
+            i++;
+        }
+        else { fprintf(stderr, "ERR: unknown argument %s\n", a); return 2; }
+    }
+    if (ciWidth < 0.0) { fprintf(stderr, "ERR: --ci-width must be > 0\n"); return 2; }
+    if (reps <= 0 && ciWidth > 0.0) reps = REPS_ADAPTIVE_MAX;
+    if (reps <= 0) { fprintf(stderr, "ERR: --reps must be > 0\n"); return 2; }
+    if (anti && (reps & 1)) reps++;   /* whole pairs */
+#ifndef MM_STATS
+    if (statsFmt >= 0) { fprintf(stderr, "ERR: --stats needs a build with MINIMARKET_STATS defined\n"); return 2; }
+#endif
+
+    Sim proto; sim_init(&proto);
+    load_config_txt(&proto.cfg, NULL, "config.txt");
+    load_inventory_csv(&proto, "inventory.csv");
+    load_policy_csv(&proto, POLICY_PATH);
+    load_demand_csv(&proto, DEMAND_PATH);
+    if (days <= 0) days = proto.cfg.daysDefault;
+    if (!seed) seed = proto.cfg.seed ? proto.cfg.seed : (unsigned long long)time(NULL);
+    Scenario* vs = NULL;
+    if (vsSpec) {
+        if (!(vs = (Scenario*)calloc(1, sizeof(Scenario)))) { puts("OOM"); sim_free(&proto); return 1; }
+        if (!scn_parse(vs, vsSpec, 1, &proto.cat, err, sizeof(err))) { fprintf(stderr, "ERR: %s\n", err); free(vs); sim_free(&proto); return 2; }
+        if (!strcmp(vs->name, "B1")) snprintf(vs->name, sizeof(vs->name), "vs");
+    }
+
+    RepKPI* out = (RepKPI*)calloc((size_t)reps * (vs ? 2 : 1), sizeof(RepKPI));
+    double* col = (double*)malloc(sizeof(double) * reps * 3), * ctl = col + reps, * tmp = ctl + reps;
+    Stats* stats = (statsFmt >= 0 ? (Stats*)calloc(1, sizeof(Stats)) : NULL);
+    if (!out || !col || (statsFmt >= 0 && !stats)) { puts("OOM"); free(out); free(col); free(stats); free(vs); sim_free(&proto); return 1; }
+    RepKPI* outVs = (vs ? out + reps : NULL);
+
+    /* Fixed batches, so where a run stops depends on the seed only, not on the thread count */
+    RepJob J; memset(&J, 0, sizeof(J));
+    J.proto = &proto; J.days = days; J.anti = anti; J.seed = seed; J.out = out;
+    J.vs = vs; J.outVs = outVs; J.vsSeed = (crn ? seed : seed ^ 0x9E3779B97F4A7C15ULL);
+    clock_t c0 = clock(); double w0 = wall_seconds(); int used = 1, done = 0; double ciMean = 0.0, ciHalf = 0.0;
+    while (done < reps) {
+        J.first = done; J.reps = (ciWidth > 0.0 ? MIN(reps, done + REPS_BATCH) : reps);
+        used = run_replications(&J, threads, stats); done = J.reps;
+        if (!used) { puts("OOM"); free(out); free(col); free(stats); free(vs); sim_free(&proto); return 1; }
+        if (ciWidth > 0.0) {
+            rep_columns(out, outVs, done, ciKpi, col, cv ? ctl : NULL);
+            rep_estimate(col, cv ? ctl : NULL, done, anti, &ciMean, &ciHalf);
+            if (2.0 * ciHalf <= ciWidth) break;
+        }
+    }
+    reps = done;
+    double wall = wall_seconds() - w0, cpu = (double)(clock() - c0) / CLOCKS_PER_SEC;
+
+    FILE* f = NULL;
+    if ((f = mm_fopen(outPath, "w")) != NULL) {
+        fprintf(f, vs ? "rep,run,revenue,cogs,orders,profit,fill_rate,requested,served,stockouts,waste\n" : "rep,revenue,cogs,orders,profit,fill_rate,requested,served,stockouts,waste\n");
+        for (int v = 0; v < (vs ? 2 : 1); v++)
+            for (int r = 0; r < reps; r++) {
+                const RepKPI* k = (v ? outVs : out) + r;
+                fprintf(f, "%d,", r + 1); if (vs) fprintf(f, "%s,", v ? vs->name : "base");
+                fprintf(f, "%.2f,%.2f,%.2f,%.2f,%.4f,%lld,%lld,%lld,%lld\n", k->revenue, k->cogs, k->ordersCost,
+                    k->profit, k->fillRate, k->requested, k->served, k->stockouts, k->wasteUnits);
+            }
+        fclose(f);
+    }
+    else fprintf(stderr, "ERR: cannot open %s\n", outPath);
+
+    char how[96]; snprintf(how, sizeof(how), "%s%s%s", vs ? (crn ? " | common random numbers" : " | independent streams") : "",
+        anti ? " | antithetic" : "", cv ? " | control variate" : "");
+    printf("=== Replications: %d x %d days | products: %d | threads: %d | seed: %llu%s ===\n", reps, days, proto.cat.n, used, seed, how);
+    double gain[REP_KPIS], crnGain[REP_KPIS];
+    if (!vs) {
+        printf("%-18s %12s %12s %12s %12s %12s %12s %12s\n", "KPI", "Mean", "SD", "95% CI lo", "95% CI hi", "P5", "P50", "P95");
+        for (int k = 0; k < REP_KPIS; k++) {
+            KpiStats st; double mean, half;
+            rep_columns(out, NULL, reps, k, col, cv ? ctl : NULL);
+            double var = rep_estimate(col, cv ? ctl : NULL, reps, anti, &mean, &half);
+            memcpy(tmp, col, sizeof(double) * reps); kpi_stats(tmp, reps, &st);   /* SD and percentiles: of single replications */
+            gain[k] = (var > 0.0 ? st.sd * st.sd / reps / var : 0.0);
+            if (anti || cv) { st.mean = mean; st.ciLo = mean - half; st.ciHi = mean + half; }
+            print_kpi_row(REP_KPI_NAMES[k], &st);
+        }
+    }
+    else {
+        printf("%s:", vs->name);
+        for (int c = 0; c < vs->nChanges; c++) { printf("%s %s", c ? "," : "", vs->change[c]); if (vs->at[c] > 1) printf(" (from day %d)", vs->at[c]); }
+        printf("\n%-18s %12s %12s %12s %12s %12s\n", "KPI", "base", vs->name, "Difference", "95% CI lo", "95% CI hi");
+        for (int k = 0; k < REP_KPIS; k++) {
+            double mb, ma, md, hb, ha, hd, sb = 0, sa = 0, sd = 0;
+            rep_columns(out, NULL, reps, k, col, NULL); rep_estimate(col, NULL, reps, anti, &mb, &hb);
+            for (int r = 0; r < reps; r++) sb += (col[r] - mb) * (col[r] - mb);
+            rep_columns(outVs, NULL, reps, k, col, NULL); rep_estimate(col, NULL, reps, anti, &ma, &ha);
+            for (int r = 0; r < reps; r++) sa += (col[r] - ma) * (col[r] - ma);
+            rep_columns(out, outVs, reps, k, col, cv ? ctl : NULL);
+            double var = rep_estimate(col, cv ? ctl : NULL, reps, anti, &md, &hd);
+            double mp = 0; for (int r = 0; r < reps; r++) mp += col[r]; mp /= reps;
+            for (int r = 0; r < reps; r++) sd += (col[r] - mp) * (col[r] - mp);
+            /* plain variance of the mean difference, paired (CRN) vs. what two independent samples would give */
+            double plain = (reps > 1 ? sd / (reps - 1) / reps : 0.0), indep = (reps > 1 ? (sb + sa) / (reps - 1) / reps : 0.0);
+            gain[k] = (var > 0.0 ? plain / var : 0.0); crnGain[k] = (plain > 0.0 ? indep / plain : 0.0);
+            printf("%-18s %12.2f %12.2f %12.2f %12.2f %12.2f\n", REP_KPI_NAMES[k], mb, ma, md, md - hd, md + hd);
+        }
+        if (crn) printf("Common random numbers: variance of the difference x%.1f (profit) / x%.1f (fill rate) lower than with independent runs\n", crnGain[0], crnGain[2]);
+    }
+    if (anti || cv)
+        printf("Variance reduction: x%.1f (profit) / x%.1f (fill rate): the CI of about %.0f plain replications\n", gain[0], gain[2], gain[0] * reps);
+    if (ciWidth > 0.0)
+        printf("%s: %s 95%% CI width %.2f %s %.2f after %d replications\n", 2.0 * ciHalf <= ciWidth ? "Stopped" : "Replication limit reached",
+            REP_KPI_NAMES[ciKpi], 2.0 * ciHalf, 2.0 * ciHalf <= ciWidth ? "<=" : ">", ciWidth, reps);
+    printf("Per-replication KPIs saved to: %s\n", outPath);
+    printf("Elapsed: %.2f s wall, %.2f s CPU\n", wall, cpu);
+#ifdef MM_STATS
+    if (stats) { if (statsFmt != STATS_FMT_TABLE) puts(""); stats_write(stdout, stats, statsFmt); }
+#endif
+
+    free(out); free(col); free(stats); free(vs); sim_free(&proto);
+    return 0;
+}
+
+/* ---------- Policy optimizer ---------- */
+THREAD_FN(optimizer_worker, arg) {
+    OptJob* J = (OptJob*)arg;
+    for (;;) {
+        long w = atomic_next(&J->next); if (w >= (long)J->nCand * J->reps) break;
+        int c = (int)(w / J->reps), r = (int)(w % J->reps), G = J->nGroups;
+        GroupKPI* g = J->out + (size_t)w * G; memset(g, 0, sizeof(GroupKPI) * G);
+        Sim s;
+        if (!sim_clone(&s, J->proto)) { atomic_add(&J->failed, 1); break; }   /* its KPIs would count as zero */
+        const int* cs = J->candS + (size_t)c * G, * cq = J->candQ + (size_t)c * G;
+        for (int i = 0; i < s.cat.n; i++) { s.cat.policy[i] = POL_SQ; s.cat.reorderPoint[i] = cs[J->groupOf[i]]; s.cat.orderQty[i] = cq[J->groupOf[i]]; }
+        s.cat.polDirty = 1;
+        s.rngKey = rng_key_for(J->seed, (unsigned long long)r); s.verbose = 0;   /* same streams for every candidate */
+        for (int d = 0; d < J->days; d++) simulate_day(&s, NULL);
+        for (int i = 0; i < s.cat.n; i++) {
+            GroupKPI* k = &g[J->groupOf[i]];
+            k->profit += s.cat.revenue[i] - s.cat.cogs[i] - s.cat.ordersCost[i]; k->requested += s.cat.requested[i]; k->served += s.cat.served[i];
+        }
+        sim_free(&s);
+    }
+    THREAD_RETURN;
+}
+#define OPT_MEM_BUDGET ((size_t)256 << 20)   /* per-replication results held at once */
+/* Evaluates nCand policies, each over the same `reps` replications (common random numbers: SKUs draw
+   from their own streams, so groups do not interact and one run scores every group at once).
+   mean[c * nGroups + g]: profit averaged over replications, requested/served summed. */
+static int opt_evaluate(const Sim* proto, int days, int reps, int threads, unsigned long long seed, const int* groupOf, int nGroups,
+                        const int* candS, const int* candQ, int nCand, GroupKPI* mean) {
+    size_t perCand = sizeof(GroupKPI) * (size_t)reps * nGroups;
+    int chunk = (int)(OPT_MEM_BUDGET / perCand);
+    if (chunk < 1) chunk = 1;
+    if (chunk > nCand) chunk = nCand;
+    GroupKPI* out = (GroupKPI*)malloc(perCand * chunk); if (!out) return 0;
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    for (int c0 = 0; c0 < nCand; c0 += chunk) {
+        OptJob J; J.proto = proto; J.days = days; J.reps = reps; J.seed = seed; J.groupOf = groupOf; J.nGroups = nGroups;
+        J.nCand = MIN(chunk, nCand - c0); J.candS = candS + (size_t)c0 * nGroups; J.candQ = candQ + (size_t)c0 * nGroups; J.out = out; J.next = 0; J.failed = 0;
+        int T = MIN(threads, J.nCand * reps);
+        mm_thread th[MAX_THREADS]; int started = 0;
+        for (int t = 1; t < T; t++) if (thread_start(&th[started], optimizer_worker, &J)) started++;
+        optimizer_worker(&J);
+        for (int t = 0; t < started; t++) thread_join(th[t]);
+        if (J.failed) { free(out); return 0; }
+        for (int c = 0; c < J.nCand; c++) for (int g = 0; g < nGroups; g++) {
+            GroupKPI m; memset(&m, 0, sizeof(m));
+            for (int r = 0; r < reps; r++) {   /* fixed order: same sums for any thread count */
+                const GroupKPI* k = &out[((size_t)c * reps + r) * nGroups + g]; m.profit += k->profit; m.requested += k->requested; m.served += k->served;
+            }
+            m.profit /= reps; mean[(size_t)(c0 + c) * nGroups + g] = m;
+        }
+    }
+    free(out);
+    return 1;
+}
+static double group_fill(const GroupKPI* k) { return k->requested > 0 ? (double)k->served / (double)k->requested : 1.0; }
+/* Meeting the fill-rate target comes first, then profit (or fill rate while the target is missed) */
+static int opt_better(const GroupKPI* a, const GroupKPI* b, double minFill) {
+    double fa = group_fill(a), fb = group_fill(b); int oka = fa >= minFill, okb = fb >= minFill;
+    if (oka != okb) return oka;
+    if (!oka && fa != fb) return fa > fb;
+    return a->profit > b->profit + 1e-9;
+}
+/* Policy groups: one for all SKUs, one per SKU, or ABC (share of expected revenue: 80/15/5%) x perishable */
+static int opt_groups(const Catalog* C, const char* by, int* groupOf, const char** label) {
+    static const char* classNames[6] = { "A", "A perishable", "B", "B perishable", "C", "C perishable" };
+    if (!strcmp(by, "global")) { for (int i = 0; i < C->n; i++) groupOf[i] = 0; label[0] = "all SKUs"; return 1; }
+    if (!strcmp(by, "sku")) { for (int i = 0; i < C->n; i++) { groupOf[i] = i; label[i] = cat_name(C, i); } return C->n; }
+    double* rev = (double*)malloc(sizeof(double) * (C->n + 1)); int* order = (int*)malloc(sizeof(int) * (C->n + 1));
+    if (!rev || !order) { free(rev); free(order); return 0; }
+    double total = 0;
+    for (int i = 0; i < C->n; i++) { rev[i] = demand_lambda_for(C, i) * C->price[i]; total += rev[i]; order[i] = i; }
+    for (int i = 1; i < C->n; i++) {   /* insertion sort by expected revenue, descending; ties keep catalog order */
+        int k = order[i], j = i - 1;
+        while (j >= 0 && rev[order[j]] < rev[k]) { order[j + 1] = order[j]; j--; }
+        order[j + 1] = k;
+    }
+    double cum = 0;
+    for (int r = 0; r < C->n; r++) {
+        int i = order[r]; int abc = (cum < 0.80 * total ? 0 : cum < 0.95 * total ? 1 : 2); cum += rev[i];
+        groupOf[i] = abc * 2 + ((C->flags[i] & PERISHABLE) ? 1 : 0);
+    }
+    for (int g = 0; g < 6; g++) label[g] = classNames[g];
+    free(rev); free(order);
+    return 6;
+}
+static int parse_range(const char* v, int* lo, int* hi, int* step) {
+    int a = 0, b = 0, c = 1; int k = sscanf(v, "%d:%d:%d", &a, &b, &c);
+    if (k < 2 || c <= 0 || b < a) return 0;
+    *lo = a; *hi = b; *step = c; return 1;
+}
+typedef struct { double profit, fill; int s, q; const char* kind; int pareto; } OptPoint;
+/* Usage: --optimize [--by global|class|sku] [--reps N] [--days D] [--threads T] [--seed S]
+          [--s-grid lo:hi:step] [--q-grid lo:hi:step] [--min-fill PCT] [--iters N] [--out file.csv] [--policy-out file.csv] */
+static int headless_optimize(int argc, char** argv) {
+    int reps = 16, days = -1, threads = cpu_count(), iters = 30;
+    int sLo = 0, sHi = 60, sStep = 5, qLo = 10, qHi = 120, qStep = 10;
+    unsigned long long seed = 0; double minFill = 0.0;
+    const char* by = "class", * outPath = OPT_PATH, * policyPath = POLICY_PATH;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i]; const char* v = (i + 1 < argc ? argv[i + 1] : NULL);
+        if (!strcmp(a, "--optimize")) {}
+        else if (!strcmp(a, "--by") && v) { by = v; i++; }
+        else if (!strcmp(a, "--reps") && v) { reps = atoi(v); i++; }
+        else if (!strcmp(a, "--days") && v) { days = atoi(v); i++; }
+        else if (!strcmp(a, "--threads") && v) { threads = atoi(v); i++; }
+        else if (!strcmp(a, "--seed") && v) { seed = strtoull(v, NULL, 10); i++; }
+        else if (!strcmp(a, "--iters") && v) { iters = atoi(v); i++; }
+        else if (!strcmp(a, "--min-fill") && v) { minFill = atof(v) / 100.0; i++; }
+        else if (!strcmp(a, "--s-grid") && v && parse_range(v, &sLo, &sHi, &sStep)) { i++; }
+        else if (!strcmp(a, "--q-grid") && v && parse_range(v, &qLo, &qHi, &qStep)) { i++; }
+        else if (!strcmp(a, "--out") && v) { outPath = v; i++; }
+        else if (!strcmp(a, "--policy-out") && v) { policyPath = v; i++; }
+        else { fprintf(stderr, "ERR: bad argument %s\n", a); return 2; }
+    }
+    if (strcmp(by, "global") && strcmp(by, "class") && strcmp(by, "sku")) { fprintf(stderr, "ERR: --by must be global, class or sku\n"); return 2; }
+    if (reps <= 0) { fprintf(stderr, "ERR: --reps must be > 0\n"); return 2; }
+    if (qLo < 1) qLo = 1;
+    if (sLo < 0) sLo = 0;
+
+    Sim proto; sim_init(&proto);
+    load_config_txt(&proto.cfg, NULL, "config.txt");
+    load_inventory_csv(&proto, "inventory.csv");
+    load_demand_csv(&proto, DEMAND_PATH);
+    if (days <= 0) days = proto.cfg.daysDefault;
+    if (!seed) seed = proto.cfg.seed ? proto.cfg.seed : (unsigned long long)time(NULL);
+    const Catalog* C = &proto.cat; int n = C->n;
+
+    int ns = (sHi - sLo) / sStep + 1, nq = (qHi - qLo) / qStep + 1, nGrid = ns * nq;
+    int* groupOf = (int*)malloc(sizeof(int) * (n + 1)); const char** label = (const char**)malloc(sizeof(char*) * (n + 6));
+    int G = (groupOf && label ? opt_groups(C, by, groupOf, label) : 0);
+    int nCandMax = MAX(nGrid, 4);
+    int* candS = (int*)malloc(sizeof(int) * (size_t)nCandMax * G), * candQ = (int*)malloc(sizeof(int) * (size_t)nCandMax * G);
+    GroupKPI* grid = (GroupKPI*)malloc(sizeof(GroupKPI) * (size_t)nGrid * G), * step = (GroupKPI*)malloc(sizeof(GroupKPI) * 4 * (size_t)G);
+    int* curS = (int*)malloc(sizeof(int) * G), * curQ = (int*)malloc(sizeof(int) * G); GroupKPI* cur = (GroupKPI*)malloc(sizeof(GroupKPI) * G);
+    int* ds = (int*)malloc(sizeof(int) * G), * dq = (int*)malloc(sizeof(int) * G);
+    OptPoint* pts = (OptPoint*)malloc(sizeof(OptPoint) * (nGrid + 16));
+    int ok = (G > 0 && candS && candQ && grid && step && curS && curQ && cur && ds && dq && pts);
+    long long evaluated = 0; int nPts = 0, rounds = 0;
+    clock_t c0 = clock(); double w0 = wall_seconds();
+
+    /* 1) grid: every group gets the same (s,Q) per candidate */
+    if (ok) {
+        for (int k = 0; k < nGrid; k++) for (int g = 0; g < G; g++) {
+            candS[(size_t)k * G + g] = sLo + (k / nq) * sStep; candQ[(size_t)k * G + g] = qLo + (k % nq) * qStep;
+        }
+        ok = opt_evaluate(&proto, days, reps, threads, seed, groupOf, G, candS, candQ, nGrid, grid);
+        evaluated += (long long)nGrid * G;
+    }
+    if (ok) {
+        for (int g = 0; g < G; g++) {
+            int best = 0; for (int k = 1; k < nGrid; k++) if (opt_better(&grid[(size_t)k * G + g], &grid[(size_t)best * G + g], minFill)) best = k;
+            curS[g] = sLo + (best / nq) * sStep; curQ[g] = qLo + (best % nq) * qStep; cur[g] = grid[(size_t)best * G + g];
+        }
+        for (int k = 0; k < nGrid; k++) {
+            GroupKPI t; memset(&t, 0, sizeof(t));
+            for (int g = 0; g < G; g++) { const GroupKPI* x = &grid[(size_t)k * G + g]; t.profit += x->profit; t.requested += x->requested; t.served += x->served; }
+            OptPoint p = { t.profit, group_fill(&t), sLo + (k / nq) * sStep, qLo + (k % nq) * qStep, "grid", 0 }; pts[nPts++] = p;
+        }
+        /* per-group picks from the grid for a range of fill-rate targets */
+        static const double targets[] = { 0.80, 0.90, 0.95, 0.97, 0.98, 0.99, 0.995 };
+        for (int t = 0; t < (int)(sizeof(targets) / sizeof(targets[0])) && G > 1; t++) {
+            GroupKPI tot; memset(&tot, 0, sizeof(tot));
+            for (int g = 0; g < G; g++) {
+                int best = 0; for (int k = 1; k < nGrid; k++) if (opt_better(&grid[(size_t)k * G + g], &grid[(size_t)best * G + g], targets[t])) best = k;
+                const GroupKPI* x = &grid[(size_t)best * G + g]; tot.profit += x->profit; tot.requested += x->requested; tot.served += x->served;
+            }
+            OptPoint p = { tot.profit, group_fill(&tot), -1, -1, "grid per group", 0 };
+            if (pts[nPts - 1].s >= 0 || pts[nPts - 1].profit != p.profit || pts[nPts - 1].fill != p.fill) pts[nPts++] = p;
+        }
+    }
+    /* 2) local pattern search: each round moves every group one step in each direction and keeps the best
+       improvement; a group's steps double after a move (so it can leave the grid) and halve when stuck */
+    if (ok) for (int g = 0; g < G; g++) { ds[g] = sStep; dq[g] = qStep; }
+    for (rounds = 0; ok && rounds < iters; rounds++) {
+        static const int dirS[4] = { 1, -1, 0, 0 }, dirQ[4] = { 0, 0, 1, -1 };
+        int active = 0;
+        for (int g = 0; g < G; g++) if (ds[g] > 0) active++;
+        if (!active) break;
+        for (int d = 0; d < 4; d++) for (int g = 0; g < G; g++) {
+            int a = ds[g] > 0;   /* converged groups just repeat their policy */
+            candS[(size_t)d * G + g] = MAX(0, curS[g] + (a ? dirS[d] * ds[g] : 0)); candQ[(size_t)d * G + g] = MAX(1, curQ[g] + (a ? dirQ[d] * dq[g] : 0));
+        }
+        if (!(ok = opt_evaluate(&proto, days, reps, threads, seed, groupOf, G, candS, candQ, 4, step))) break;
+        evaluated += 4LL * G;
+        for (int g = 0; g < G; g++) {
+            if (ds[g] <= 0) continue;
+            int best = -1;
+            for (int d = 0; d < 4; d++) if (opt_better(&step[(size_t)d * G + g], best < 0 ? &cur[g] : &step[(size_t)best * G + g], minFill)) best = d;
+            if (best >= 0) {
+                curS[g] = candS[(size_t)best * G + g]; curQ[g] = candQ[(size_t)best * G + g]; cur[g] = step[(size_t)best * G + g];
+                if (best < 2) ds[g] *= 2; else dq[g] *= 2;
+            }
+            else if (ds[g] == 1 && dq[g] == 1) ds[g] = 0;   /* converged */
+            else { ds[g] = MAX(1, ds[g] / 2); dq[g] = MAX(1, dq[g] / 2); }
+        }
+    }
+    /* 3) result, re-scored on fresh replications (the search itself favours lucky draws) */
+    GroupKPI fin, val; memset(&fin, 0, sizeof(fin)); memset(&val, 0, sizeof(val));
+    if (ok) {
+        for (int g = 0; g < G; g++) { fin.profit += cur[g].profit; fin.requested += cur[g].requested; fin.served += cur[g].served; }
+        OptPoint p = { fin.profit, group_fill(&fin), -1, -1, "optimized", 0 }; pts[nPts++] = p;
+        unsigned long long vs = seed; unsigned long long valSeed = splitmix64(&vs);
+        if (opt_evaluate(&proto, days, reps, threads, valSeed, groupOf, G, curS, curQ, 1, step))
+            for (int g = 0; g < G; g++) { val.profit += step[g].profit; val.requested += step[g].requested; val.served += step[g].served; }
+    }
+    double wall = wall_seconds() - w0, cpu = (double)(clock() - c0) / CLOCKS_PER_SEC;
+    if (!ok) { puts("OOM"); }
+    else {
+        for (int a = 0; a < nPts; a++) {
+            pts[a].pareto = 1;
+            for (int b = 0; b < nPts && pts[a].pareto; b++)
+                if (pts[b].profit >= pts[a].profit && pts[b].fill >= pts[a].fill && (pts[b].profit > pts[a].profit || pts[b].fill > pts[a].fill)) pts[a].pareto = 0;
+        }
+        FILE* f = NULL;
+        if ((f = mm_fopen(outPath, "w")) != NULL) {
+            fprintf(f, "kind,s,q,profit,fill_rate,pareto\n");
+            for (int a = 0; a < nPts; a++) {
+                if (pts[a].s >= 0) fprintf(f, "%s,%d,%d,%.2f,%.4f,%d\n", pts[a].kind, pts[a].s, pts[a].q, pts[a].profit, pts[a].fill, pts[a].pareto);
+                else fprintf(f, "%s,,,%.2f,%.4f,%d\n", pts[a].kind, pts[a].profit, pts[a].fill, pts[a].pareto);
+            }
+            fclose(f);
+        }
+        else fprintf(stderr, "ERR: cannot open %s\n", outPath);
+        if ((f = mm_fopen(policyPath, "w")) != NULL) {
+            fprintf(f, "id,name,policy,reorder_point,order_qty\n");
+            for (int i = 0; i < n; i++) fprintf(f, "%d,%s,%s,%d,%d\n", C->id[i], cat_name(C, i), POLICY_NAMES[POL_SQ], curS[groupOf[i]], curQ[groupOf[i]]);
+            fclose(f);
+        }
+        else fprintf(stderr, "ERR: cannot open %s\n", policyPath);
+
+        printf("=== (s,Q) optimizer: by %s | %d groups | %d x %d days | products: %d | seed: %llu ===\n", by, G, reps, days, n, seed);
+        printf("Grid s=%d..%d step %d, Q=%d..%d step %d | local search rounds: %d | group-policies evaluated: %lld\n",
+            sLo, sHi, sStep, qLo, qHi, qStep, rounds, evaluated);
+        printf("%-24s %6s %6s %12s %10s\n", "Group", "s", "Q", "Profit", "Fill %");
+        int shown = 0;
+        for (int g = 0; g < G; g++) {
+            if (cur[g].requested == 0 && cur[g].profit == 0.0) continue;   /* empty class */
+            if (shown++ == 20) { printf("... (%d groups, see %s)\n", G, policyPath); break; }
+            printf("%-24.24s %6d %6d %12.2f %10.2f\n", label[g], curS[g], curQ[g], cur[g].profit, group_fill(&cur[g]) * 100.0);
+        }
+        printf("Total: profit %.2f ILS, fill rate %.2f%% (fresh replications: %.2f ILS, %.2f%%)\n",
+            fin.profit, group_fill(&fin) * 100.0, val.profit, group_fill(&val) * 100.0);
+        puts("Pareto frontier (profit vs fill rate):");
+        printf("%10s %12s  %s\n", "Fill %", "Profit", "Policy");
+        for (int pass = 0; pass < nPts; pass++) {   /* print by increasing fill rate */
+            int pick = -1;
+            for (int a = 0; a < nPts; a++) if (pts[a].pareto == 1 && (pick < 0 || pts[a].fill < pts[pick].fill)) pick = a;
+            if (pick < 0) break;
+            if (pts[pick].s >= 0) printf("%10.2f %12.2f  s=%d Q=%d\n", pts[pick].fill * 100.0, pts[pick].profit, pts[pick].s, pts[pick].q);
+            else printf("%10.2f %12.2f  %s\n", pts[pick].fill * 100.0, pts[pick].profit, pts[pick].kind);
+            pts[pick].pareto = 2;
+        }
+        printf("Candidates saved to: %s | policy saved to: %s\n", outPath, policyPath);
+        printf("Elapsed: %.2f s wall, %.2f s CPU\n", wall, cpu);
+    }
+    free(groupOf); free(label); free(candS); free(candQ); free(grid); free(step); free(curS); free(curQ); free(cur); free(ds); free(dq); free(pts);
+    sim_free(&proto);
+    return ok ? 0 : 1;
+}
+
+/* ---------- Work-stealing pool ---------- */
+/* Next task for worker id: its own range from the front, else half of the fullest other range */
+static int pool_take(Pool* P, int id, int* task) {
+    PoolRange* own = &P->range[id];
+    for (;;) {
+        mutex_lock(&own->mu);
+        if (own->lo < own->hi) { *task = own->lo++; mutex_unlock(&own->mu); return 1; }
+        mutex_unlock(&own->mu);
+        int victim = -1, most = 0;
+        for (int k = 1; k < P->threads; k++) {   /* the owner moves lo concurrently: peek under its lock, re-checked below */
+            int v = (id + k) % P->threads;
+            mutex_lock(&P->range[v].mu);
+            int left = P->range[v].hi - P->range[v].lo;
+            mutex_unlock(&P->range[v].mu);
+            if (left > most) { most = left; victim = v; }
+        }
+        if (victim < 0) return 0;
+        PoolRange* r = &P->range[victim]; int lo = 0, hi = 0;
+        mutex_lock(&r->mu);
+        if (r->lo < r->hi) { int k = (r->hi - r->lo + 1) / 2; hi = r->hi; lo = r->hi = hi - k; }
+        mutex_unlock(&r->mu);
+        if (lo < hi) { mutex_lock(&own->mu); own->lo = lo; own->hi = hi; mutex_unlock(&own->mu); }
+    }
+}
+static void pool_work(Pool* P, int id) { int t; while (pool_take(P, id, &t)) P->fn(P->ctx, t); }
+THREAD_FN(pool_thread, arg) {
+    PoolWorker* w = (PoolWorker*)arg; Pool* P = w->pool; long seen = 0;
+    for (;;) {
+        mutex_lock(&P->mu);
+        while (P->gen == seen && !P->stop) cond_wait(&P->cvStart, &P->mu);
+        if (P->stop) { mutex_unlock(&P->mu); break; }
+        seen = P->gen; mutex_unlock(&P->mu);
+        pool_work(P, w->id);
+        mutex_lock(&P->mu); if (--P->busy == 0) cond_signal(&P->cvDone); mutex_unlock(&P->mu);
+    }
+    THREAD_RETURN;
+}
+/* Starts threads-1 workers (the caller of pool_run is worker 0); returns the worker count */
+static int pool_start(Pool* P, int threads) {
+    memset(P, 0, sizeof(*P));
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if ((P->range = (PoolRange*)calloc(threads, sizeof(PoolRange))) == NULL) return 0;
+    mutex_init(&P->mu); cond_init(&P->cvStart); cond_init(&P->cvDone);
+    for (int t = 0; t < threads; t++) mutex_init(&P->range[t].mu);
+    P->threads = 1;
+    for (int t = 1; t < threads; t++) {
+        P->w[t].pool = P; P->w[t].id = t;
+        if (!thread_start(&P->th[t], pool_thread, &P->w[t])) break;
+        P->threads++;
+    }
+    return P->threads;
+}
+/* Runs fn(ctx, t) for every t in [0,n) and returns when all are done */
+static void pool_run(Pool* P, int n, PoolFn fn, void* ctx) {
+    int T = P->threads;
+    for (int t = 0; t < T; t++) { P->range[t].lo = (int)((long long)n * t / T); P->range[t].hi = (int)((long long)n * (t + 1) / T); }
+    P->fn = fn; P->ctx = ctx;
+    mutex_lock(&P->mu); P->busy = T - 1; P->gen++; cond_broadcast(&P->cvStart); mutex_unlock(&P->mu);
+    pool_work(P, 0);
+    mutex_lock(&P->mu); while (P->busy > 0) cond_wait(&P->cvDone, &P->mu); mutex_unlock(&P->mu);
+}
+static void pool_stop(Pool* P) {
+    mutex_lock(&P->mu); P->stop = 1; cond_broadcast(&P->cvStart); mutex_unlock(&P->mu);
+    for (int t = 1; t < P->threads; t++) thread_join(P->th[t]);
+    for (int t = 0; t < P->threads; t++) mutex_destroy(&P->range[t].mu);
+    mutex_destroy(&P->mu); cond_destroy(&P->cvStart); cond_destroy(&P->cvDone);
+    free(P->range); P->range = NULL;
+}
+
+/* ---------- Multi-echelon network ---------- */
+/* Phase 1: one store-day; reorders collect in the store's outbox */
+static void net_store_day(void* ctx, int s) {
+    Network* N = (Network*)ctx; N->box[s].n = 0; simulate_day(&N->store[s], NULL);
+}
+/* Phase 2: warehouse w receives its supplier POs, allocates stock to its stores' requests, then reorders.
+   Requests are read in store order and short items are shared pro rata (floor, leftover units to the
+   lowest store numbers), so the result does not depend on the thread schedule. */
+static void net_warehouse_day(void* ctx, int w) {
+    Network* N = (Network*)ctx; Sim* W = &N->wh[w]; Catalog* C = &W->cat; int n = C->n;
+    long long* need = N->need[w]; int* left = N->left[w];
+    W->day = N->day;
+    PO* arrivals = pobook_pop_due(&W->pos, C, W->day);
+    for (PO* a = arrivals; a; a = a->next) C->stock[a->productIndex] += a->qty;
+    pobook_release(&W->pos, arrivals);
+
+    for (int s = w; s < N->nStores; s += N->nWh) { const Outbox* B = &N->box[s]; for (int k = 0; k < B->n; k++) need[B->item[k]] += B->qty[k]; }
+    int anyShort = 0;
+    for (int s = w; s < N->nStores; s += N->nWh) {
+        Outbox* B = &N->box[s];
+        for (int k = 0; k < B->n; k++) {
+            int i = B->item[k]; long long avail = C->stock[i];
+            B->granted[k] = (need[i] <= avail ? B->qty[k] : (int)(avail * B->qty[k] / need[i]));
+            if (need[i] > avail) anyShort = 1;
+        }
+    }
+    for (int i = 0; i < n; i++) {   /* short items: the whole stock is shared, the rest is a warehouse stockout */
+        left[i] = 0; if (need[i] <= C->stock[i]) continue;
+        left[i] = C->stock[i]; C->stockouts[i] += need[i] - C->stock[i];
+    }
+    if (anyShort) {
+        for (int s = w; s < N->nStores; s += N->nWh) { const Outbox* B = &N->box[s]; for (int k = 0; k < B->n; k++) if (need[B->item[k]] > C->stock[B->item[k]]) left[B->item[k]] -= B->granted[k]; }
+        for (int s = w; s < N->nStores; s += N->nWh) {
+            Outbox* B = &N->box[s];
+            for (int k = 0; k < B->n; k++) { int i = B->item[k]; if (left[i] > 0 && B->granted[k] < B->qty[k]) { B->granted[k]++; left[i]--; } }
+        }
+    }
+    for (int s = w; s < N->nStores; s += N->nWh) {
+        const Outbox* B = &N->box[s];
+        for (int k = 0; k < B->n; k++) { int i = B->item[k]; C->stock[i] -= B->granted[k]; C->served[i] += B->granted[k]; }
+    }
+    for (int i = 0; i < n; i++) if (need[i]) { C->requested[i] += need[i]; need[i] = 0; }
+
+    /* own replenishment from the (unlimited) supplier */
+    int* qty = left; reorder_quantities(W, qty); Rng rng;
+    for (int i = 0; i < n; i++) {
+        if (qty[i] <= 0) continue;
+        sim_rng(&rng, W, (unsigned)i, RNG_LEAD);
+        int lt = rand_int(&rng, W->cfg.leadMin, W->cfg.leadMax);
+        PO* node = po_create(W, i, qty[i], W->day + lt, lt);
+        if (node && !pobook_add(&W->pos, C, W->day, node)) { pobook_release(&W->pos, node); node = NULL; }
+        if (node) C->ordersCost[i] += W->cfg.orderCostFixed;
+    }
+}
+/* Phase 3: granted quantities become store POs, with the store's own lead-time stream */
+static void net_store_ship(void* ctx, int s) {
+    Network* N = (Network*)ctx; Sim* S = &N->store[s]; const Outbox* B = &N->box[s]; Rng rng;
+    for (int k = 0; k < B->n; k++) {
+        int i = B->item[k], q = B->granted[k]; if (q <= 0) continue;
+        sim_rng(&rng, S, (unsigned)i, RNG_LEAD);
+        int lt = rand_int(&rng, S->cfg.leadMin, S->cfg.leadMax);
+        PO* node = po_create(S, i, q, S->day + lt, lt);
+        if (node && !pobook_add(&S->pos, &S->cat, S->day, node)) { pobook_release(&S->pos, node); node = NULL; }
+        if (node) S->cat.ordersCost[i] += S->cfg.orderCostFixed;
+    }
+}
+/* A store's (s, Q) for item i, for sizing the warehouse policy */
+static void net_store_sq(const Sim* S, int i, int* sp, int* q) {
+    const Catalog* C = &S->cat;
+    if (C->policy[i] == POL_FORECAST || (C->policy[i] == POL_CONFIG && S->cfg.defaultPolicy == POL_FORECAST)) {
+        /* no forecast yet: the same rule on the expected demand, Poisson variance */
+        double P = (S->cfg.leadMin + S->cfg.leadMax) / 2.0 + 1.0, lam = demand_lambda_for(C, i);
+        *sp = (int)ceil(lam * P + normal_quantile(MIN(MAX(S->cfg.serviceLevel, 0.5), 0.9999)) * sqrt(lam * P));
+        *q = MAX(1, (int)ceil(lam * S->cfg.coverDays)); return;
+    }
+    if (C->policy[i] == POL_CONFIG) { *sp = S->cfg.reorder_point; *q = S->cfg.order_quantity; return; }
+    *sp = C->reorderPoint[i] > 0 ? C->reorderPoint[i] : 0;
+    *q = C->orderQty[i] > 0 ? C->orderQty[i] : MAX(C->orderUpTo[i] - *sp, 1);
+}
+static void net_free(Network* N) {
+    for (int s = 0; s < N->nStores && N->store; s++) { sim_free(&N->store[s]); free(N->box[s].item); free(N->box[s].qty); free(N->box[s].granted); }
+    for (int w = 0; w < N->nWh && N->wh; w++) { sim_free(&N->wh[w]); free(N->need[w]); free(N->left[w]); }
+    free(N->store); free(N->box); free(N->wh); free(N->need); free(N->left);
+}
+/* Usage: --stores N [--warehouses W] [--days D] [--threads T] [--seed S] [--wh-s X] [--wh-q Y] [--wh-lead a:b] [--out file.csv]
+   Warehouse (s, Q) per item = X (resp. Y) times the sum of its stores' (s, Q); it starts with s + Q units. */
+static int headless_network(int argc, char** argv) {
+    int nStores = 0, nWh = 1, days = -1, threads = cpu_count(), whLeadMin = 5, whLeadMax = 10, unused;
+    double whS = 1.5, whQ = 2.0; unsigned long long seed = 0; const char* outPath = NETWORK_PATH;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i]; const char* v = (i + 1 < argc ? argv[i + 1] : NULL);
+        if (!strcmp(a, "--stores") && v) { nStores = atoi(v); i++; }
+        else if (!strcmp(a, "--warehouses") && v) { nWh = atoi(v); i++; }
+        else if (!strcmp(a, "--days") && v) { days = atoi(v); i++; }
+        else if (!strcmp(a, "--threads") && v) { threads = atoi(v); i++; }
+        else if (!strcmp(a, "--seed") && v) { seed = strtoull(v, NULL, 10); i++; }
+        else if (!strcmp(a, "--wh-s") && v) { whS = atof(v); i++; }
+        else if (!strcmp(a, "--wh-q") && v) { whQ = atof(v); i++; }
+        else if (!strcmp(a, "--wh-lead") && v && parse_range(v, &whLeadMin, &whLeadMax, &unused)) { i++; }
+        else if (!strcmp(a, "--out") && v) { outPath = v; i++; }
+        else { fprintf(stderr, "ERR: unknown argument %s\n", a); return 2; }
+    }
+    if (nStores <= 0 || nWh <= 0 || nWh > nStores) { fprintf(stderr, "ERR: need --stores N > 0 and 1 <= --warehouses <= N\n"); return 2; }
+
+    Sim proto; sim_init(&proto);
+    load_config_txt(&proto.cfg, NULL, "config.txt");
+    load_inventory_csv(&proto, "inventory.csv");
+    load_policy_csv(&proto, POLICY_PATH);
+    load_demand_csv(&proto, DEMAND_PATH);
+    if (days <= 0) days = proto.cfg.daysDefault;
+    if (!seed) seed = proto.cfg.seed ? proto.cfg.seed : (unsigned long long)time(NULL);
+    int n = proto.cat.n, ok = 1;
+
+    Network N; memset(&N, 0, sizeof(N)); N.nStores = nStores; N.nWh = nWh;
+    N.store = (Sim*)calloc(nStores, sizeof(Sim)); N.box = (Outbox*)calloc(nStores, sizeof(Outbox));
+    N.wh = (Sim*)calloc(nWh, sizeof(Sim)); N.need = (long long**)calloc(nWh, sizeof(long long*)); N.left = (int**)calloc(nWh, sizeof(int*));
+    if (!N.store || !N.box || !N.wh || !N.need || !N.left) ok = 0;
+    for (int s = 0; s < nStores && ok; s++) {
+        if (!sim_clone(&N.store[s], &proto)) { ok = 0; N.nStores = s; break; }
+        N.store[s].rngKey = rng_key_for(seed, (unsigned long long)s); N.store[s].outbox = &N.box[s];
+    }
+    for (int w = 0; w < nWh && ok; w++) {
+        Sim* W = &N.wh[w];
+        N.need[w] = (long long*)calloc(n > 0 ? n : 1, sizeof(long long)); N.left[w] = (int*)calloc(n > 0 ? n : 1, sizeof(int));
+        if (!N.need[w] || !N.left[w] || !sim_clone(W, &proto)) {   /* net_free only sees rows 0..w-1 */
+            free(N.need[w]); free(N.left[w]); N.need[w] = NULL; N.left[w] = NULL;
+            ok = 0; N.nWh = w; break;
+        }
+        cat_reset_counters(&W->cat);
+        W->rngKey = rng_key_for(seed, (unsigned long long)nStores + w); W->cfg.leadMin = whLeadMin; W->cfg.leadMax = MAX(whLeadMin, whLeadMax);
+        for (int i = 0; i < n; i++) {
+            long long sumS = 0, sumQ = 0; int sp, q;
+            for (int s = w; s < nStores; s += nWh) { net_store_sq(&proto, i, &sp, &q); sumS += sp; sumQ += q; }
+            W->cat.policy[i] = POL_SQ; W->cat.reorderPoint[i] = (int)ceil(whS * sumS); W->cat.orderQty[i] = MAX(1, (int)ceil(whQ * sumQ));
+            W->cat.stock[i] = W->cat.reorderPoint[i] + W->cat.orderQty[i];
+        }
+        W->cat.polDirty = 1;
+    }
+    if (!ok) { puts("OOM"); net_free(&N); sim_free(&proto); return 1; }
+
+    Pool P; int used = pool_start(&P, MIN(threads, nStores));
+    if (!used) { puts("OOM"); net_free(&N); sim_free(&proto); return 1; }
+    clock_t c0 = clock(); double w0 = wall_seconds();
+    for (int d = 0; d < days; d++) {
+        pool_run(&P, nStores, net_store_day, &N);
+        N.day = N.store[0].day;
+        pool_run(&P, nWh, net_warehouse_day, &N);
+        pool_run(&P, nStores, net_store_ship, &N);
+    }
+    double wall = wall_seconds() - w0, cpu = (double)(clock() - c0) / CLOCKS_PER_SEC;
+    pool_stop(&P);
+
+    /* report */
+    RepKPI tot; memset(&tot, 0, sizeof(tot)); double minFill = 1.0, maxFill = 0.0, whCost = 0; long long whReq = 0, whShip = 0;
+    FILE* f = mm_fopen(outPath, "w");
+    if (f) fprintf(f, "kind,index,warehouse,revenue,cogs,orders,profit,fill_rate,requested,served,stockouts,waste\n");
+    else fprintf(stderr, "ERR: cannot open %s\n", outPath);
+    for (int s = 0; s < nStores; s++) {
+        RepKPI k; sim_collect_kpi(&N.store[s], &k);
+        tot.revenue += k.revenue; tot.cogs += k.cogs; tot.ordersCost += k.ordersCost; tot.profit += k.profit;
+        tot.requested += k.requested; tot.served += k.served; tot.stockouts += k.stockouts; tot.wasteUnits += k.wasteUnits;
+        minFill = MIN(minFill, k.fillRate); maxFill = MAX(maxFill, k.fillRate);
+        if (f) fprintf(f, "store,%d,%d,%.2f,%.2f,%.2f,%.2f,%.4f,%lld,%lld,%lld,%lld\n", s + 1, s % nWh + 1, k.revenue, k.cogs, k.ordersCost, k.profit, k.fillRate, k.requested, k.served, k.stockouts, k.wasteUnits);
+    }
+    for (int w = 0; w < nWh; w++) {
+        RepKPI k; sim_collect_kpi(&N.wh[w], &k); whCost += k.ordersCost; whReq += k.requested; whShip += k.served;
+        if (f) fprintf(f, "warehouse,%d,%d,0,0,%.2f,%.2f,%.4f,%lld,%lld,%lld,0\n", w + 1, w + 1, k.ordersCost, -k.ordersCost, k.fillRate, k.requested, k.served, k.stockouts);
+    }
+    if (f) fclose(f);
+    printf("=== Network: %d stores x %d products, %d warehouse(s) | %d days | threads: %d | seed: %llu ===\n", nStores, n, nWh, days, used, seed);
+    printf("Stores:     revenue %.0f | profit %.0f | fill rate %.2f%% (store min %.2f%%, max %.2f%%) | stockouts %lld | waste %lld\n",
+        tot.revenue, tot.profit, tot.requested > 0 ? 100.0 * tot.served / tot.requested : 100.0, minFill * 100.0, maxFill * 100.0, tot.stockouts, tot.wasteUnits);
+    printf("Warehouses: requested %lld | shipped %lld (%.2f%%) | supplier order cost %.0f\n", whReq, whShip, whReq > 0 ? 100.0 * whShip / whReq : 100.0, whCost);
+    printf("Network profit: %.0f ILS\n", tot.profit - whCost);
+    printf("Per-store / per-warehouse KPIs saved to: %s\n", outPath);
+    printf("Elapsed: %.2f s wall, %.2f s CPU | %.0f store-days/s | %.2f ms per simulated day\n", wall, cpu,
+        wall > 0 ? (double)nStores * days / wall : 0.0, days > 0 ? wall * 1e3 / days : 0.0);
+    net_free(&N); sim_free(&proto);
+    return 0;
+}
+
+/* ---------- Timing wheel ---------- */
+/* Hierarchical timing wheel over event times in ms: TW_LEVELS levels of TW_SLOTS slots. An event sits at
+   the lowest level where its time shares all higher digits with `now`; when `now` moves into a higher-level
+   slot, that slot is re-filed one level down. A bitmap per level finds the next slot with a few ctz, so push
+   and pop are O(1). Events of the same ms pop in push order. */
+static int tw_ctz(unsigned long long x) {
+#ifdef _MSC_VER
+    unsigned long i; _BitScanForward64(&i, x); return (int)i;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+static int tw_msb(unsigned int x) {   /* x != 0 */
+#ifdef _MSC_VER
+    unsigned long i; _BitScanReverse(&i, x); return (int)i;
+#else
+    return 31 - __builtin_clz(x);
+#endif
+}
+static void tw_init(TimingWheel* W) {
+    memset(W, 0, sizeof(*W)); W->freeList = -1;
+    for (int l = 0; l < TW_LEVELS; l++) for (int s = 0; s < TW_SLOTS; s++) W->head[l][s] = W->tail[l][s] = -1;
+}
+static void tw_free(TimingWheel* W) { free(W->ev); tw_init(W); }
+static void tw_file(TimingWheel* W, int e) {
+    unsigned int t = W->ev[e].time, diff = t ^ W->now;
+    int l = (diff ? tw_msb(diff) / TW_BITS : 0);   /* highest digit where t and now differ */
+    int s = (int)(t >> (TW_BITS * l)) & (TW_SLOTS - 1);
+    W->ev[e].next = -1;
+    if (W->tail[l][s] >= 0) W->ev[W->tail[l][s]].next = e; else W->head[l][s] = e;
+    W->tail[l][s] = e; W->mask[l][s >> 6] |= 1ULL << (s & 63);
+}
+/* First non-empty slot >= from on level l, -1 if none */
+static int tw_next_slot(const TimingWheel* W, int l, int from) {
+    int w = from >> 6; unsigned long long bits = W->mask[l][w] & (~0ULL << (from & 63));
+    while (!bits) { if (++w == TW_WORDS) return -1; bits = W->mask[l][w]; }
+    return (w << 6) + tw_ctz(bits);
+}
+/* Schedules (time, type, arg); times before `now` run at `now`. 0 = out of memory. */
+static int tw_push(TimingWheel* W, unsigned int time, int type, int arg) {
+    if (W->freeList < 0) {
+        int cap = W->cap ? W->cap * 2 : 1024; TwEvent* ne = (TwEvent*)realloc(W->ev, sizeof(TwEvent) * (size_t)cap);
+        if (!ne) return 0;
+        for (int k = cap - 1; k >= W->cap; k--) { ne[k].next = W->freeList; W->freeList = k; }
+        W->ev = ne; W->cap = cap;
+    }
+    int e = W->freeList; W->freeList = W->ev[e].next;
+    W->ev[e].time = (time < W->now ? W->now : time); W->ev[e].type = type; W->ev[e].arg = arg;
+    tw_file(W, e); W->count++;
+    return 1;
+}
+/* Earliest event (advances `now` to its time); 0 when the wheel is empty */
+static int tw_pop(TimingWheel* W, TwEvent* out) {
+    while (W->count > 0) {
+        int s = tw_next_slot(W, 0, (int)(W->now & (TW_SLOTS - 1)));
+        if (s >= 0) {
+            int e = W->head[0][s];
+            W->now = (W->now & ~(unsigned int)(TW_SLOTS - 1)) | (unsigned int)s;
+            W->head[0][s] = W->ev[e].next; if (W->head[0][s] < 0) { W->tail[0][s] = -1; W->mask[0][s >> 6] &= ~(1ULL << (s & 63)); }
+            *out = W->ev[e]; W->ev[e].next = W->freeList; W->freeList = e; W->count--;
+            return 1;
+        }
+        int l = 1;
+        for (; l < TW_LEVELS; l++) {   /* next occupied slot above: move `now` to its start and re-file it */
+            int cur = (int)(W->now >> (TW_BITS * l)) & (TW_SLOTS - 1);
+            if ((s = tw_next_slot(W, l, cur)) < 0) continue;
+            int e = W->head[l][s];
+            unsigned int hi = (l + 1 < TW_LEVELS ? (W->now >> (TW_BITS * (l + 1))) << (TW_BITS * (l + 1)) : 0);
+            if (s != cur) W->now = hi | ((unsigned int)s << (TW_BITS * l));
+            W->head[l][s] = W->tail[l][s] = -1; W->mask[l][s >> 6] &= ~(1ULL << (s & 63));
+            while (e >= 0) { int next = W->ev[e].next; tw_file(W, e); e = next; }
+            break;
+        }
+        if (l == TW_LEVELS) return 0;
+    }
+    return 0;
+}
+
+/* ---------- Intraday simulation (discrete events) ---------- */
+/* Optional finer model of one store day, in ms from midnight. Stock is split into shelf and backroom:
+   customers (Poisson arrivals over the opening hours, shaped by an hourly profile via thinning) pick
+   baskets from the shelf only; a shelf at half capacity or less calls a restock from the backroom that
+   lands restockMin later; POs due today are delivered at a random time in the delivery window. After
+   closing, waste and reorders are the daily model's. Mean demand per SKU is the daily model's lambda. */
+static const double ID_HOUR_PROFILE[24] = {   /* relative arrival rate by hour of day */
+    0.2, 0.1, 0.1, 0.1, 0.1, 0.2, 0.4, 0.7, 0.9, 1.0, 1.0, 1.2, 1.6, 1.5, 1.1, 1.0, 1.2, 1.7, 1.9, 1.7, 1.2, 0.8, 0.5, 0.3 };
+static void intraday_defaults(IntradayOptions* o) {
+    o->openH = 8; o->closeH = 22; o->basket = 3.0; o->shelfDays = 0.5; o->restockMin = 20; o->deliveryFrom = 6; o->deliveryTo = 14;
+}
+/* Walker/Vose alias table over the SKU lambdas: one uniform picks a column, a second decides column or alias */
+static int intraday_alias(Intraday* E, int n) {
+    double* scaled = (double*)malloc(sizeof(double) * (size_t)n); int* small = (int*)malloc(sizeof(int) * (size_t)n), * large = (int*)malloc(sizeof(int) * (size_t)n);
+    if (!scaled || !small || !large) { free(scaled); free(small); free(large); return 0; }
+    int ns = 0, nl = 0;
+    for (int i = 0; i < n; i++) { scaled[i] = E->lam[i] * n / E->lamSum; if (scaled[i] < 1.0) small[ns++] = i; else large[nl++] = i; }
+    while (ns && nl) {
+        int s = small[--ns], l = large[nl - 1];
+        E->pick[s].prob = scaled[s]; E->pick[s].alias = l;
+        scaled[l] -= 1.0 - scaled[s]; if (scaled[l] < 1.0) { nl--; small[ns++] = l; }
+    }
+    while (nl) { int l = large[--nl]; E->pick[l].prob = 1.0; E->pick[l].alias = l; }
+    while (ns) { int s = small[--ns]; E->pick[s].prob = 1.0; E->pick[s].alias = s; }   /* rounding leftovers */
+    free(scaled); free(small); free(large); return 1;
+}
+static int intraday_init(Intraday* E, const Sim* S, const IntradayOptions* opt) {
+    memset(E, 0, sizeof(*E)); E->opt = *opt; tw_init(&E->tw);
+    const Catalog* C = &S->cat; int n = C->n;
+    E->sku = (IdSku*)calloc((size_t)n + 1, sizeof(IdSku)); E->pick = (IdAlias*)calloc((size_t)n + 1, sizeof(IdAlias));
+    E->lam = (double*)calloc((size_t)n + 1, sizeof(double));
+    if (!E->sku || !E->pick || !E->lam) return 0;
+    for (int i = 0; i < n; i++) {
+        E->lam[i] = demand_lambda_for(C, i); E->lamSum += E->lam[i];
+        E->sku[i].cap = MAX(2, (int)ceil(E->lam[i] * opt->shelfDays));
+    }
+    for (int h = opt->openH; h < opt->closeH; h++) { E->profileSum += ID_HOUR_PROFILE[h]; E->profileMax = MAX(E->profileMax, ID_HOUR_PROFILE[h]); }
+    return n == 0 || intraday_alias(E, n);
+}
+static void intraday_free(Intraday* E) {
+    tw_free(&E->tw); free(E->sku); free(E->pick); free(E->lam); free(E->po);
+    memset(E, 0, sizeof(*E));
+}
+static void intraday_want_restock(Intraday* E, int i, unsigned int now) {
+    IdSku* k = &E->sku[i];
+    if (k->pending || k->shelf * 2 > k->cap || k->back <= 0) return;
+    k->pending = tw_push(&E->tw, now + (unsigned int)E->opt.restockMin * ID_MS_PER_MIN, ID_EV_RESTOCK, i);
+}
+static void intraday_customer(Intraday* E, unsigned int n, Rng* r, unsigned int now) {
+    long long* H = E->hour[now / ID_MS_PER_HOUR];
+    int items = 1 + sample_poisson(r, E->opt.basket - 1.0);
+    H[ID_H_CUSTOMERS]++; H[ID_H_REQUESTED] += items;
+    for (int j = 0; j < items; j++) {
+        int i = (int)(((unsigned long long)rng_u32(r) * n) >> 32); if (rng_u01(r) >= E->pick[i].prob) i = E->pick[i].alias;
+        IdSku* k = &E->sku[i]; k->requested++;
+        if (k->shelf > 0) { k->shelf--; k->served++; H[ID_H_SERVED]++; }
+        else H[k->back > 0 ? ID_H_LOST_SHELF : ID_H_LOST_STOCK]++;
+        intraday_want_restock(E, i, now);
+    }
+}
+/* One day: morning shelf fill, then events until the wheel is empty, then waste and reorders */
+static void intraday_day(Sim* S, Intraday* E, DayTotals* out) {
+    S->day += 1;
+    DayTotals D; memset(&D, 0, sizeof(D));
+    Catalog* C = &S->cat; int n = C->n; const IntradayOptions* o = &E->opt; TimingWheel* W = &E->tw;
+    if (C->lotDirty) lots_sync(C, S->day);
+    for (int i = 0; i < n; i++) {
+        IdSku* k = &E->sku[i]; int stock = MAX(C->stock[i], 0);
+        k->shelf = MIN(k->cap, stock); k->back = stock - k->shelf; k->pending = k->requested = k->served = 0;
+    }
+    W->now = 0;
+
+    /* deliveries of the POs due today, at a random time in the window (stream per PO) */
+    PO* arrivals = pobook_pop_due(&S->pos, C, S->day); int nArr = 0; Rng r;
+    for (PO* a = arrivals; a; a = a->next) nArr++;
+    if (nArr > E->poCap) { PO** np = (PO**)realloc(E->po, sizeof(PO*) * (size_t)nArr); if (np) { E->po = np; E->poCap = nArr; } }
+    nArr = 0;
+    for (PO* a = arrivals; a; a = a->next) {
+        unsigned int t = (unsigned int)o->deliveryFrom * ID_MS_PER_HOUR;
+        sim_rng(&r, S, (unsigned)a->poId, RNG_DELIVERY);
+        t += (unsigned int)(rng_u01(&r) * (o->deliveryTo - o->deliveryFrom) * (double)ID_MS_PER_HOUR);
+        if (nArr < E->poCap && tw_push(W, t, ID_EV_DELIVERY, nArr)) E->po[nArr++] = a;
+        else { E->sku[a->productIndex].back += a->qty; lot_receive(C, a->productIndex, a->qty, S->day); }   /* no room to schedule it: received at opening */
+    }
+
+    /* customers: Poisson at the peak rate, kept with probability profile(h) / peak */
+    double perDay = (E->lamSum * season_factor(&S->cfg, S->day) / MAX(o->basket, 1.0));
+    double peak = (E->profileSum > 0 ? perDay * E->profileMax / E->profileSum / ID_MS_PER_HOUR : 0);   /* customers per ms */
+    unsigned int open = (unsigned int)o->openH * ID_MS_PER_HOUR, close = (unsigned int)o->closeH * ID_MS_PER_HOUR;
+    Rng ra; sim_rng(&ra, S, 0, RNG_ARRIVAL);
+    double next = open + (peak > 0 ? -log(rng_u01(&ra)) / peak : close);
+    if (next < close) tw_push(W, (unsigned int)next, ID_EV_CUSTOMER, 0);
+
+    TwEvent ev; long long events = 0;
+    while (tw_pop(W, &ev)) {
+        events++;
+        if (ev.type == ID_EV_CUSTOMER) {
+            if (rng_u01(&ra) * E->profileMax < ID_HOUR_PROFILE[ev.time / ID_MS_PER_HOUR]) intraday_customer(E, (unsigned)n, &ra, ev.time);
+            next += -log(rng_u01(&ra)) / peak;   /* from the exact (unrounded) arrival time */
+            if (next < close) tw_push(W, (unsigned int)next, ID_EV_CUSTOMER, 0);
+        }
+        else if (ev.type == ID_EV_DELIVERY) {
+            PO* a = E->po[ev.arg]; int i = a->productIndex;
+            E->sku[i].back += a->qty; lot_receive(C, i, a->qty, S->day); E->hour[MIN(ev.time / ID_MS_PER_HOUR, 23)][ID_H_DELIVERIES]++;
+            intraday_want_restock(E, i, ev.time);
+        }
+        else if (ev.type == ID_EV_RESTOCK) {
+            IdSku* k = &E->sku[ev.arg]; k->pending = 0;
+            int move = MIN(k->cap - k->shelf, k->back);
+            if (move > 0) { k->shelf += move; k->back -= move; E->hour[MIN(ev.time / ID_MS_PER_HOUR, 23)][ID_H_RESTOCKS]++; }
+        }
+    }
+    pobook_release(&S->pos, arrivals);
+    E->events += events;
+
+    /* closing: fold the day into the catalog (same counters as sales_kernel); ordArr holds the
+       day's demand until the reorders */
+    arena_reset(&S->scratch); int* ordArr = (int*)arena_alloc(&S->scratch, sizeof(int) * n);
+    for (int i = 0; i < n; i++) {
+        const IdSku* k = &E->sku[i]; int v = k->served, q = k->requested;
+        if (ordArr) ordArr[i] = q;
+        C->stock[i] = k->shelf + k->back;
+        C->requested[i] += q; C->served[i] += v; C->stockouts[i] += q - v;
+        C->revenue[i] += v * C->price[i]; C->cogs[i] += v * C->baseCost[i];
+        D.requested += q; D.served += v; D.stockouts += q - v; D.revenue += v * C->price[i]; D.cogs += v * C->baseCost[i];
+    }
+
+    /* after closing: the daily model's waste and reorders */
+    for (int i = 0; i < n; i++) {
+        int waste;
+        if (C->shelfLife[i] > 0) waste = lots_end_day(C, i, E->sku[i].served, S->day);
+        else {
+            if (!(C->flags[i] & PERISHABLE)) continue;
+            sim_rng(&r, S, (unsigned)i, RNG_WASTE);
+            waste = waste_units_for_day(&r, C->stock[i], C->flags[i]); if (waste > C->stock[i]) waste = C->stock[i];
+        }
+        if (waste > 0) { C->stock[i] -= waste; C->wasteUnits[i] += waste; D.wasteUnits += waste; }
+    }
+    if (!ordArr) puts("OOM");
+    else { if (forecast_active(S)) forecast_update(S, ordArr); reorder_quantities(S, ordArr); }
+    for (int i = 0; ordArr && i < n; i++) {
+        if (ordArr[i] <= 0) continue;
+        sim_rng(&r, S, (unsigned)i, RNG_LEAD);
+        int lt = rand_int(&r, S->cfg.leadMin, S->cfg.leadMax);
+        PO* node = po_create(S, i, ordArr[i], S->day + lt, lt);
+        if (node && !pobook_add(&S->pos, C, S->day, node)) { pobook_release(&S->pos, node); node = NULL; }
+        if (node) { C->ordersCost[i] += S->cfg.orderCostFixed; D.ordersCost += S->cfg.orderCostFixed; }
+    }
+    D.profit = D.revenue - D.cogs - D.ordersCost;
+    S->agg.valid = 0; if (S->rank) S->rank->valid = 0;   /* counters changed outside simulate_day */
+    if (out) *out = D;
+}
+/* Usage: --intraday [--days D] [--hours 8:22] [--basket 3] [--shelf-days 0.5] [--restock-min 20] [--deliveries 6:14]
+          [--seed S] [--out sim_intraday.csv] */
+static int headless_intraday(int argc, char** argv) {
+    IntradayOptions o; intraday_defaults(&o);
+    int days = -1, unused; unsigned long long seed = 0; const char* outPath = INTRADAY_PATH;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i]; const char* v = (i + 1 < argc ? argv[i + 1] : NULL);
+        if (!strcmp(a, "--intraday")) {}
+        else if (!strcmp(a, "--days") && v) { days = atoi(v); i++; }
+        else if (!strcmp(a, "--hours") && v && parse_range(v, &o.openH, &o.closeH, &unused)) i++;
+        else if (!strcmp(a, "--deliveries") && v && parse_range(v, &o.deliveryFrom, &o.deliveryTo, &unused)) i++;
+        else if (!strcmp(a, "--basket") && v) { o.basket = atof(v); i++; }
+        else if (!strcmp(a, "--shelf-days") && v) { o.shelfDays = atof(v); i++; }
+        else if (!strcmp(a, "--restock-min") && v) { o.restockMin = atoi(v); i++; }
+        else if (!strcmp(a, "--seed") && v) { seed = strtoull(v, NULL, 10); i++; }
+        else if (!strcmp(a, "--out") && v) { outPath = v; i++; }
+        else { fprintf(stderr, "ERR: unknown argument %s\n", a); return 2; }
+    }
+    if (o.openH < 0 || o.closeH > 24 || o.openH >= o.closeH || o.deliveryFrom < 0 || o.deliveryTo > 24 || o.deliveryFrom >= o.deliveryTo ||
+        o.basket < 1.0 || o.shelfDays <= 0 || o.restockMin < 0) {
+        fprintf(stderr, "ERR: need 0 <= open < close <= 24, 0 <= delivery from < to <= 24, --basket >= 1, --shelf-days > 0\n"); return 2;
+    }
+
+    Sim S; sim_init(&S);
+    load_config_txt(&S.cfg, NULL, "config.txt");
+    load_inventory_csv(&S, "inventory.csv");
+    load_policy_csv(&S, POLICY_PATH);
+    load_demand_csv(&S, DEMAND_PATH);
+    if (days <= 0) days = S.cfg.daysDefault;
+    if (!seed) seed = S.cfg.seed ? S.cfg.seed : (unsigned long long)time(NULL);
+    S.rngKey = seed;
+    Intraday E; FILE* f = NULL;
+    if (!intraday_init(&E, &S, &o)) { puts("OOM"); intraday_free(&E); sim_free(&S); return 1; }
+    if ((f = mm_fopen(outPath, "w")) == NULL) fprintf(stderr, "ERR: cannot open %s\n", outPath);
+    else fprintf(f, "day,hour,customers,requested,served,fill_rate,lost_shelf,lost_stockout,restocks,deliveries\n");
+
+    long long total[24][ID_H_COUNT]; memset(total, 0, sizeof(total));
+    DayTotals T; memset(&T, 0, sizeof(T)); double engine = 0;
+    for (int d = 0; d < days; d++) {
+        memset(E.hour, 0, sizeof(E.hour)); DayTotals D;
+        double t0 = wall_seconds(); intraday_day(&S, &E, &D); engine += wall_seconds() - t0;
+        T.revenue += D.revenue; T.cogs += D.cogs; T.ordersCost += D.ordersCost; T.profit += D.profit;
+        T.requested += D.requested; T.served += D.served; T.stockouts += D.stockouts; T.wasteUnits += D.wasteUnits;
+        for (int h = 0; h < 24; h++) {
+            const long long* H = E.hour[h];
+            for (int k = 0; k < ID_H_COUNT; k++) total[h][k] += H[k];
+            if (f && (H[ID_H_CUSTOMERS] || H[ID_H_RESTOCKS] || H[ID_H_DELIVERIES]))
+                fprintf(f, "%d,%d,%lld,%lld,%lld,%.4f,%lld,%lld,%lld,%lld\n", S.day, h, H[ID_H_CUSTOMERS], H[ID_H_REQUESTED], H[ID_H_SERVED],
+                    H[ID_H_REQUESTED] ? (double)H[ID_H_SERVED] / (double)H[ID_H_REQUESTED] : 1.0, H[ID_H_LOST_SHELF], H[ID_H_LOST_STOCK], H[ID_H_RESTOCKS], H[ID_H_DELIVERIES]);
+        }
+    }
+    if (f) fclose(f);
+
+    long long lostShelf = 0, lostStock = 0;
+    for (int h = 0; h < 24; h++) { lostShelf += total[h][ID_H_LOST_SHELF]; lostStock += total[h][ID_H_LOST_STOCK]; }
+    printf("=== Intraday: %d days | products: %d | open %02d:00-%02d:00 | basket %.1f | shelf %.2f days | restock %d min | seed: %llu ===\n",
+        days, S.cat.n, o.openH, o.closeH, o.basket, o.shelfDays, o.restockMin, seed);
+    printf("%-6s %10s %12s %10s %10s %12s %10s %10s\n", "Hour", "Customers", "Requested", "Fill %", "Lost:shelf", "Lost:no stock", "Restocks", "Deliveries");
+    for (int h = 0; h < 24; h++) {
+        const long long* H = total[h]; if (!H[ID_H_CUSTOMERS] && !H[ID_H_RESTOCKS] && !H[ID_H_DELIVERIES]) continue;
+        printf("%02d:00  %10lld %12lld %10.2f %10lld %12lld %10lld %10lld\n", h, H[ID_H_CUSTOMERS], H[ID_H_REQUESTED],
+            H[ID_H_REQUESTED] ? 100.0 * H[ID_H_SERVED] / H[ID_H_REQUESTED] : 100.0, H[ID_H_LOST_SHELF], H[ID_H_LOST_STOCK], H[ID_H_RESTOCKS], H[ID_H_DELIVERIES]);
+    }
+    printf("Revenue: %.0f ILS | COGS: %.0f ILS | Orders: %.0f ILS | PROFIT: %.0f ILS\n", T.revenue, T.cogs, T.ordersCost, T.profit);
+    printf("Fill rate: %.2f%% | Lost sales: %lld (empty shelf, backroom had stock: %lld) | Waste (units): %lld\n",
+        T.requested ? 100.0 * T.served / T.requested : 100.0, lostShelf + lostStock, lostShelf, T.wasteUnits);
+    printf("Events: %lld in %.3f s (%.1f M events/s)\n", E.events, engine, engine > 0 ? E.events / engine / 1e6 : 0.0);
+    printf("Per-hour service saved to: %s\n", outPath);
+    intraday_free(&E); sim_free(&S);
+    return 0;
+}
+
+/* ---------- What-if scenarios (copy-on-write forks) ---------- */
+/* Product by id or name (case-insensitive); -1 if none */
+static int scn_product(const Catalog* C, const char* ref) {
+    int id;
+    if (parse_int(ref, &id)) for (int i = 0; i < C->n; i++) if (C->id[i] == id) return i;
+    for (int i = 0; i < C->n; i++) {
+        const char* a = cat_name(C, i), * b = ref;
+        while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) { a++; b++; }
+        if (!*a && !*b) return i;
+    }
+    return -1;
+}
+/* One change: "key=value" for any config.txt simulation key (q=60, leadtimemax=6, default_policy=forecast, ...),
+   or "product.field=value" with product an id, a name or * (all) and field one of price, cost, base (a number
+   or +-N%), elasticity, promo, stock, shelflife (days), onsale, perishable, taxexempt (0/1), or a policy column (policy, s, q, S, R, moq, pack: same
+   rules as sim_policy.csv). S == NULL only checks it against the products of ref. Returns 0 with err set
+   if the change is not valid. */
+static int scn_apply(Sim* S, const Catalog* ref, const char* change, char* err, size_t errSize) {
+    char buf[96]; snprintf(buf, sizeof(buf), "%s", change);
+    char* eq = strchr(buf, '=');
+    if (!eq || eq == buf || !eq[1]) { snprintf(err, errSize, "'%s': expected key=value", change); return 0; }
+    *eq = '\0'; char* val = eq + 1, * dot = strrchr(buf, '.');
+    if (!dot) {
+        Config tmp; load_defaults(&tmp);
+        if (!config_apply_line(S ? &S->cfg : &tmp, NULL, change)) { snprintf(err, errSize, "'%s': unknown setting", buf); return 0; }
+        return 1;
+    }
+    *dot = '\0'; char* field = dot + 1;
+    int all = !strcmp(buf, "*"), one = (all ? 0 : scn_product(ref, buf));
+    if (one < 0) { snprintf(err, errSize, "'%s': unknown product", buf); return 0; }
+    int kind, pcol[PCOL_COUNT]; unsigned int bit = 0; unsigned long long mask;
+    if (!strcmp(field, "price")) { kind = 0; mask = CATCOL(price); }
+    else if (!strcmp(field, "cost")) { kind = 1; mask = CATCOL(baseCost); }
+    else if (!strcmp(field, "stock")) { kind = 2; mask = CATCOL(stock); }
+    else if (!strcmp(field, "shelflife")) { kind = 6; mask = CATCOL(shelfLife); }
+    else if (!strcmp(field, "onsale") || !strcmp(field, "perishable") || !strcmp(field, "taxexempt")) {
+        kind = 3; mask = CATCOL(flags); bit = (field[0] == 'o' ? ON_SALE : field[0] == 'p' ? PERISHABLE : TAX_EXEMPT);
+    }
+    else if (!strcmp(field, "base") || !strcmp(field, "elasticity") || !strcmp(field, "promo")) {
+        kind = 5; bit = (unsigned)field[0]; mask = (field[0] == 'b' ? CATCOL(dmBase) : field[0] == 'e' ? CATCOL(dmElast) : CATCOL(dmPromo));
+    }
+    else if (policy_columns(&field, 1, pcol)) {
+        kind = 4; mask = CATCOL(policy) | CATCOL(reorderPoint) | CATCOL(orderQty) | CATCOL(orderUpTo) | CATCOL(reviewPeriod) | CATCOL(moq) | CATCOL(casePack) | CATCOL(polIdx);
+    }
+    else { snprintf(err, errSize, "'%s': unknown product field", field); return 0; }
+    char* end; double v = strtod(val, &end); int pct = (*end == '%' && !end[1]), iv;
+    if (kind == 4 && pcol[PCOL_POLICY] == 0) {
+        int known = 0;
+        for (int t = 0; t < POL_COUNT; t++) { const char* a = POLICY_NAMES[t], * b = val; while (*a && tolower((unsigned char)*b) == *a) { a++; b++; } if (!*a && !*b) known = 1; }
+        if (!known) { snprintf(err, errSize, "'%s': unknown policy", val); return 0; }
+    }
+    else if (kind == 2 || kind == 4 || kind == 6 ? !parse_int(val, &iv) || (kind != 4 && iv < 0) : (end == val || (*end && !(pct && (kind <= 1 || (kind == 5 && bit == 'b')))))) { snprintf(err, errSize, "'%s': bad value for %s", val, field); return 0; }
+    if (kind <= 1 && (pct ? v < -100.0 : v < 0.0)) { snprintf(err, errSize, "'%s': bad value for %s", val, field); return 0; }   /* no negative price / cost */
+    if (!S) return 1;
+
+    Catalog* C = &S->cat;
+    if (!cat_own(C, mask)) { snprintf(err, errSize, "out of memory"); return 0; }
+    for (int i = (all ? 0 : one); i < (all ? C->n : one + 1); i++) {
+        switch (kind) {
+        case 0: C->price[i] = (pct ? C->price[i] * (1.0 + v / 100.0) : v); break;
+        case 1: C->baseCost[i] = (pct ? C->baseCost[i] * (1.0 + v / 100.0) : v); break;
+        case 2: C->stock[i] = iv; break;
+        case 3: if (v != 0.0) C->flags[i] |= bit; else C->flags[i] &= ~bit; break;
+        case 4: policy_apply_row(C, i, &val, 1, pcol); break;
+        case 6: C->shelfLife[i] = iv; break;
+        case 5: {
+            double* col = (bit == 'b' ? C->dmBase : bit == 'e' ? C->dmElast : C->dmPromo);
+            double cur = (bit == 'b' && col[i] <= 0.0 ? ((C->flags[i] & PERISHABLE) ? 6.0 : 3.5) : col[i]);   /* +-N% of the default base */
+            col[i] = (pct ? cur * (1.0 + v / 100.0) : v); if (col[i] < 0.0) col[i] = 0.0;
+        } break;
+        }
+    }
+    if (kind == 0 || kind == 3 || kind == 5) C->dmDirty = 1;
+    if (kind == 2 || kind == 6) C->lotDirty = 1;
+    return 1;
+}
+/* "name: change, change@day, ..." (name optional); changes are checked against ref */
+static int scn_parse(Scenario* B, const char* spec, int index, const Catalog* ref, char* err, size_t errSize) {
+    memset(B, 0, sizeof(*B));
+    const char* colon = strchr(spec, ':'), * eq = strchr(spec, '=');
+    if (colon && (!eq || colon < eq)) {
+        while (isspace((unsigned char)*spec)) spec++;
+        int len = (int)MIN(colon - spec, (long)sizeof(B->name) - 1); while (len > 0 && isspace((unsigned char)spec[len - 1])) len--;
+        memcpy(B->name, spec, (size_t)len); B->name[len] = '\0'; spec = colon + 1;
+    }
+    if (!B->name[0]) snprintf(B->name, sizeof(B->name), "B%d", index);
+    char buf[1024]; snprintf(buf, sizeof(buf), "%s", spec);
+    for (char* tok = strtok(buf, ",;"); tok; tok = strtok(NULL, ",;")) {
+        while (isspace((unsigned char)*tok)) tok++;
+        char* e = tok + strlen(tok); while (e > tok && isspace((unsigned char)e[-1])) *--e = '\0';
+        if (!*tok) continue;
+        if (B->nChanges == SCN_MAX_CHANGES) { snprintf(err, errSize, "%s: more than %d changes", B->name, SCN_MAX_CHANGES); return 0; }
+        char* at = strrchr(tok, '@'); int day = 0;
+        if (at) { if (!parse_int(at + 1, &day)) { snprintf(err, errSize, "'%s': expected @day", tok); return 0; } *at = '\0'; }
+        if (!scn_apply(NULL, ref, tok, err, errSize)) return 0;
+        snprintf(B->change[B->nChanges], sizeof(B->change[0]), "%s", tok); B->at[B->nChanges++] = day;
+    }
+    return 1;
+}
+/* Pool task: one branch over the whole horizon */
+static void scn_run(void* ctx, int t) {
+    ScnJob* J = (ScnJob*)ctx; Scenario* B = &J->sc[t]; Sim* S = &B->sim; char err[128];
+    DayTotals D, T; memset(&T, 0, sizeof(T));
+    for (int d = 0; d < J->days; d++) {
+        for (int k = 0; k < B->nChanges; k++)
+            if (B->at[k] == S->day + 1 || (d == 0 && B->at[k] <= S->day + 1)) scn_apply(S, &S->cat, B->change[k], err, sizeof(err));
+        memset(&D, 0, sizeof(D)); simulate_day(S, &D);
+        T.revenue += D.revenue; T.cogs += D.cogs; T.ordersCost += D.ordersCost; T.profit += D.profit;
+        T.requested += D.requested; T.served += D.served; T.stockouts += D.stockouts; T.wasteUnits += D.wasteUnits;
+    }
+    RepKPI* k = &B->kpi;
+    k->revenue = T.revenue; k->cogs = T.cogs; k->ordersCost = T.ordersCost; k->profit = T.profit;
+    k->requested = T.requested; k->served = T.served; k->stockouts = T.stockouts; k->wasteUnits = T.wasteUnits;
+    k->fillRate = (T.requested > 0 ? (double)T.served / (double)T.requested : 1.0);
+}
+/* Forks base into a "base" branch plus one per spec, runs them in parallel for `days` days and prints
+   the KPIs side by side (base itself does not move). All branches draw the same random numbers, so the
+   differences come from the changes only. */
+static int whatif(Sim* base, const char** specs, int nSpecs, int days, int threads, const char* outPath) {
+    static const char* kpiNames[7] = { "Revenue (ILS)", "COGS (ILS)", "Orders (ILS)", "Profit (ILS)", "Fill rate (%)", "Stockouts", "Waste (units)" };
+    int n = nSpecs + 1; char err[160];
+    if (n > SCN_MAX_BRANCHES) { fprintf(stderr, "ERR: at most %d branches\n", SCN_MAX_BRANCHES - 1); return 2; }
+    Scenario* sc = (Scenario*)calloc(n, sizeof(Scenario)); if (!sc) { puts("OOM"); return 1; }
+    snprintf(sc[0].name, sizeof(sc[0].name), "base");
+    for (int b = 1; b < n; b++)
+        if (!scn_parse(&sc[b], specs[b - 1], b, &base->cat, err, sizeof(err))) { fprintf(stderr, "ERR: %s\n", err); free(sc); return 2; }
+
+    double w0 = wall_seconds();
+    for (int b = 0; b < n; b++) sim_fork(&sc[b].sim, base);
+    double forkMs = (wall_seconds() - w0) * 1e3;
+    unsigned long long total = 0, priv = 0, maxPriv = 0; cat_bytes(&base->cat, &total, &priv);
+    ScnJob J = { sc, days }; Pool P; int used = pool_start(&P, MIN(threads, n));
+    if (used) { pool_run(&P, n, scn_run, &J); pool_stop(&P); }
+    else for (int b = 0; b < n; b++) scn_run(&J, b);
+    double wall = wall_seconds() - w0;
+    for (int b = 0; b < n; b++) { unsigned long long t, p; cat_bytes(&sc[b].sim.cat, &t, &p); if (p > maxPriv) maxPriv = p; }
+
+    printf("\n=== What-if: %d branches + base | days %d..%d | products: %d | threads: %d ===\n", n - 1, base->day + 1, base->day + days, base->cat.n, MAX(used, 1));
+    for (int b = 1; b < n; b++) {
+        printf("%-14s", sc[b].name);
+        for (int k = 0; k < sc[b].nChanges; k++) { printf("%s%s", k ? ", " : "", sc[b].change[k]); if (sc[b].at[k] > base->day + 1) printf(" (from day %d)", sc[b].at[k]); }
+        puts("");
+    }
+    printf("\n%-14s %14s", "KPI", "base");
+    for (int b = 1; b < n; b++) printf(" %14.14s %18s", sc[b].name, "vs base");
+    puts("");
+    for (int r = 0; r < 7; r++) {
+        double v[SCN_MAX_BRANCHES] = { 0 };
+        for (int b = 0; b < n; b++) {
+            const RepKPI* k = &sc[b].kpi;
+            v[b] = (r == 0 ? k->revenue : r == 1 ? k->cogs : r == 2 ? k->ordersCost : r == 3 ? k->profit : r == 4 ? 100.0 * k->fillRate : r == 5 ? (double)k->stockouts : (double)k->wasteUnits);
+        }
+        printf("%-14s %14.2f", kpiNames[r], v[0]);
+        for (int b = 1; b < n; b++) {
+            char cell[32];
+            if (r == 4) snprintf(cell, sizeof(cell), "%+.2f pp", v[b] - v[0]);
+            else if (v[0] != 0.0) snprintf(cell, sizeof(cell), "%+.0f (%+.1f%%)", v[b] - v[0], 100.0 * (v[b] - v[0]) / fabs(v[0]));
+            else snprintf(cell, sizeof(cell), "%+.0f", v[b] - v[0]);
+            printf(" %14.2f %18s", v[b], cell);
+        }
+        puts("");
+    }
+    printf("\nFork: %.3f ms for %d branches (catalog %.1f MB, shared until written); after the run a branch owns at most %.1f MB\n",
+        forkMs, n, total / 1048576.0, maxPriv / 1048576.0);
+    printf("Elapsed: %.2f s wall\n", wall);
+
+    FILE* f = mm_fopen(outPath, "w");
+    if (f) {
+        fprintf(f, "branch,changes,days,revenue,cogs,orders_cost,profit,fill_rate,stockouts,waste,profit_vs_base,fill_rate_vs_base\n");
+        for (int b = 0; b < n; b++) {
+            const RepKPI* k = &sc[b].kpi;
+            fprintf(f, "%s,\"", sc[b].name);
+            for (int c = 0; c < sc[b].nChanges; c++) { fprintf(f, "%s%s", c ? "; " : "", sc[b].change[c]); if (sc[b].at[c] > base->day + 1) fprintf(f, "@%d", sc[b].at[c]); }
+            fprintf(f, "\",%d,%.2f,%.2f,%.2f,%.2f,%.4f,%lld,%lld,%.2f,%.4f\n", days, k->revenue, k->cogs, k->ordersCost, k->profit, k->fillRate,
+                k->stockouts, k->wasteUnits, k->profit - sc[0].kpi.profit, k->fillRate - sc[0].kpi.fillRate);
+        }
+        fclose(f); printf("Branch KPIs saved to: %s\n", outPath);
+    }
+    else fprintf(stderr, "ERR: cannot open %s\n", outPath);
+    for (int b = 0; b < n; b++) sim_free(&sc[b].sim);
+    free(sc);
+    return 0;
+}
+/* Usage: --whatif [--days D] [--threads T] [--branch "name: change, change@day"]... [--out sim_whatif.csv]
+   Forks the saved state (or inventory.csv on day 0); changes as in scn_apply, e.g.
+   --branch "bigQ: q=60" --branch "promo: Strawberries.onsale=1@120, Strawberries.price=-10%" */
+static int headless_whatif(int argc, char** argv) {
+    const char* specs[SCN_MAX_BRANCHES]; int nSpecs = 0, days = -1, threads = cpu_count(); const char* outPath = WHATIF_PATH;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i]; const char* v = (i + 1 < argc ? argv[i + 1] : NULL);
+        if (!strcmp(a, "--whatif")) {}
+        else if (!strcmp(a, "--days") && v) { days = atoi(v); i++; }
+        else if (!strcmp(a, "--threads") && v) { threads = atoi(v); i++; }
+        else if (!strcmp(a, "--branch") && v) { if (nSpecs == SCN_MAX_BRANCHES - 1) { fprintf(stderr, "ERR: at most %d branches\n", SCN_MAX_BRANCHES - 1); return 2; } specs[nSpecs++] = v; i++; }
+        else if (!strcmp(a, "--out") && v) { outPath = v; i++; }
+        else { fprintf(stderr, "ERR: unknown argument %s\n", a); return 2; }
+    }
+    Sim base; sim_init(&base);
+    load_config_txt(&base.cfg, NULL, "config.txt");
+    load_inventory_csv(&base, "inventory.csv");
+    if (!base.cfg.seed) base.cfg.seed = (unsigned long long)time(NULL);
+    base.rngKey = base.cfg.seed;
+    if (load_state(&base, STATE_PATH)) printf("Forking the saved state at day %d.\n", base.day);
+    load_policy_csv(&base, POLICY_PATH);
+    load_demand_csv(&base, DEMAND_PATH);
+    if (days <= 0) days = base.cfg.daysDefault;
+    int rc = whatif(&base, specs, nSpecs, days, threads, outPath);
+    sim_free(&base);
+    return rc;
+}
+
+/* ---------- Server (line-delimited JSON over TCP / a Unix socket) ---------- */
+#define SRV_REQ_SET  0
+#define SRV_REQ_SAVE 1
+#ifdef _WIN32
+static int  sock_startup(void) { WSADATA w; return WSAStartup(MAKEWORD(2, 2), &w) == 0; }
+static void sock_cleanup(void) { WSACleanup(); }
+static void sock_close(mm_socket s) { closesocket(s); }
+static void sock_shutdown(mm_socket s) { shutdown(s, SD_BOTH); }
+#else
+static int  sock_startup(void) { signal(SIGPIPE, SIG_IGN); return 1; }   /* a client that went away is an error return, not a signal */
+static void sock_cleanup(void) {}
+static void sock_close(mm_socket s) { close(s); }
+static void sock_shutdown(mm_socket s) { shutdown(s, SHUT_RDWR); }
+#endif
+static int sock_send_all(mm_socket s, const char* p, size_t n) {
+    while (n > 0) { int k = (int)send(s, p, (int)MIN(n, (size_t)1 << 20), 0); if (k <= 0) return 0; p += k; n -= (size_t)k; }
+    return 1;
+}
+
+static void sb_printf(SrvBuf* B, const char* fmt, ...) {
+    for (;;) {
+        va_list ap; va_start(ap, fmt);
+        int k = vsnprintf(B->p ? B->p + B->n : NULL, B->p ? B->cap - B->n : 0, fmt, ap); va_end(ap);
+        if (k < 0) return;
+        if (B->p && B->n + (size_t)k < B->cap) { B->n += (size_t)k; return; }
+        size_t cap = MAX(B->cap * 2, B->n + (size_t)k + 256); char* np = (char*)realloc(B->p, cap);
+        if (!np) return;
+        B->p = np; B->cap = cap;
+    }
+}
+static void sb_json_str(SrvBuf* B, const char* str) {
+    sb_printf(B, "\"");
+    for (const unsigned char* c = (const unsigned char*)str; *c; c++) {
+        if (*c == '"' || *c == '\\') sb_printf(B, "\\%c", *c);
+        else if (*c < 0x20) sb_printf(B, "\\u%04x", *c);
+        else sb_printf(B, "%c", *c);
+    }
+    sb_printf(B, "\"");
+}
+/* Value of "key" in a flat JSON object (string unescaped, number/literal as written); 0 if absent */
+static int json_field(const char* js, const char* key, char* out, size_t size) {
+    size_t kl = strlen(key);
+    for (const char* p = strchr(js, '"'); p; p = strchr(p + 1, '"')) {
+        if (strncmp(p + 1, key, kl) || p[kl + 1] != '"') continue;
+        const char* v = p + kl + 2; while (isspace((unsigned char)*v)) v++;
+        if (*v != ':') continue;
+        v++; while (isspace((unsigned char)*v)) v++;
+        size_t n = 0;
+        if (*v == '"') {
+            for (v++; *v && *v != '"'; v++) { if (*v == '\\' && v[1]) v++; if (n + 1 < size) out[n++] = *v; }
+        }
+        else while (*v && *v != ',' && *v != '}' && !isspace((unsigned char)*v)) { if (n + 1 < size) out[n++] = *v; v++; }
+        out[n] = '\0'; return 1;
+    }
+    return 0;
+}
+
+/* Reference to the current snapshot (never NULL once serving); pair with snap_release */
+static Snapshot* snap_acquire(Server* V) {
+    mutex_lock(&V->snapMu); Snapshot* n = V->cur; atomic_add(&n->refs, 1); mutex_unlock(&V->snapMu);
+    return n;
+}
+static void snap_release(Snapshot* n) {
+    if (n && atomic_add(&n->refs, -1) == 0) { sim_free(&n->sim); free(n); }
+}
+/* Simulation thread, between days: forks the live state (the catalog is shared until the next day
+   writes it, open POs are copied) and makes it current. last = NULL keeps the previous day's totals. */
+static int srv_publish(Server* V, const DayTotals* last) {
+    Sim* S = V->S; Snapshot* n = (Snapshot*)calloc(1, sizeof(Snapshot)); if (!n) return 0;
+    agg_sync(S);
+    sim_fork(&n->sim, S); n->sim.posFrom = NULL;
+    if (!pobook_clone(&n->sim.pos, &S->pos)) { sim_free(&n->sim); free(n); return 0; }
+    n->refs = 1; n->at = wall_seconds();
+    mutex_lock(&V->snapMu);
+    Snapshot* old = V->cur;
+    if (old) n->epoch = old->epoch + 1;
+    if (last) n->last = *last; else if (old) n->last = old->last;
+    V->cur = n;
+    mutex_unlock(&V->snapMu);
+    snap_release(old);
+    return 1;
+}
+
+/* The K products with the highest key, best first (ties by catalog order): one pass, K <= 1000 */
+static int srv_top(const Catalog* C, int by, int K, int* out) {
+    double key[1000]; int got = 0;
+    for (int i = 0; i < C->n; i++) {
+        double k = (by == 1 ? (double)C->stockouts[i] : by == 2 ? C->revenue[i] : C->revenue[i] - C->cogs[i] - C->ordersCost[i]);
+        if (got == K && k <= key[K - 1]) continue;
+        int j = (got < K ? got++ : K - 1);
+        while (j > 0 && key[j - 1] < k) { key[j] = key[j - 1]; out[j] = out[j - 1]; j--; }
+        key[j] = k; out[j] = i;
+    }
+    return got;
+}
+static void srv_product_json(SrvBuf* B, const Catalog* C, int i) {
+    sb_printf(B, "{\"id\":%d,\"name\":", C->id[i]); sb_json_str(B, cat_name(C, i));
+    sb_printf(B, ",\"price\":%.2f,\"cost\":%.2f,\"stock\":%d,\"on_order\":%d,\"requested\":%lld,\"served\":%lld,\"stockouts\":%lld,\"waste\":%lld,"
+        "\"revenue\":%.2f,\"cogs\":%.2f,\"orders_cost\":%.2f,\"profit\":%.2f,\"policy\":\"%s\",\"shelf_life\":%d",
+        C->price[i], C->baseCost[i], C->stock[i], C->onOrder[i], C->requested[i], C->served[i], C->stockouts[i], C->wasteUnits[i],
+        C->revenue[i], C->cogs[i], C->ordersCost[i], C->revenue[i] - C->cogs[i] - C->ordersCost[i], POLICY_NAMES[C->policy[i]], C->shelfLife[i]);
+    if (C->shelfLife[i] > 0 && !C->lotDirty) {   /* oldest first: [units, last day] */
+        const LotRing* L = &C->lots[i]; sb_printf(B, ",\"lots\":[");
+        for (int k = 0; k < L->count; k++) { int s = (L->head + k) % LOT_CAP; sb_printf(B, "%s[%d,%d]", k ? "," : "", L->qty[s], L->useBy[s]); }
+        sb_printf(B, "]");
+    }
+    sb_printf(B, "}");
+}
+static void srv_totals_json(SrvBuf* B, double revenue, double cogs, double orders, long long req, long long srv, long long sto, long long waste) {
+    sb_printf(B, "{\"revenue\":%.2f,\"cogs\":%.2f,\"orders_cost\":%.2f,\"profit\":%.2f,\"fill_rate\":%.4f,\"stockouts\":%lld,\"waste\":%lld}",
+        revenue, cogs, orders, revenue - cogs - orders, req > 0 ? (double)srv / (double)req : 1.0, sto, waste);
+}
+/* Read requests: answered from one snapshot, without touching the live simulation */
+static int srv_read(Server* V, const char* cmd, const char* line, SrvBuf* B) {
+    char arg[128];
+    if (strcmp(cmd, "status") && strcmp(cmd, "kpi") && strcmp(cmd, "top") && strcmp(cmd, "product") && strcmp(cmd, "pos") && strcmp(cmd, "config")) return 0;
+    Snapshot* n = snap_acquire(V); const Sim* S = &n->sim; const Catalog* C = &S->cat;
+    int i = -1;
+    if (!strcmp(cmd, "product") && (json_field(line, "id", arg, sizeof(arg)) || json_field(line, "name", arg, sizeof(arg)))) i = scn_product(C, arg);
+    if (!strcmp(cmd, "product") && i < 0) { sb_printf(B, "{\"ok\":false,\"error\":\"unknown product\"}"); snap_release(n); return 1; }
+    sb_printf(B, "{\"ok\":true,\"day\":%d,\"epoch\":%lld", S->day, n->epoch);
+    if (!strcmp(cmd, "status")) {
+        mutex_lock(&V->mu); long long queued = V->queued + V->running; mutex_unlock(&V->mu);
+        sb_printf(B, ",\"products\":%d,\"open_pos\":%d,\"queued_days\":%lld,\"clients\":%ld,\"snapshot_age_ms\":%.1f}",
+            C->n, S->pos.count, queued, atomic_add(&V->clients, 0), (wall_seconds() - n->at) * 1e3);
+    }
+    else if (!strcmp(cmd, "kpi")) {
+        const Aggregates* A = &S->agg; const DayTotals* D = &n->last;
+        sb_printf(B, ",\"totals\":"); srv_totals_json(B, A->revenue, A->cogs, A->ordersCost, A->requested, A->served, A->stockouts, A->wasteUnits);
+        sb_printf(B, ",\"last_day\":"); srv_totals_json(B, D->revenue, D->cogs, D->ordersCost, D->requested, D->served, D->stockouts, D->wasteUnits);
+        sb_printf(B, "}");
+    }
+    else if (!strcmp(cmd, "top")) {
+        int by = 0, K = 5, top[1000];
+        if (json_field(line, "by", arg, sizeof(arg))) by = (!strcmp(arg, "stockouts") ? 1 : !strcmp(arg, "revenue") ? 2 : 0);
+        if (json_field(line, "k", arg, sizeof(arg))) K = MAX(1, MIN(atoi(arg), 1000));
+        K = srv_top(C, by, K, top);
+        sb_printf(B, ",\"by\":\"%s\",\"products\":[", by == 1 ? "stockouts" : by == 2 ? "revenue" : "profit");
+        for (int k = 0; k < K; k++) { if (k) sb_printf(B, ","); srv_product_json(B, C, top[k]); }
+        sb_printf(B, "]}");
+    }
+    else if (!strcmp(cmd, "product")) { sb_printf(B, ",\"product\":"); srv_product_json(B, C, i); sb_printf(B, "}"); }
+    else if (!strcmp(cmd, "pos")) {
+        int limit = 100, only = -1, k = 0;
+        if (json_field(line, "limit", arg, sizeof(arg))) limit = MAX(0, atoi(arg));
+        if (json_field(line, "id", arg, sizeof(arg)) && (only = scn_product(C, arg)) < 0) only = -2;
+        sb_printf(B, ",\"count\":%d,\"pos\":[", S->pos.count);
+        for (PO* p = pobook_next(&S->pos, S->day, NULL); p && k < limit; p = pobook_next(&S->pos, S->day, p)) {
+            if (only != -1 && p->productIndex != only) continue;
+            sb_printf(B, "%s{\"po\":%d,\"id\":%d,\"name\":", k++ ? "," : "", p->poId, C->id[p->productIndex]); sb_json_str(B, cat_name(C, p->productIndex));
+            sb_printf(B, ",\"qty\":%d,\"due\":%d,\"days_left\":%d}", p->qty, p->dueDay, MAX(p->dueDay - S->day, 0));
+        }
+        sb_printf(B, "]}");
+    }
+    else {
+        char text[4096]; config_to_text(&S->cfg, text, sizeof(text));
+        sb_printf(B, ",\"config\":{");
+        int first = 1;
+        for (char* ln = text, * nl; *ln; ln = nl + 1) {   /* not strtok: clients are served from several threads */
+            if (!(nl = strchr(ln, '\n'))) break;
+            *nl = '\0'; char* eq = strchr(ln, '='); if (!eq) continue;
+            char* end; *eq = '\0'; strtod(eq + 1, &end);
+            sb_printf(B, "%s\"%s\":", first ? "" : ",", ln); first = 0;
+            if (end != eq + 1 && !*end) sb_printf(B, "%s", eq + 1); else sb_json_str(B, eq + 1);   /* numbers as numbers */
+        }
+        sb_printf(B, "}}");
+    }
+    snap_release(n);
+    return 1;
+}
+/* Queues a change for the simulation thread and waits until it was applied between two days */
+static int srv_request(Server* V, int type, const char* line) {
+    SrvRequest r; memset(&r, 0, sizeof(r)); r.type = type; snprintf(r.line, sizeof(r.line), "%s", line);
+    mutex_lock(&V->mu);
+    if (V->reqTail) V->reqTail->next = &r; else V->reqHead = &r;
+    V->reqTail = &r; cond_signal(&V->cvWork);
+    while (!r.done && (r.taken || !V->stop)) cond_wait(&V->cvDone, &V->mu);
+    int ok = r.done && r.ok;
+    if (!r.done) {   /* stopping while still queued: unlink it before the stack frame goes away */
+        SrvRequest** pp = &V->reqHead; SrvRequest* prev = NULL;
+        while (*pp && *pp != &r) { prev = *pp; pp = &(*pp)->next; }
+        if (*pp) { *pp = r.next; if (V->reqTail == &r) V->reqTail = prev; }
+    }
+    mutex_unlock(&V->mu);
+    return ok;
+}
+/* One request line -> one response line (without the newline) */
+static void srv_handle(Server* V, const char* line, SrvBuf* B) {
+    char cmd[32], arg[256];
+    if (!json_field(line, "cmd", cmd, sizeof(cmd))) { sb_printf(B, "{\"ok\":false,\"error\":\"expected {\\\"cmd\\\":...}\"}"); return; }
+    if (srv_read(V, cmd, line, B)) return;
+    if (!strcmp(cmd, "step") || !strcmp(cmd, "run")) {
+        long long days = 1; int wait = !strcmp(cmd, "step");
+        if (json_field(line, "days", arg, sizeof(arg))) days = atoll(arg);
+        if (json_field(line, "wait", arg, sizeof(arg))) wait = !strcmp(arg, "true") || !strcmp(arg, "1");
+        if (days <= 0) { sb_printf(B, "{\"ok\":false,\"error\":\"days must be positive\"}"); return; }
+        mutex_lock(&V->mu);
+        V->queued += days; long long until = V->dayDone + V->running + V->queued;
+        cond_signal(&V->cvWork);
+        while (wait && !V->stop && V->dayDone < until && (V->queued > 0 || V->running)) cond_wait(&V->cvDone, &V->mu);
+        int day = V->dayDone; long long queued = V->queued + V->running;
+        mutex_unlock(&V->mu);
+        if (wait) sb_printf(B, "{\"ok\":true,\"day\":%d,\"queued_days\":%lld}", day, queued);
+        else sb_printf(B, "{\"ok\":true,\"until\":%lld,\"queued_days\":%lld}", until, queued);
+    }
+    else if (!strcmp(cmd, "stop")) {
+        mutex_lock(&V->mu); long long n = V->queued; V->queued = 0; int day = V->dayDone + V->running; mutex_unlock(&V->mu);
+        sb_printf(B, "{\"ok\":true,\"cancelled_days\":%lld,\"stops_at\":%d}", n, day);
+    }
+    else if (!strcmp(cmd, "set")) {
+        char key[64], val[160], kv[256];
+        if (!json_field(line, "key", key, sizeof(key)) || !json_field(line, "value", val, sizeof(val))) { sb_printf(B, "{\"ok\":false,\"error\":\"set needs key and value\"}"); return; }
+        snprintf(kv, sizeof(kv), "%s=%s", key, val);
+        if (srv_request(V, SRV_REQ_SET, kv)) sb_printf(B, "{\"ok\":true}");
+        else { sb_printf(B, "{\"ok\":false,\"error\":\"unknown setting\",\"key\":"); sb_json_str(B, key); sb_printf(B, "}"); }
+    }
+    else if (!strcmp(cmd, "save")) {
+        if (srv_request(V, SRV_REQ_SAVE, "")) sb_printf(B, "{\"ok\":true,\"path\":\"%s\"}", STATE_PATH);
+        else sb_printf(B, "{\"ok\":false,\"error\":\"cannot write %s\"}", STATE_PATH);
+    }
+    else if (!strcmp(cmd, "shutdown")) {
+        mutex_lock(&V->mu); V->stop = 1; cond_broadcast(&V->cvWork); cond_broadcast(&V->cvDone); mutex_unlock(&V->mu);
+        sb_printf(B, "{\"ok\":true}");
+    }
+    else { sb_printf(B, "{\"ok\":false,\"error\":\"unknown cmd\",\"cmd\":"); sb_json_str(B, cmd); sb_printf(B, "}"); }
+}
+THREAD_FN(srv_client_main, arg) {
+    SrvClient* c = (SrvClient*)arg; Server* V = c->srv;
+    char buf[SRV_LINE_MAX]; size_t have = 0; int skip = 0; SrvBuf out = { NULL, 0, 0 };
+    for (;;) {
+        int got = (int)recv(c->fd, buf + have, (int)(sizeof(buf) - 1 - have), 0);
+        if (got <= 0) break;
+        have += (size_t)got; buf[have] = '\0';
+        char* start = buf, * nl; int ok = 1;
+        if (skip) {   /* rest of a line already answered with "line too long" */
+            if ((nl = strchr(buf, '\n')) == NULL) { have = 0; continue; }
+            start = nl + 1; skip = 0;
+        }
+        while (ok && (nl = strchr(start, '\n')) != NULL) {
+            *nl = '\0'; if (nl > start && nl[-1] == '\r') nl[-1] = '\0';
+            if (*start) { out.n = 0; srv_handle(V, start, &out); sb_printf(&out, "\n"); ok = out.p && sock_send_all(c->fd, out.p, out.n); }
+            start = nl + 1;
+        }
+        if (!ok) break;
+        have -= (size_t)(start - buf); memmove(buf, start, have);
+        if (have == sizeof(buf) - 1) { const char* e = "{\"ok\":false,\"error\":\"line too long\"}\n"; if (!sock_send_all(c->fd, e, strlen(e))) break; have = 0; skip = 1; }
+    }
+    sock_close(c->fd); free(out.p);
+    atomic_add(&V->clients, -1); atomic_add(&c->done, 1);
+    THREAD_RETURN;
+}
+static int srv_stopping(Server* V) {
+    mutex_lock(&V->mu);
+    if (G_cancel && !V->stop) { V->stop = 1; cond_broadcast(&V->cvWork); cond_broadcast(&V->cvDone); }   /* Ctrl+C */
+    int stop = V->stop; mutex_unlock(&V->mu);
+    return stop;
+}
+/* Accepts connections (one thread each); polls so that it notices stop and Ctrl+C */
+THREAD_FN(srv_accept_main, arg) {
+    Server* V = (Server*)arg;
+    while (!srv_stopping(V)) {
+        fd_set rd; FD_ZERO(&rd); FD_SET(V->listenFd, &rd);
+        struct timeval tv = { 0, 200000 };
+        if (select((int)V->listenFd + 1, &rd, NULL, NULL, &tv) <= 0) continue;
+        mm_socket fd = accept(V->listenFd, NULL, NULL); if (fd == MM_BAD_SOCKET) continue;
+        SrvClient* slot = NULL;
+        for (int k = 0; k < SRV_MAX_CLIENTS; k++) {
+            SrvClient* c = &V->client[k];
+            if (c->used && atomic_add(&c->done, 0)) { thread_join(c->t); c->used = 0; }
+            if (!c->used && !slot) slot = c;
+        }
+        if (!slot) { const char* e = "{\"ok\":false,\"error\":\"too many clients\"}\n"; sock_send_all(fd, e, strlen(e)); sock_close(fd); continue; }
+        slot->srv = V; slot->fd = fd; slot->done = 0; slot->used = 1; atomic_add(&V->clients, 1);
+        if (!thread_start(&slot->t, srv_client_main, slot)) { slot->used = 0; atomic_add(&V->clients, -1); sock_close(fd); }
+    }
+    THREAD_RETURN;
+}
+static mm_socket srv_listen(const char* bindAddr, int port, const char* unixPath) {
+    mm_socket fd = MM_BAD_SOCKET;
+    if (unixPath) {
+#ifdef _WIN32
+        fprintf(stderr, "ERR: --unix is not available on Windows (use --port)\n"); return MM_BAD_SOCKET;
+#else
+        struct sockaddr_un a; memset(&a, 0, sizeof(a)); a.sun_family = AF_UNIX;
+        if (strlen(unixPath) >= sizeof(a.sun_path)) { fprintf(stderr, "ERR: socket path too long\n"); return MM_BAD_SOCKET; }
+        strcpy(a.sun_path, unixPath); unlink(unixPath);
+        if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == MM_BAD_SOCKET) return fd;
+        if (bind(fd, (struct sockaddr*)&a, sizeof(a)) != 0 || listen(fd, 16) != 0) { sock_close(fd); return MM_BAD_SOCKET; }
+        printf("Listening on %s\n", unixPath);
+#endif
+        return fd;
+    }
+    struct sockaddr_in a; memset(&a, 0, sizeof(a)); a.sin_family = AF_INET; a.sin_port = htons((unsigned short)port);
+    if (inet_pton(AF_INET, bindAddr, &a.sin_addr) != 1) { fprintf(stderr, "ERR: bad --bind address %s\n", bindAddr); return MM_BAD_SOCKET; }
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == MM_BAD_SOCKET) return fd;
+    int yes = 1; setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+    if (bind(fd, (struct sockaddr*)&a, sizeof(a)) != 0 || listen(fd, 16) != 0) { sock_close(fd); return MM_BAD_SOCKET; }
+    socklen_t len = sizeof(a); getsockname(fd, (struct sockaddr*)&a, &len);   /* port 0 -> the one picked */
+    printf("Listening on %s:%d\n", bindAddr, ntohs(a.sin_port));
+    return fd;
+}
+/* Serves S until a shutdown request or Ctrl+C. This (the calling) thread is the only one that runs
+   days and changes S; reads never wait for a day to finish. Saves the state at the end. */
+static int serve(Sim* S, const char* bindAddr, int port, const char* unixPath) {
+    Server* V = (Server*)calloc(1, sizeof(Server)); if (!V) { puts("OOM"); return 1; }
+    if (!sock_startup()) { fprintf(stderr, "ERR: sockets unavailable\n"); free(V); return 1; }
+    V->S = S; V->dayDone = S->day;
+    mutex_init(&V->mu); mutex_init(&V->snapMu); cond_init(&V->cvWork); cond_init(&V->cvDone);
+    int rc = 1;
+    if (!srv_publish(V, NULL)) { puts("OOM"); goto done; }
+    if ((V->listenFd = srv_listen(bindAddr, port, unixPath)) == MM_BAD_SOCKET) { fprintf(stderr, "ERR: cannot listen\n"); goto done; }
+    if (unixPath) snprintf(V->unixPath, sizeof(V->unixPath), "%s", unixPath);
+    G_cancel = 0; signal(SIGINT, ff_on_sigint);
+    if (!thread_start(&V->acceptor, srv_accept_main, V)) { sock_close(V->listenFd); goto done; }
+    puts("Serving (line-delimited JSON; {\"cmd\":\"shutdown\"} or Ctrl+C to stop)."); fflush(stdout);
+
+    mutex_lock(&V->mu);
+    while (!V->stop) {
+        if (V->reqHead) {
+            SrvRequest* r = V->reqHead; V->reqHead = r->next; if (!V->reqHead) V->reqTail = NULL;
+            r->taken = 1; mutex_unlock(&V->mu);   /* completed below even if stop is set meanwhile */
+            if (r->type == SRV_REQ_SET) { r->ok = config_apply_line(&S->cfg, NULL, r->line); if (r->ok) srv_publish(V, NULL); }
+            else r->ok = save_state(S, STATE_PATH);
+            mutex_lock(&V->mu); r->done = 1; cond_broadcast(&V->cvDone);
+        }
+        else if (V->queued > 0) {
+            V->queued--; V->running = 1; mutex_unlock(&V->mu);
+            DayTotals D; simulate_day(S, &D);
+            if (!srv_publish(V, &D)) puts("OOM");
+            mutex_lock(&V->mu); V->running = 0; V->dayDone = S->day; cond_broadcast(&V->cvDone);
+        }
+        else cond_wait(&V->cvWork, &V->mu);
+    }
+    mutex_unlock(&V->mu);
+    rc = 0;
+    thread_join(V->acceptor); sock_close(V->listenFd);
+    for (int k = 0; k < SRV_MAX_CLIENTS; k++) if (V->client[k].used) { sock_shutdown(V->client[k].fd); thread_join(V->client[k].t); }
+#ifndef _WIN32
+    if (V->unixPath[0]) unlink(V->unixPath);
+#endif
+    signal(SIGINT, SIG_DFL);
+    printf("Stopped at day %d.\n", S->day);
+done:
+    snap_release(V->cur);
+    mutex_destroy(&V->mu); mutex_destroy(&V->snapMu); cond_destroy(&V->cvWork); cond_destroy(&V->cvDone);
+    sock_cleanup(); free(V);
+    return rc;
+}
+/* Usage: --serve [--port 7070] [--bind 127.0.0.1] [--unix /tmp/minimarket.sock]
+   Same session as the menu (config.txt, inventory.csv, saved state, log, journal); one JSON object per
+   line in each direction, e.g. {"cmd":"run","days":365} then {"cmd":"kpi"} (see README) */
+static int headless_serve(int argc, char** argv) {
+    int port = SRV_PORT; const char* bindAddr = "127.0.0.1", * unixPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i]; const char* v = (i + 1 < argc ? argv[i + 1] : NULL);
+        if (!strcmp(a, "--serve")) {}
+        else if (!strcmp(a, "--port") && v) { port = atoi(v); i++; }
+        else if (!strcmp(a, "--bind") && v) { bindAddr = v; i++; }
+        else if (!strcmp(a, "--unix") && v) { unixPath = v; i++; }
+        else { fprintf(stderr, "ERR: unknown argument %s\n", a); return 2; }
+    }
+    Sim* S = &G_sim; sim_init(S);
+    open_session(S);
+    int rc = serve(S, bindAddr, port, unixPath);
+    if (!save_state(S, STATE_PATH)) fprintf(stderr, "ERR: cannot write %s\n", STATE_PATH);
+    close_single_log(S); journal_close(S->jnl); S->jnl = NULL; sim_free(S);
+    return rc;
+}
+
+/* Usage: --log-to-csv out.csv | --query METRIC ... (see headless_query) | --fast-forward N [--no-log]
+        | --optimize ... (see headless_optimize) | --stores N ... (see headless_network) | --intraday ... (see headless_intraday)
+        | --whatif ... (see headless_whatif) | --serve ... (see headless_serve) | --reps N ... (see headless_replicate) */
+static int run_command_line(int argc, char** argv) {
+    if (!strcmp(argv[1], "--log-to-csv")) return log_binary_to_csv(argc > 2 ? argv[2] : LOG_PATH);
+    if (!strcmp(argv[1], "--query")) return headless_query(argc, argv);
+    if (!strcmp(argv[1], "--fast-forward")) return headless_fast_forward(argc, argv);
+    for (int i = 1; i < argc; i++) if (!strcmp(argv[i], "--optimize")) return headless_optimize(argc, argv);
+    for (int i = 1; i < argc; i++) if (!strcmp(argv[i], "--stores")) return headless_network(argc, argv);
+    for (int i = 1; i < argc; i++) if (!strcmp(argv[i], "--intraday")) return headless_intraday(argc, argv);
+    for (int i = 1; i < argc; i++) if (!strcmp(argv[i], "--whatif")) return headless_whatif(argc, argv);
+    for (int i = 1; i < argc; i++) if (!strcmp(argv[i], "--serve")) return headless_serve(argc, argv);
+    return headless_replicate(argc, argv);
+}
+
+#ifdef MINIMARKET_BENCH
+/* ---------- Benchmarks (build with -DMINIMARKET_BENCH) ---------- */
+typedef struct { char name[96]; char unit[16]; double value; int higherBetter; } BenchResult;
+typedef struct { BenchResult* r; int n, cap; double minTime; int quick; } Bench;
+static volatile long long bench_sink;   /* keeps measured work from being optimized away */
+
+static int bench_push(Bench* B, const char* name, const char* unit, double value, int higherBetter) {
+    if (B->n == B->cap) {
+        int cap = B->cap ? B->cap * 2 : 64; BenchResult* nr = (BenchResult*)realloc(B->r, sizeof(BenchResult) * cap);
+        if (!nr) { puts("OOM"); return 0; }
+        B->r = nr; B->cap = cap;
+    }
+    BenchResult* r = &B->r[B->n++];
+    snprintf(r->name, sizeof(r->name), "%s", name); snprintf(r->unit, sizeof(r->unit), "%s", unit);
+    r->value = value; r->higherBetter = higherBetter; return 1;
+}
+static void bench_add(Bench* B, const char* name, const char* unit, double value, int higherBetter) {
+    if (bench_push(B, name, unit, value, higherBetter)) { printf("%-36s %16.4g %s\n", name, value, unit); fflush(stdout); }
+}
+/* Synthetic catalog: n SKUs, every third perishable, prices from a fixed seed */
+static void bench_sim(Sim* S, int n) {
+    sim_init(S); S->cfg.seed = 1; S->rngKey = 1; S->verbose = 0;
+    unsigned long long x = 12345; char name[32];
+    for (int i = 0; i < n; i++) {
+        double bc = 1.0 + (double)(splitmix64(&x) % 4000) / 100.0;
+        snprintf(name, sizeof(name), "SKU %d", i);
+        if (cat_add(&S->cat, 100000 + i, name, bc, bc * 1.4, 20 + (int)(splitmix64(&x) % 60), (i % 3 == 0 ? PERISHABLE : 0)) < 0) { puts("OOM"); return; }
+    }
+}
+static void bench_poisson(Bench* B) {
+    static const double lambdas[] = { 0.5, 2.0, 5.0, 9.9, 10.0, 30.0, 100.0, 1000.0 };
+    char name[96];
+    for (int k = 0; k < (int)(sizeof(lambdas) / sizeof(lambdas[0])); k++) {
+        double best = 0;
+        for (int rep = 0; rep < 3; rep++) {
+            Rng r; rng_init(&r, 42, (unsigned)rep, RNG_DEMAND, 1);
+            long long draws = 0, sum = 0; double t0 = wall_seconds(), t;
+            do { for (int i = 0; i < 4096; i++) sum += sample_poisson(&r, lambdas[k]); draws += 4096; } while ((t = wall_seconds() - t0) < B->minTime);
+            bench_sink += sum; best = MAX(best, draws / t);
+        }
+        snprintf(name, sizeof(name), "poisson.lambda=%g", lambdas[k]); bench_add(B, name, "draws/s", best, 1);
+    }
+}
+static void bench_pobook(Bench* B) {
+    static const int sizes[] = { 1000, 10000, 100000, 1000000 };
+    char name[96];
+    for (int k = 0; k < 4; k++) {
+        int N = sizes[k]; if (B->quick && N > 100000) break;
+        double bestIns = 0, bestPop = 0, bestNext = 0, bestQry = 0;
+        for (int rep = 0; rep < 3; rep++) {
+            Sim S; bench_sim(&S, 1000); unsigned long long x = 99; int ok = 1;
+            double t0 = wall_seconds();
+            for (int i = 0; i < N && ok; i++) {
+                int due = 1 + (int)(splitmix64(&x) % 30);
+                PO* node = po_create(&S, i % S.cat.n, 10, due, due);
+                if (!node || !pobook_add(&S.pos, &S.cat, 0, node)) { pobook_release(&S.pos, node); ok = 0; }
+            }
+            double tIns = wall_seconds() - t0;
+            long long qsum = 0; unsigned int idx = 1; t0 = wall_seconds();
+            for (int i = 0; i < 4 * N; i++) { idx = idx * 1664525u + 1013904223u; qsum += S.cat.stock[idx % S.cat.n] + S.cat.onOrder[idx % S.cat.n]; }
+            double tQry = wall_seconds() - t0;
+            long long seen = 0; t0 = wall_seconds();
+            for (PO* p = pobook_next(&S.pos, 0, NULL); p; p = pobook_next(&S.pos, 0, p)) seen += p->qty;
+            double tNext = wall_seconds() - t0;
+            long long popped = 0; t0 = wall_seconds();
+            for (int day = 1; day <= 31; day++) { PO* a = pobook_pop_due(&S.pos, &S.cat, day); for (PO* p = a; p; p = p->next) popped++; pobook_release(&S.pos, a); }
+            double tPop = wall_seconds() - t0;
+            bench_sink += qsum + seen + popped;
+            if (ok) { bestIns = MAX(bestIns, N / tIns); bestQry = MAX(bestQry, 4.0 * N / tQry); bestNext = MAX(bestNext, N / tNext); bestPop = MAX(bestPop, popped / tPop); }
+            sim_free(&S);
+        }
+        snprintf(name, sizeof(name), "pobook.insert.n=%d", N); bench_add(B, name, "ops/s", bestIns, 1);
+        snprintf(name, sizeof(name), "pobook.pop.n=%d", N); bench_add(B, name, "ops/s", bestPop, 1);
+        snprintf(name, sizeof(name), "pobook.iterate.n=%d", N); bench_add(B, name, "ops/s", bestNext, 1);
+        snprintf(name, sizeof(name), "pobook.onorder.n=%d", N); bench_add(B, name, "ops/s", bestQry, 1);
+    }
+}
+/* Days per second of simulate_day(), after a short warm-up so POs are in flight */
+static double bench_days(Bench* B, Sim* S) {
+    for (int d = 0; d < 5; d++) simulate_day(S, NULL);
+    double best = 0;
+    for (int rep = 0; rep < 3; rep++) {
+        int days = 0; double t0 = wall_seconds(), t;
+        do { simulate_day(S, NULL); days++; } while ((t = wall_seconds() - t0) < B->minTime);
+        best = MAX(best, days / t);
+    }
+    return best;
+}
+static void bench_simulate_day(Bench* B) {
+    static const int sizes[] = { 100, 1000, 10000, 100000, 1000000 };
+    char name[96];
+    for (int k = 0; k < 5; k++) {
+        if (B->quick && sizes[k] > 100000) break;
+        Sim S; bench_sim(&S, sizes[k]);
+        snprintf(name, sizeof(name), "simulate_day.n=%d", sizes[k]); bench_add(B, name, "days/s", bench_days(B, &S), 1);
+        long long h0 = sim_heap_allocs(&S);   /* 0 once the PO pool holds the peak of open POs */
+        for (int d = 0; d < 10; d++) simulate_day(&S, NULL);
+        snprintf(name, sizeof(name), "simulate_day.heap_allocs.n=%d", sizes[k]); bench_add(B, name, "allocs/day", (sim_heap_allocs(&S) - h0) / 10.0, 0);
+        if (sizes[k] == 100000) {   /* a weekday curve: the sampler's exp(-lambda) is redone every day */
+            static const double week[7] = { 0.8, 0.9, 0.9, 1.0, 1.1, 1.4, 1.3 };
+            memcpy(S.cfg.seasonWeek, week, sizeof(week));
+            snprintf(name, sizeof(name), "simulate_day.seasonal.n=%d", sizes[k]); bench_add(B, name, "days/s", bench_days(B, &S), 1);
+            for (int d = 0; d < 7; d++) S.cfg.seasonWeek[d] = 1.0;   /* every SKU dated: sales and ageing walk all the rings */
+            for (int i = 0; i < S.cat.n; i++) S.cat.shelfLife[i] = 4 + i % 5;
+            S.cat.lotDirty = 1;
+            snprintf(name, sizeof(name), "simulate_day.lots.n=%d", sizes[k]); bench_add(B, name, "days/s", bench_days(B, &S), 1);
+        }
+        sim_free(&S);
+    }
+}
+/* forecast_update() over the whole catalog (Holt-Winters, the most work per SKU) in SKUs/s, and whole
+   days with every SKU on the forecast policy (compare with simulate_day.n=N) */
+static void bench_forecast(Bench* B) {
+    static const int sizes[] = { 10000, 100000, 1000000 };
+    char name[96];
+    for (int k = 0; k < 3; k++) {
+        int N = sizes[k]; if (B->quick && N > 100000) break;
+        Sim S; bench_sim(&S, N); S.cfg.fcModel = FC_HW; S.cfg.defaultPolicy = POL_FORECAST;
+        int* y = (int*)malloc(sizeof(int) * N); unsigned long long x = 5;
+        if (!y) { puts("OOM"); sim_free(&S); return; }
+        for (int i = 0; i < N; i++) y[i] = (int)(splitmix64(&x) % 12);
+        double best = 0;
+        for (int rep = 0; rep < 3; rep++) {
+            long long passes = 0; double t0 = wall_seconds(), t;
+            do { S.day++; forecast_update(&S, y); passes++; } while ((t = wall_seconds() - t0) < B->minTime);
+            best = MAX(best, (double)passes * N / t);
+        }
+        bench_sink += (long long)S.cat.fcLevel[N - 1]; free(y);
+        snprintf(name, sizeof(name), "forecast.update.n=%d", N); bench_add(B, name, "SKUs/s", best, 1);
+        snprintf(name, sizeof(name), "simulate_day.forecast.n=%d", N); bench_add(B, name, "days/s", bench_days(B, &S), 1);
+        sim_free(&S);
+    }
+}
+/* sim_fork() + sim_free() of a whole simulation, and the first day of a fork (which copies the columns it writes) */
+static void bench_fork(Bench* B) {
+    static const int sizes[] = { 10000, 100000, 1000000 };
+    char name[96];
+    for (int k = 0; k < 3; k++) {
+        int N = sizes[k]; if (B->quick && N > 100000) break;
+        Sim S, F; bench_sim(&S, N); simulate_day(&S, NULL);
+        double best = 0;
+        for (int rep = 0; rep < 3; rep++) {
+            long long forks = 0; double t0 = wall_seconds(), t;
+            do { sim_fork(&F, &S); sim_free(&F); forks++; } while ((t = wall_seconds() - t0) < B->minTime);
+            best = MAX(best, forks / t);
+        }
+        snprintf(name, sizeof(name), "fork.n=%d", N); bench_add(B, name, "forks/s", best, 1);
+        best = 0;
+        for (int rep = 0; rep < 3; rep++) {
+            double t0 = wall_seconds(); sim_fork(&F, &S); simulate_day(&F, NULL);
+            best = MAX(best, 1.0 / (wall_seconds() - t0)); sim_free(&F);
+        }
+        snprintf(name, sizeof(name), "fork.first_day.n=%d", N); bench_add(B, name, "days/s", best, 1);
+        sim_free(&S);
+    }
+}
+static void bench_logging(Bench* B) {
+    static const int formats[] = { LOG_FMT_CSV, LOG_FMT_BINARY };
+    char name[96]; int n = 10000;
+    for (int k = 0; k < 2; k++) {
+        Sim S; bench_sim(&S, n);
+        for (int d = 0; d < 5; d++) simulate_day(&S, NULL);
+        S.log = log_open(formats[k], 1, 1, &S.cat);
+        if (!S.log) { sim_free(&S); continue; }
+        int days = 0; double t0 = wall_seconds(), t;
+        do { simulate_day(&S, NULL); days++; } while (wall_seconds() - t0 < B->minTime);
+        long long bytes = S.log->bytes;
+        log_close(S.log); S.log = NULL; t = wall_seconds() - t0;   /* includes draining the writer */
+        const char* fmt = (formats[k] == LOG_FMT_CSV ? "csv" : "binary");
+        snprintf(name, sizeof(name), "log.%s.rows", fmt); bench_add(B, name, "rows/s", (double)days * n / t, 1);
+        snprintf(name, sizeof(name), "log.%s.bytes", fmt); bench_add(B, name, "MB/s", bytes / t / 1e6, 1);
+        sim_free(&S);
+    }
+    remove(LOG_PATH); remove(LOG_SALE_PATH); remove(LOG_ORDER_PATH); remove(LOG_DAILY_PATH); remove(LOG_NAMES_PATH);
+}
+static void bench_state(Bench* B) {
+    static const int sizes[] = { 1000, 100000, 1000000 };
+    char name[96];
+    for (int k = 0; k < 3; k++) {
+        if (B->quick && sizes[k] > 100000) break;
+        Sim S; bench_sim(&S, sizes[k]);
+        for (int d = 0; d < 5; d++) simulate_day(&S, NULL);
+        double bestSave = 1e30, bestLoad = 1e30;
+        for (int rep = 0; rep < 3; rep++) {
+            double t0 = wall_seconds(); int ok = save_state(&S, STATE_PATH); double t = wall_seconds() - t0;
+            if (ok) bestSave = MIN(bestSave, t);
+            Sim L; sim_init(&L); t0 = wall_seconds(); ok = load_state(&L, STATE_PATH); t = wall_seconds() - t0;
+            if (ok) bestLoad = MIN(bestLoad, t);
+            sim_free(&L);
+        }
+        snprintf(name, sizeof(name), "state.save.n=%d", sizes[k]); bench_add(B, name, "ms", bestSave * 1e3, 0);
+        snprintf(name, sizeof(name), "state.load.n=%d", sizes[k]); bench_add(B, name, "ms", bestLoad * 1e3, 0);
+        sim_free(&S);
+    }
+    remove(STATE_PATH); remove(JOURNAL_PATH);
+}
+/* One result per line, so bench_load() can read it back without a JSON parser */
+static int bench_write_json(const Bench* B, const char* path) {
+    FILE* f = mm_fopen(path, "w"); if (!f) return 0;
+#if defined(__AVX512F__)
+    const char* simd = "avx512";
+#elif defined(__AVX2__)
+    const char* simd = "avx2";
+#else
+    const char* simd = "scalar";
+#endif
+    fprintf(f, "{\n  \"suite\": \"minimarket\",\n  \"version\": 1,\n  \"simd\": \"%s\",\n  \"cpus\": %d,\n  \"quick\": %d,\n  \"results\": [\n", simd, cpu_count(), B->quick);
+    for (int i = 0; i < B->n; i++)
+        fprintf(f, "    {\"name\": \"%s\", \"unit\": \"%s\", \"value\": %.6g, \"better\": \"%s\"}%s\n", B->r[i].name, B->r[i].unit, B->r[i].value,
+            B->r[i].higherBetter ? "higher" : "lower", i + 1 < B->n ? "," : "");
+    fprintf(f, "  ]\n}\n");
+    fclose(f); return 1;
+}
+static int bench_load(Bench* B, const char* path) {
+    FILE* f = mm_fopen(path, "r"); if (!f) return 0;
+    char line[512], name[96], unit[16], better[8]; double v;
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, " {\"name\": \"%95[^\"]\", \"unit\": \"%15[^\"]\", \"value\": %lf, \"better\": \"%7[^\"]\"", name, unit, &v, better) == 4)
+            bench_push(B, name, unit, v, !strcmp(better, "higher"));
+    fclose(f); return 1;
+}
+/* Change in percent, positive = better; returns the number of results worse than -threshold */
+static int bench_compare(const Bench* cur, const Bench* base, double threshold) {
+    int regressions = 0;
+    printf("\n%-36s %14s %14s %9s\n", "Benchmark", "Baseline", "Current", "Change");
+    for (int i = 0; i < cur->n; i++) {
+        const BenchResult* c = &cur->r[i]; const BenchResult* b = NULL;
+        for (int j = 0; j < base->n && !b; j++) if (!strcmp(base->r[j].name, c->name)) b = &base->r[j];
+        if (b && !c->higherBetter && b->value == 0 && c->value >= 0) {   /* counts that should stay at zero */
+            int bad = c->value > 0; regressions += bad;
+            printf("%-36s %14.4g %14.4g %9s%s\n", c->name, b->value, c->value, bad ? "" : "=", bad ? "  REGRESSION" : ""); continue;
+        }
+        if (!b || b->value <= 0 || c->value <= 0) { printf("%-36s %14s %14.4g %9s\n", c->name, "-", c->value, "new"); continue; }
+        double change = (c->higherBetter ? c->value / b->value : b->value / c->value) * 100.0 - 100.0;
+        int bad = change < -threshold; regressions += bad;
+        printf("%-36s %14.4g %14.4g %+8.1f%%%s\n", c->name, b->value, c->value, change, bad ? "  REGRESSION" : "");
+    }
+    printf("%d regression(s) beyond %.0f%%\n", regressions, threshold);
+    return regressions;
+}
+/* Timing wheel, hold model: N pending; pop the earliest event and push one 1..span ms later
+   (span 1 s ~ customer arrivals, 1 h ~ restocks and deliveries) */
+static void bench_wheel(Bench* B) {
+    static const int sizes[] = { 1000, 100000, 1000000 };
+    static const unsigned int spans[] = { 1000, ID_MS_PER_HOUR };
+    char name[96];
+    for (int k = 0; k < 3; k++) for (int sp = 0; sp < 2; sp++) {
+        int N = sizes[k]; unsigned int span = spans[sp]; if (B->quick && N > 100000) break;
+        double best = 0;
+        for (int rep = 0; rep < 3; rep++) {
+            TimingWheel W; tw_init(&W); unsigned long long x = 7; int ok = 1;
+            #define BW_DELAY() ((unsigned int)(((splitmix64(&x) >> 32) * span) >> 32))
+            for (int i = 0; i < N && ok; i++) ok = tw_push(&W, BW_DELAY(), 0, i);
+            long long ops = 0; TwEvent ev; double t0 = wall_seconds(), t;
+            do {
+                for (int i = 0; i < 4096 && ok; i++) ok = tw_pop(&W, &ev) && tw_push(&W, ev.time + 1 + BW_DELAY(), 0, ev.arg);
+                ops += 4096;
+                if (W.now > (1u << 30)) { tw_free(&W); tw_init(&W); for (int i = 0; i < N && ok; i++) ok = tw_push(&W, BW_DELAY(), 0, i); }
+            } while (ok && (t = wall_seconds() - t0) < B->minTime);
+            #undef BW_DELAY
+            if (ok) best = MAX(best, ops / t);
+            tw_free(&W);
+        }
+        snprintf(name, sizeof(name), "wheel.hold.n=%d.span=%s", N, sp ? "1h" : "1s"); bench_add(B, name, "events/s", best, 1);
+    }
+}
+/* Usage: [--quick] [--only poisson|pobook|wheel|day|forecast|fork|log|state] [--out bench.json] [--compare baseline.json] [--threshold PCT]
+   Exit code 1 if --compare finds a regression */
+static int bench_main(int argc, char** argv) {
+    const char* outPath = BENCH_PATH, * basePath = NULL, * only = NULL; double threshold = 10.0;
+    Bench B; memset(&B, 0, sizeof(B)); B.minTime = 0.25;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i]; const char* v = (i + 1 < argc ? argv[i + 1] : NULL);
+        if (!strcmp(a, "--quick")) { B.quick = 1; B.minTime = 0.05; }
+        else if (!strcmp(a, "--only") && v) { only = v; i++; }
+        else if (!strcmp(a, "--out") && v) { outPath = v; i++; }
+        else if (!strcmp(a, "--compare") && v) { basePath = v; i++; }
+        else if (!strcmp(a, "--threshold") && v) { threshold = atof(v); i++; }
+        else { fprintf(stderr, "ERR: unknown argument %s\n", a); return 2; }
+    }
+    Bench base; memset(&base, 0, sizeof(base));
+    if (basePath && !bench_load(&base, basePath)) { fprintf(stderr, "ERR: cannot read %s\n", basePath); return 2; }
+    printf("=== MiniMarket benchmarks (%s, %d CPUs) ===\n", B.quick ? "quick" : "full", cpu_count());
+    if (!only || !strcmp(only, "poisson")) bench_poisson(&B);
+    if (!only || !strcmp(only, "pobook")) bench_pobook(&B);
+    if (!only || !strcmp(only, "wheel")) bench_wheel(&B);
+    if (!only || !strcmp(only, "day")) bench_simulate_day(&B);
+    if (!only || !strcmp(only, "forecast")) bench_forecast(&B);
+    if (!only || !strcmp(only, "fork")) bench_fork(&B);
+    if (!only || !strcmp(only, "log") || !strcmp(only, "state")) {
+        /* these write LOG_* / STATE_PATH: keep them out of the working directory */
+#ifdef _WIN32
+        _mkdir(BENCH_DIR);
+#else
+        mkdir(BENCH_DIR, 0755);
+#endif
+        if (!mm_chdir(BENCH_DIR)) fprintf(stderr, "ERR: cannot use %s\n", BENCH_DIR);
+        else {
+            if (!only || !strcmp(only, "log")) bench_logging(&B);
+            if (!only || !strcmp(only, "state")) bench_state(&B);
+            mm_chdir("..");
+#ifdef _WIN32
+            _rmdir(BENCH_DIR);
+#else
+            rmdir(BENCH_DIR);
+#endif
+        }
+    }
+    int regressions = 0;
+    if (bench_write_json(&B, outPath)) printf("Results saved to: %s\n", outPath);
+    else fprintf(stderr, "ERR: cannot open %s\n", outPath);
+    if (basePath) regressions = bench_compare(&B, &base, threshold);
+    free(B.r); free(base.r);
+    return regressions ? 1 : 0;
+}
+#endif
+
+#ifdef MINIMARKET_TEST
+/* ---------- Self-tests (build with -DMINIMARKET_TEST) ---------- */
+static int test_checks, test_failed;
+static int test_check(int ok, const char* fmt, ...) {
+    test_checks++;
+    if (ok) return 1;
+    va_list ap; va_start(ap, fmt);
+    test_failed++; printf("  FAIL: "); vprintf(fmt, ap); putchar('\n');
+    va_end(ap);
+    return 0;
+}
+/* Synthetic catalog with every kind of state a checkpoint carries: mixed policies, forecast state,
+   perishables with dated lots */
+static void test_sim(Sim* S, int n) {
+    sim_init(S); S->cfg.seed = 7; S->rngKey = 7; S->verbose = 0;
+    unsigned long long x = 4242; char name[32];
+    for (int i = 0; i < n; i++) {
+        double bc = 1.0 + (double)(splitmix64(&x) % 4000) / 100.0;
+        snprintf(name, sizeof(name), "Test %d", i);
+        int k = cat_add(&S->cat, 200000 + i, name, bc, bc * 1.4, 5 + (int)(splitmix64(&x) % 40), (i % 3 == 0 ? PERISHABLE : 0));
+        if (k < 0) { puts("OOM"); return; }
+        Catalog* C = &S->cat;
+        if (i % 4 == 1) { C->policy[k] = POL_SS; C->reorderPoint[k] = 10; C->orderUpTo[k] = 45; }
+        else if (i % 4 == 2) C->policy[k] = POL_FORECAST;
+        if (i % 5 == 0) C->shelfLife[k] = 2 + i % 6;
+    }
+}
+/* Lots compare by content: slots outside head .. head+count-1 are dead */
+static int test_same_lots(const LotRing* a, const LotRing* b) {
+    if (a->count != b->count) return 0;
+    for (int k = 0; k < a->count; k++) {
+        int p = (a->head + k) % LOT_CAP, q = (b->head + k) % LOT_CAP;
+        if (a->qty[p] != b->qty[q] || a->useBy[p] != b->useBy[q]) return 0;
+    }
+    return 1;
+}
+/* Persisted state of a and b: day, nextPO, config, every catalog column, names, lots and open POs */
+static int test_same_state(const Sim* a, const Sim* b, const char* what) {
+    int failed = test_failed;
+    test_check(a->day == b->day && a->nextPO == b->nextPO, "%s: day %d/%d, nextPO %d/%d", what, a->day, b->day, a->nextPO, b->nextPO);
+    char ta[4096], tb[4096];
+    config_to_text(&a->cfg, ta, sizeof(ta)); config_to_text(&b->cfg, tb, sizeof(tb));
+    test_check(!strcmp(ta, tb), "%s: config differs", what);
+    const Catalog* A = &a->cat, * B = &b->cat;
+    if (!test_check(A->n == B->n, "%s: %d vs %d SKUs", what, A->n, B->n)) return 0;
+#define X(type, field) \
+    if (CATCOL_##field != CATCOL_lots && CATCOL_##field != CATCOL_nameOff) \
+        test_check(!memcmp(A->field, B->field, sizeof(type) * (size_t)A->n), "%s: column %s differs", what, #field);
+    CATALOG_COLUMNS(X) X(int, onOrder)
+#undef X
+    int badName = -1, badLots = -1;
+    for (int i = 0; i < A->n; i++) {
+        if (badName < 0 && strcmp(cat_name(A, i), cat_name(B, i))) badName = i;
+        if (badLots < 0 && !test_same_lots(&A->lots[i], &B->lots[i])) badLots = i;
+    }
+    test_check(badName < 0, "%s: name of SKU %d differs", what, badName);
+    test_check(badLots < 0, "%s: lots of SKU %d differ", what, badLots);
+    int nPo = 0; PO* p = pobook_next(&a->pos, a->day, NULL), * q = pobook_next(&b->pos, b->day, NULL);
+    for (; p && q; p = pobook_next(&a->pos, a->day, p), q = pobook_next(&b->pos, b->day, q), nPo++) {
+        if (p->poId != q->poId || p->productIndex != q->productIndex || p->qty != q->qty || p->dueDay != q->dueDay || p->leadTime != q->leadTime) break;
+    }
+    test_check(!p && !q, "%s: open POs differ at #%d", what, nPo);
+    return test_failed == failed;
+}
+static int test_load(Sim* L, const char* what) {
+    sim_init(L);
+    return test_check(load_state(L, STATE_PATH), "%s: load_state failed", what);
+}
+static long test_file(const char* path, char** data) {
+    FILE* f = mm_fopen(path, "rb"); long len = -1; *data = NULL;
+    if (!f) return -1;
+    if (fseek(f, 0, SEEK_END) == 0 && (len = ftell(f)) > 0 && (*data = (char*)malloc((size_t)len)) != NULL) {
+        rewind(f); if (fread(*data, 1, (size_t)len, f) != (size_t)len) len = -1;
+    }
+    fclose(f);
+    return len;
+}
+static int test_write_file(const char* path, const char* data, long len) {
+    FILE* f = mm_fopen(path, "wb"); if (!f) return 0;
+    int ok = (fwrite(data, 1, (size_t)len, f) == (size_t)len);
+    return (fclose(f) == 0) && ok;
+}
+/* Journal + checkpoint round trip: after every day, checkpoint + replay must rebuild the live state;
+   a reloaded sim must continue exactly like the live one; a torn, corrupt or padded journal tail
+   must fall back to the last complete day and leave the state epoch unset */
+static void test_state(void) {
+    remove(STATE_PATH); remove(JOURNAL_PATH);
+    Sim S, L, prev; char what[64];
+    test_sim(&S, 400); S.jnl = journal_open(10);
+    if (!test_check(S.jnl != NULL, "journal_open failed")) { sim_free(&S); return; }
+    for (int d = 0; d < 45; d++) {
+        simulate_day(&S, NULL);
+        snprintf(what, sizeof(what), "day %d", S.day);
+        if (!test_load(&L, what)) break;
+        test_same_state(&S, &L, what);
+        test_check(L.stateEpoch == S.stateEpoch, "%s: journal not clean", what);
+        sim_free(&L);
+    }
+    if (test_load(&L, "resume")) {
+        for (int d = 0; d < 10; d++) {
+            simulate_day(&S, NULL); simulate_day(&L, NULL);
+            snprintf(what, sizeof(what), "resumed day %d", S.day);
+            if (!test_same_state(&S, &L, what)) break;
+        }
+        sim_free(&L);
+    }
+
+    /* torn tail: the last day must be dropped, the one before it kept */
+    memset(&prev, 0, sizeof(prev));
+    do {
+        sim_free(&prev);
+        if (!test_check(sim_clone(&prev, &S), "sim_clone failed")) { journal_close(S.jnl); sim_free(&S); return; }
+        simulate_day(&S, NULL);
+    } while (S.jnl->days < 2);
+    journal_close(S.jnl); S.jnl = NULL;
+    char* jnl; long len = test_file(JOURNAL_PATH, &jnl);
+    if (test_check(len > (long)(sizeof(JournalFileHdr) + 2 * sizeof(JournalDayHdr)), "journal too short (%ld bytes)", len)) {
+        static const char* cases[] = { "torn tail", "corrupt last record", "padded tail" };
+        for (int c = 0; c < 3; c++) {
+            int ok = 1;
+            if (c == 0) ok = test_write_file(JOURNAL_PATH, jnl, len - 5);
+            else if (c == 1) { jnl[len - 1] ^= 0x5a; ok = test_write_file(JOURNAL_PATH, jnl, len); jnl[len - 1] ^= 0x5a; }
+            else {
+                char* pad = (char*)calloc(1, (size_t)len + 9);
+                ok = pad && (memcpy(pad, jnl, (size_t)len), test_write_file(JOURNAL_PATH, pad, len + 9));
+                free(pad);
+            }
+            if (!test_check(ok, "%s: cannot rewrite %s", cases[c], JOURNAL_PATH) || !test_load(&L, cases[c])) continue;
+            test_same_state(c == 2 ? &S : &prev, &L, cases[c]);
+            test_check(L.stateEpoch == 0, "%s: journal taken as clean", cases[c]);
+            sim_free(&L);
+        }
+        test_write_file(JOURNAL_PATH, jnl, len);
+        if (test_load(&L, "intact journal")) {
+            test_same_state(&S, &L, "intact journal");
+            test_check(L.stateEpoch != 0, "intact journal: not clean");
+            sim_free(&L);
+        }
+    }
+    free(jnl); sim_free(&prev); sim_free(&S);
+    remove(STATE_PATH); remove(JOURNAL_PATH);
+}
+/* Timing wheel against a reference: times spread over every level, same-ms bursts and times before
+   `now` (which run at `now`). Pops must come in time order, and same-ms events in push order. */
+typedef struct { unsigned int time; int seq; } TestEv;
+static int test_ev_cmp(const void* a, const void* b) {
+    const TestEv* x = (const TestEv*)a, * y = (const TestEv*)b;
+    if (x->time != y->time) return x->time < y->time ? -1 : 1;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+static unsigned int test_wheel_time(unsigned long long* x, unsigned int now, unsigned int last) {
+    unsigned long long r = splitmix64(x); unsigned int d = (unsigned int)(r >> 32);
+    switch (r % 8) {
+    case 0: return now;                                                      /* same ms as now */
+    case 1: return last;                                                     /* same ms as the previous push */
+    case 2: return now - MIN(now, d % 5000);                                 /* before now */
+    case 3: return now + d % TW_SLOTS;                                       /* level 0 */
+    case 4: return now + d % (1u << (2 * TW_BITS));
+    case 5: return now + d % (1u << (3 * TW_BITS));
+    default: return now + d % (1u << 28);
+    }
+}
+static void test_wheel(void) {
+    enum { BATCH = 50000, PENDING = 2000, STEPS = 200000 };
+    TimingWheel W; tw_init(&W); unsigned long long x = 2024; TwEvent ev;
+    TestEv* ref = (TestEv*)malloc(sizeof(TestEv) * BATCH);
+    if (!test_check(ref != NULL, "OOM")) return;
+
+    /* batch: push everything (now > 0, so some times are in the past), pop to empty, compare with the sorted list */
+    int ok = tw_push(&W, 1000000, 0, -1) && tw_pop(&W, &ev);
+    unsigned int last = W.now;
+    for (int k = 0; k < BATCH && ok; k++) {
+        unsigned int t = test_wheel_time(&x, W.now, last); last = t;
+        ref[k].time = MAX(t, W.now); ref[k].seq = k;
+        ok = tw_push(&W, t, 0, k);
+    }
+    if (!test_check(ok, "batch: tw_push failed")) { tw_free(&W); free(ref); return; }
+    qsort(ref, BATCH, sizeof(TestEv), test_ev_cmp);
+    int bad = -1, got = 0; unsigned int prev = 0;
+    while (tw_pop(&W, &ev)) {
+        if (bad < 0 && (got >= BATCH || ev.time < prev || ev.time != ref[got].time || ev.arg != ref[got].seq)) bad = got;
+        prev = ev.time; got++;
+    }
+    test_check(got == BATCH, "batch: popped %d of %d events", got, BATCH);
+    test_check(bad < 0, "batch: pop #%d out of order", bad);
+    tw_free(&W);
+
+    /* hold model: bursts of pushes between pops, checked against a linear scan of the pending set */
+    int n = 0, seq = 0; bad = -1; got = 0; last = 0;
+    for (int step = 0; step < STEPS && ok && bad < 0; step++) {
+        unsigned long long r = splitmix64(&x);
+        if (n == 0 || (r % 3 == 0 && n < PENDING - 8)) {
+            int burst = 1 + (int)((r >> 8) % 8);
+            for (int k = 0; k < burst && ok; k++) {
+                unsigned int t = test_wheel_time(&x, W.now, last); last = t;
+                ref[n].time = MAX(t, W.now); ref[n].seq = seq; n++;
+                ok = tw_push(&W, t, 0, seq++);
+            }
+            continue;
+        }
+        int m = 0;
+        for (int k = 1; k < n; k++) if (test_ev_cmp(&ref[k], &ref[m]) < 0) m = k;
+        if (!tw_pop(&W, &ev) || ev.time != ref[m].time || ev.arg != ref[m].seq) bad = got;
+        got++; ref[m] = ref[--n];
+    }
+    test_check(ok, "hold: tw_push failed");
+    test_check(bad < 0, "hold: pop #%d differs from the reference", bad);
+    while (n > 0 && bad < 0) {   /* drain */
+        int m = 0;
+        for (int k = 1; k < n; k++) if (test_ev_cmp(&ref[k], &ref[m]) < 0) m = k;
+        if (!tw_pop(&W, &ev) || ev.time != ref[m].time || ev.arg != ref[m].seq) bad = got;
+        got++; ref[m] = ref[--n];
+    }
+    test_check(bad < 0 && W.count == 0 && !tw_pop(&W, &ev), "hold: drain differs from the reference at pop #%d", bad);
+    tw_free(&W); free(ref);
+}
+/* Usage: [--only state|wheel]. Exit code 1 if any check fails */
+static int test_main(int argc, char** argv) {
+    const char* only = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--only") && i + 1 < argc) only = argv[++i];
+        else { fprintf(stderr, "ERR: unknown argument %s\n", argv[i]); return 2; }
+    }
+    static const struct { const char* name; void (*run)(void); } tests[] = { { "state", test_state }, { "wheel", test_wheel } };
+#ifdef _WIN32
+    _mkdir(TEST_DIR);
+#else
+    mkdir(TEST_DIR, 0755);
+#endif
+    if (!mm_chdir(TEST_DIR)) { fprintf(stderr, "ERR: cannot use %s\n", TEST_DIR); return 2; }
+    printf("=== MiniMarket self-tests ===\n");
+    for (int t = 0; t < (int)(sizeof(tests) / sizeof(tests[0])); t++) {
+        if (only && strcmp(only, tests[t].name)) continue;
+        int checks = test_checks, failed = test_failed;
+        tests[t].run();
+        printf("%-8s %s (%d checks)\n", tests[t].name, test_failed == failed ? "PASS" : "FAIL", test_checks - checks);
+    }
+    mm_chdir("..");
+#ifdef _WIN32
+    _rmdir(TEST_DIR);
+#else
+    rmdir(TEST_DIR);
+#endif
+    printf("%d check(s) failed\n", test_failed);
+    return test_failed ? 1 : 0;
+}
+#endif
+
+/* ---------- Welcome screen ---------- */
+static void clear_screen(void) {
+#ifdef _WIN32
+    system("cls");
+#else
+    system("clear");
+#endif
+}
+static void wait_enter(void) {
+    puts("\nPress ENTER to continue...");
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF) {}
+}
+static void show_welcome(void) {
+    clear_screen();
+    puts("+----------------------------------------------------+");
+    puts("|                                                    |");
+    puts("|           W E L C O M E   T O   T H E              |");
+    puts("|                                                    |");
+    puts("|                M I N I M A R K E T                 |"); /* NOTE: regular ASCII only */
+    puts("|                                                    |");
+    puts("+----------------------------------------------------+");
+    wait_enter();
+    clear_screen();
+}
+
+/* ---------- Menu ---------- */
+static void print_menu(const Sim* S) {
+    puts("\n================= INVENTORY SIM ((s,Q)) =================");
+    printf("Day: %d\n", S->day);
+    puts("---------------------------------------------------------");
+    puts("1) Run multiple days (you'll enter how many)");
+    puts("2) Step 1 day");
+    puts("3) Reports");
+    puts("   3.1) Top products by profit (choose how many)");
+    puts("   3.2) Service level & stockouts");
+    puts("   3.3) Summary (cumulative totals)");
+    puts("4) Show open purchase orders (ETAs)");
+    puts("5) rest");
+    puts("6) Exit");
+    puts("7) Performance stats (phase timings)");
+    puts("8) Fast-forward N days (quiet, one checkpoint at the end)");
+    puts("9) What-if scenarios (fork the current state, compare branches)");
+    puts("---------------------------------------------------------");
+    printf("Select: ");
+}
+
+/* ---------- Main ---------- */
+/* Auto-load on start: config/inventory, open single log in append mode, resume the saved state */
+static void open_session(Sim* S) {
+    RunOptions opt; run_options_defaults(&opt);
+    load_config_txt(&S->cfg, &opt, "config.txt");       /* if missing -> keep defaults */
+    load_inventory_csv(S, "inventory.csv"); /* if missing -> demo inventory */
+    if (!S->cfg.seed) S->cfg.seed = (unsigned long long)time(NULL); /* saved with the state, so a resumed run stays reproducible */
+    S->rngKey = S->cfg.seed;
+    open_single_log_append(S, &opt);
+    S->jnl = journal_open(opt.checkpointDays);
+
+    /* NEW: try to resume from saved state */
+    if (load_state(S, STATE_PATH)) {
+        printf("Loaded saved state from %s. Continuing at Day %d.\n", STATE_PATH, S->day);
+    }
+    else {
+        printf("Starting new simulation. Day=%d. Seed=%llu.\n", S->day, S->cfg.seed);
+    }
+    int nPolicies = load_policy_csv(S, POLICY_PATH);   /* after the state, so a new policy file takes effect */
+    if (nPolicies > 0) printf("Per-SKU replenishment policies loaded from %s: %d products.\n", POLICY_PATH, nPolicies);
+    int nDemand = load_demand_csv(S, DEMAND_PATH);
+    if (nDemand > 0) printf("Per-SKU demand parameters loaded from %s: %d products.\n", DEMAND_PATH, nDemand);
+}
+
+int main(int argc, char** argv) {
+#ifdef MINIMARKET_BENCH
+    return bench_main(argc, argv);
+#endif
+#ifdef MINIMARKET_TEST
+    return test_main(argc, argv);
+#endif
+    /* Headless mode: any command-line arguments -> no menu */
+    if (argc > 1) return run_command_line(argc, argv);
+
+    Sim* S = &G_sim;
+    sim_init(S);
+    S->verbose = 1;
+#ifdef MM_STATS
+    S->stats = &G_stats;
+#endif
+
+    /* Show welcome first */
+    show_welcome();
+    open_session(S);
+
+    int running = 1;
+    while (running) {
+        print_menu(S);
+        int choice = -1; if (scanf("%d", &choice) != 1) { clear_line(); continue; }
+
+        if (choice == 1) {
+            int N = 0; printf("How many days to run? ");
+            if (scanf("%d", &N) != 1 || N <= 0) { puts("Invalid days."); clear_line(); continue; }
+            for (int i = 0; i < N; i++) { printf("\nDay %d\n------\n", S->day + 1); simulate_day(S, NULL); }
+        }
+        else if (choice == 2) {
+            printf("\nDay %d\n------\n", S->day + 1); simulate_day(S, NULL);
+        }
+        else if (choice == 3) {
+            printf("\nReports: choose 1/2/3: "); int r = 0;
+            if (scanf("%d", &r) != 1) { clear_line(); continue; }
+            if (r == 1) report_top_products_by_profit(S);
+            else if (r == 2) report_service_and_stockouts(S);
+            else if (r == 3) report_summary_cumulative(S);
+            else puts("Unknown report.");
+        }
+        else if (choice == 4) {
+            show_open_pos(S);
+        }
+        else if (choice == 5) {
+            puts("\nAre you sure? This will CLEAR sim_all.csv and reset the simulation. (y/n)");
+            char ch = 0; scanf(" %c", &ch);
+            if (ch == 'y' || ch == 'Y') { reset_single_log_and_state(S); puts("Reset complete. Day=0."); }
+            else puts("Reset cancelled.");
+        }
+        else if (choice == 6) {
+            /* NEW: save state on exit */
+            save_state(S, STATE_PATH);
+            running = 0;
+        }
+        else if (choice == 8) {
+            int N = 0; printf("How many days to fast-forward? ");
+            if (scanf("%d", &N) != 1 || N <= 0) { puts("Invalid days."); clear_line(); continue; }
+            printf("Write log rows? (y/n) "); char ch = 'y'; scanf(" %c", &ch);
+            puts("Running... (Ctrl+C stops after the current day)");
+            fast_forward(S, N, ch != 'n' && ch != 'N');
+        }
+        else if (choice == 9) {
+            int N = 0; printf("How many days to run each branch? ");
+            if (scanf("%d", &N) != 1 || N <= 0) { puts("Invalid days."); clear_line(); continue; }
+            clear_line();
+            puts("One branch per line:  name: change, change@day   e.g.  bigQ: q=60   promo: Strawberries.onsale=1@120");
+            puts("(settings from config.txt, or product.price|cost|stock|shelflife|onsale|base|promo|policy|s|q|S ...); empty line to run:");
+            char lines[SCN_MAX_BRANCHES - 1][256]; const char* specs[SCN_MAX_BRANCHES - 1]; int ns = 0;
+            while (ns < SCN_MAX_BRANCHES - 1 && fgets(lines[ns], sizeof(lines[ns]), stdin)) {
+                lines[ns][strcspn(lines[ns], "\r\n")] = '\0';
+                if (!lines[ns][0]) break;
+                specs[ns] = lines[ns]; ns++;
+            }
+            whatif(S, specs, ns, N, cpu_count(), WHATIF_PATH);
+        }
+        else if (choice == 7) {
+#ifdef MM_STATS
+            printf("\nFormat: 1) table 2) JSON 3) Prometheus: "); int f = 1;
+            if (scanf("%d", &f) != 1) { clear_line(); f = 1; }
+            stats_write(stdout, S->stats, f == 2 ? STATS_FMT_JSON : f == 3 ? STATS_FMT_PROM : STATS_FMT_TABLE);
+#else
+            puts("\nStats are compiled out of this build (define MINIMARKET_STATS to enable them).");
+#endif
+        }
+        else {
+            puts("Unknown option.");
+        }
+    }
+    close_single_log(S); journal_close(S->jnl); S->jnl = NULL; sim_free(S);
+    return 0;
+}